@@ -0,0 +1,284 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QtGui>
+
+#include "batchrotator.hh"
+#include "common.hh"
+#include "library.hh"
+#include "metadata.hh"
+#include "orientedscale.hh"
+#include "similarityindex.hh"
+
+// Ids per statement when selecting the images to rotate.
+static const quint64 chunkSize = 4096;
+
+// Orientations after a quarter turn, indexed by the orientation before
+// it. Rotations and mirrors compose, so a mirrored image stays mirrored.
+static const int clockwiseOrientations[8] = {6, 7, 8, 5, 2, 3, 4, 1};
+static const int counterclockwiseOrientations[8] = {8, 5, 6, 7, 4, 1, 2, 3};
+
+class BatchRotator::RotateImage
+{
+public:
+    typedef void result_type;
+
+    explicit RotateImage(BatchRotator* rotator)
+        :m_rotator(rotator)
+    {
+    }
+
+    void operator()(Rotation& rotation) const
+    {
+        m_rotator->rotateImage(rotation);
+    }
+
+private:
+    BatchRotator* m_rotator;
+};
+
+BatchRotator::Rotation::Rotation()
+    :id(0)
+    ,filePath()
+    ,orientation(1)
+    ,modificationTime()
+    ,fileSize(0)
+    ,isRotated(false)
+    ,hasHash(false)
+    ,hash(0)
+{
+}
+
+BatchRotator::BatchRotator(QObject* parent)
+    :QObject(parent)
+    ,m_databaseName()
+    ,m_ids()
+    ,m_direction(Clockwise)
+    ,m_levels()
+    ,m_rotations()
+    ,m_doneCount(0)
+    ,m_failedCount(0)
+    ,m_watcher(new QFutureWatcher<bool>(this))
+{
+    connect(m_watcher, SIGNAL(finished()), SLOT(workFinished()));
+}
+
+BatchRotator::~BatchRotator()
+{
+    m_watcher->waitForFinished();
+}
+
+void BatchRotator::start(const Bitmap& ids, const Direction direction)
+{
+    if (isRunning())
+        return;
+
+    m_databaseName = QSqlDatabase::database().databaseName();
+    m_ids = ids;
+    m_direction = direction;
+    m_levels = thumbnailLevels();
+    m_rotations.clear();
+    m_doneCount = 0;
+    m_failedCount = 0;
+    m_watcher->setFuture(QtConcurrent::run(this, &BatchRotator::run));
+}
+
+bool BatchRotator::isRunning() const
+{
+    return m_watcher->isRunning();
+}
+
+const QList<BatchRotator::Rotation>& BatchRotator::rotations() const
+{
+    return m_rotations;
+}
+
+int BatchRotator::failedCount() const
+{
+    return m_failedCount;
+}
+
+int BatchRotator::rotatedOrientation(const int orientation,
+                                     const Direction direction)
+{
+    const int i = orientation < 1 || orientation > 8 ? 0 : orientation - 1;
+
+    if (direction == Clockwise)
+        return clockwiseOrientations[i];
+
+    return counterclockwiseOrientations[i];
+}
+
+void BatchRotator::workFinished()
+{
+    emit finished(m_watcher->result());
+}
+
+// Rotating writes to a single library: its connection attaches no other
+// library, and a federated catalog is read-only.
+bool BatchRotator::run()
+{
+    const QString connectionName("BatchRotator");
+    bool isSuccessful;
+
+    if (isFederated()) {
+        qWarning() << "images of federated catalogs cannot be rotated";
+        return false;
+    }
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE",
+                                                    connectionName);
+        db.setDatabaseName(m_databaseName);
+        // The GUI connection may be holding the write lock for a while.
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=30000");
+        if (!db.open()) {
+            qWarning() << "failed to open database for rotating:"
+                       << db.lastError().databaseText();
+            isSuccessful = false;
+        } else {
+            isSuccessful = selectImages(db);
+            if (isSuccessful) {
+                emit progressChanged(0, m_rotations.size());
+                QtConcurrent::blockingMap(m_rotations, RotateImage(this));
+                isSuccessful = updateImages(db);
+            }
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    return isSuccessful;
+}
+
+bool BatchRotator::selectImages(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT id, file_path, exif_orientation FROM Image"
+                  "  WHERE id BETWEEN ? AND ?");
+
+    foreach (Bitmap::Range range, m_ids.ranges()) {
+        for (quint64 first = range.first; first <= range.second;
+             first += chunkSize) {
+            query.bindValue(0, first);
+            query.bindValue(1, qMin(first + chunkSize - 1,
+                                    quint64(range.second)));
+            if (!query.exec()) {
+                qWarning() << "failed to select images to rotate:"
+                           << query.lastError().databaseText();
+                return false;
+            }
+            while (query.next()) {
+                Rotation rotation;
+                rotation.id = query.value(0).toLongLong();
+                rotation.filePath = query.value(1).toString();
+                rotation.orientation = query.value(2).toInt();
+                m_rotations.append(rotation);
+            }
+        }
+    }
+
+    return true;
+}
+
+// Runs in the threads of the global pool, once per image.
+void BatchRotator::rotateImage(Rotation& rotation)
+{
+    const int orientation = rotatedOrientation(rotation.orientation,
+                                               m_direction);
+
+    if (!writeOrientation(rotation.filePath, orientation)) {
+        m_failedCount.fetchAndAddOrdered(1);
+    } else {
+        const QFileInfo fileInfo(rotation.filePath);
+        rotation.orientation = orientation;
+        rotation.modificationTime = fileInfo.lastModified().toUTC();
+        rotation.fileSize = fileInfo.size();
+        rotation.isRotated = true;
+
+        // Thumbnails are square with the image centered, turning them
+        // gives the thumbnails of the rotated image. They are saved after
+        // the file was written, so they stay up to date.
+        const int turn = m_direction == Clockwise ? 6 : 8;
+        foreach (int level, m_levels) {
+            const QString levelFilePath(thumbnailFilePath(rotation.filePath,
+                                                          level));
+            const QImage thumbnail(levelFilePath);
+            if (thumbnail.isNull())
+                continue;
+
+            const QImage turned(orientedScaled(
+                                    thumbnail, turn,
+                                    orientedSize(thumbnail.size(), turn)));
+            if (!turned.save(levelFilePath)) {
+                qWarning() << "failed to save the thumbnail image to "
+                           << levelFilePath;
+                continue;
+            }
+            if (level == m_levels.first()) {
+                rotation.hash = perceptualHash(turned);
+                rotation.hasHash = true;
+            }
+        }
+    }
+
+    const int done = m_doneCount.fetchAndAddOrdered(1) + 1;
+    emit progressChanged(done, m_rotations.size());
+}
+
+bool BatchRotator::updateImages(QSqlDatabase db)
+{
+    if (!db.transaction()) {
+        qWarning() << "failed to begin rotating transaction:"
+                   << db.lastError().databaseText();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("UPDATE Image"
+                  "  SET exif_orientation = ?, mtime = ?, file_size = ?,"
+                  "    phash = COALESCE(?, phash)"
+                  "  WHERE id = ?");
+
+    foreach (const Rotation& rotation, m_rotations) {
+        if (!rotation.isRotated)
+            continue;
+
+        query.bindValue(0, rotation.orientation);
+        query.bindValue(1, rotation.modificationTime);
+        query.bindValue(2, rotation.fileSize);
+        query.bindValue(3, rotation.hasHash
+                        ? QVariant(qint64(rotation.hash))
+                        : QVariant(QVariant::LongLong));
+        query.bindValue(4, rotation.id);
+        if (!query.exec()) {
+            qWarning() << "failed to update rotated images:"
+                       << query.lastError().databaseText();
+            db.rollback();
+            return false;
+        }
+    }
+
+    if (!db.commit()) {
+        qWarning() << "failed to commit rotating transaction:"
+                   << db.lastError().databaseText();
+        db.rollback();
+        return false;
+    }
+
+    return true;
+}
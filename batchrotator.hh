@@ -0,0 +1,92 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BATCHROTATOR_HH
+#define BATCHROTATOR_HH
+
+#include <QtSql>
+
+#include "bitmap.hh"
+
+// Rotates a set of images by a quarter turn without re-encoding them. Only
+// the EXIF orientation of the files is rewritten, in parallel, and the
+// cached thumbnails are turned in place instead of being rendered again
+// from the originals. The catalog is updated in a single transaction
+// through the rotator's own database connection once the files are done.
+class BatchRotator : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Direction { Clockwise, Counterclockwise };
+
+    // An image the last batch rotated, with the perceptual hash of its
+    // turned thumbnail.
+    struct Rotation
+    {
+        Rotation();
+
+        qint64 id;
+        QString filePath;
+        int orientation;
+        QDateTime modificationTime;
+        qint64 fileSize;
+        bool isRotated;
+        bool hasHash;
+        quint64 hash;
+    };
+
+    explicit BatchRotator(QObject* parent = 0);
+    ~BatchRotator();
+
+    void start(const Bitmap& ids, Direction direction);
+    bool isRunning() const;
+
+    // Images of the last batch, valid once it has finished. Images which
+    // could not be rotated have isRotated unset.
+    const QList<Rotation>& rotations() const;
+    int failedCount() const;
+
+    // Orientation of an image with the given orientation after turning it
+    // a quarter in the given direction.
+    static int rotatedOrientation(int orientation, Direction direction);
+
+signals:
+    void progressChanged(int value, int maximum);
+    void finished(bool isSuccessful);
+
+private slots:
+    void workFinished();
+
+private:
+    class RotateImage;
+
+    bool run();
+    bool selectImages(QSqlDatabase db);
+    void rotateImage(Rotation& rotation);
+    bool updateImages(QSqlDatabase db);
+
+    QString m_databaseName;
+    Bitmap m_ids;
+    Direction m_direction;
+    QList<int> m_levels;
+    QList<Rotation> m_rotations;
+    QAtomicInt m_doneCount;
+    QAtomicInt m_failedCount;
+    QFutureWatcher<bool>* m_watcher;
+};
+
+#endif // BATCHROTATOR_HH
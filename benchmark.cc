@@ -0,0 +1,233 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+#include "benchmark.hh"
+
+// Resident memory is sampled once per this many imported files, the first
+// sample being the baseline the growth is measured from.
+static const int rssSampleInterval = 1000;
+
+// Returns a size field of /proc/self/status such as VmRSS in bytes, or -1
+// if it is not available.
+static qint64 processStatusSize(const QByteArray& field)
+{
+    QFile file("/proc/self/status");
+    if (!file.open(QIODevice::ReadOnly))
+        return -1;
+
+    const QByteArray prefix(field + ":");
+    foreach (QByteArray line, file.readAll().split('\n')) {
+        if (!line.startsWith(prefix))
+            continue;
+        // Sizes are reported in kB.
+        const QList<QByteArray> words(line.mid(prefix.size()).simplified()
+                                      .split(' '));
+        return words.first().toLongLong() * 1024;
+    }
+
+    return -1;
+}
+
+// Returns a counter of /proc/self/io such as rchar, or 0 if it is not
+// available.
+static qint64 processIoCounter(const QByteArray& field)
+{
+    QFile file("/proc/self/io");
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    const QByteArray prefix(field + ":");
+    foreach (QByteArray line, file.readAll().split('\n')) {
+        if (line.startsWith(prefix))
+            return line.mid(prefix.size()).trimmed().toLongLong();
+    }
+
+    return 0;
+}
+
+// Names of the block devices holding the given paths as /proc/diskstats
+// calls them. Paths on file systems without a block device of their own,
+// such as network mounts, are left out.
+static QStringList devicesOf(const QStringList& paths)
+{
+    QSet<QPair<uint, uint> > numbers;
+    QStringList devices;
+
+    foreach (QString path, paths) {
+        struct stat st;
+        if (stat(QFile::encodeName(path).constData(), &st) == 0)
+            numbers.insert(qMakePair(uint(major(st.st_dev)),
+                                     uint(minor(st.st_dev))));
+    }
+
+    QFile file("/proc/diskstats");
+    if (!file.open(QIODevice::ReadOnly))
+        return devices;
+
+    foreach (QByteArray line, file.readAll().split('\n')) {
+        const QList<QByteArray> words(line.simplified().split(' '));
+        if (words.size() < 3)
+            continue;
+        if (numbers.contains(qMakePair(words[0].toUInt(),
+                                       words[1].toUInt())))
+            devices.append(QString::fromLatin1(words[2]));
+    }
+
+    return devices;
+}
+
+// Milliseconds the devices have spent doing I/O since boot.
+static QMap<QString, qint64> deviceBusyTimes(const QStringList& devices)
+{
+    QMap<QString, qint64> busyTimes;
+
+    QFile file("/proc/diskstats");
+    if (!file.open(QIODevice::ReadOnly))
+        return busyTimes;
+
+    foreach (QByteArray line, file.readAll().split('\n')) {
+        // The thirteenth field is the time the device had I/O in flight.
+        const QList<QByteArray> words(line.simplified().split(' '));
+        if (words.size() >= 13
+            && devices.contains(QString::fromLatin1(words[2])))
+            busyTimes.insert(QString::fromLatin1(words[2]),
+                             words[12].toLongLong());
+    }
+
+    return busyTimes;
+}
+
+ImportBenchmark::ImportBenchmark(const QStringList& paths,
+                                 const bool recursive,
+                                 const IoOrder ioOrder,
+                                 const ReadMode readMode, QObject* parent)
+    :QObject(parent)
+    ,m_paths(paths)
+    ,m_isRecursive(recursive)
+    ,m_importer(new Importer(this))
+    ,m_timer()
+    ,m_fileCount(0)
+    ,m_failedCount(0)
+    ,m_probedCount(0)
+    ,m_probeMilliseconds(0)
+    ,m_byteCount(0)
+    ,m_baselineRss(-1)
+    ,m_maxRssGrowth(0)
+    ,m_devices(devicesOf(paths))
+    ,m_deviceBusyTimes()
+    ,m_readCalls(0)
+{
+    m_importer->setIoOrder(ioOrder);
+    m_importer->setReadMode(readMode);
+    m_importer->setRegenerateThumbnails(true);
+
+    connect(m_importer, SIGNAL(resultsAvailable()),
+            this, SLOT(resultsAvailable()));
+    connect(m_importer, SIGNAL(finished()),
+            this, SLOT(importFinished()));
+}
+
+void ImportBenchmark::start()
+{
+    m_deviceBusyTimes = deviceBusyTimes(m_devices);
+    m_readCalls = processIoCounter("syscr");
+    m_timer.start();
+    m_importer->start(m_paths, m_isRecursive);
+}
+
+void ImportBenchmark::resultsAvailable()
+{
+    Metadata metadata;
+
+    while (m_importer->takeResult(metadata)) {
+        if (metadata.isEmpty()) {
+            ++m_failedCount;
+            continue;
+        }
+        if (metadata.value("isProbed").toBool()) {
+            ++m_probedCount;
+            m_probeMilliseconds = m_timer.elapsed();
+            continue;
+        }
+        ++m_fileCount;
+        m_byteCount += metadata["fileSize"].toLongLong();
+
+        if (m_fileCount % rssSampleInterval != 0)
+            continue;
+        const qint64 rss = processStatusSize("VmRSS");
+        if (m_baselineRss < 0)
+            m_baselineRss = rss;
+        else
+            m_maxRssGrowth = qMax(m_maxRssGrowth, rss - m_baselineRss);
+    }
+}
+
+void ImportBenchmark::importFinished()
+{
+    resultsAvailable();
+
+    // Reads through io_uring do not show in the read call counter, which
+    // counts small reads of settings and /proc files too.
+    const qint64 readCalls = processIoCounter("syscr") - m_readCalls;
+    const int fileCount = qMax(1, m_fileCount + m_failedCount);
+    const qint64 milliseconds = qMax(qint64(1), m_timer.elapsed());
+    const double seconds = milliseconds / 1000.0;
+    const double mebibytes = m_byteCount / (1024.0 * 1024.0);
+
+    QTextStream cout(stdout);
+    cout << "read mode:  " << readModeToString(m_importer->readMode())
+         << endl;
+    cout << "files:      " << m_fileCount << endl;
+    if (m_probedCount) {
+        cout << "probed:     " << m_probedCount << " in "
+             << m_probeMilliseconds / 1000.0 << " s" << endl;
+    }
+    cout << "failed:     " << m_failedCount << endl;
+    cout << "seconds:    " << seconds << endl;
+    cout << "files/s:    " << m_fileCount / seconds << endl;
+    cout << "MiB read:   " << mebibytes << endl;
+    cout << "MiB/s:      " << mebibytes / seconds << endl;
+    // Reading every file once shows up as bytes per file close to the
+    // average file size.
+    cout << "bytes/file: " << m_importer->bytesRead() / fileCount
+         << " read, average " << m_byteCount / qMax(1, m_fileCount)
+         << " in files" << endl;
+    if (m_importer->readMode() == ThreadedReadMode)
+        cout << "reads/file: " << double(readCalls) / fileCount << endl;
+    else
+        cout << "reads/file: not counted for io_uring reads" << endl;
+    cout << "peak RSS:   " << processStatusSize("VmHWM") / (1024 * 1024)
+         << " MiB" << endl;
+    // Resident memory growing with the number of files shows up here as
+    // a growth far larger than what the first files needed.
+    cout << "RSS growth: " << m_maxRssGrowth / (1024 * 1024)
+         << " MiB after the first " << rssSampleInterval << " files"
+         << endl;
+
+    const QMap<QString, qint64> busyTimes(deviceBusyTimes(m_devices));
+    foreach (QString device, busyTimes.keys()) {
+        const qint64 busyTime = busyTimes[device]
+            - m_deviceBusyTimes.value(device, busyTimes[device]);
+        cout << "busy:       " << device << " "
+             << qMin(100.0, 100.0 * busyTime / milliseconds) << " %"
+             << endl;
+    }
+
+    emit finished(0);
+}
@@ -0,0 +1,69 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BENCHMARK_HH
+#define BENCHMARK_HH
+
+#include <QtCore>
+
+#include "importer.hh"
+
+// Runs the import pipeline over a set of files without touching the
+// catalog and prints how fast the files went through it. Thumbnails are
+// always regenerated so that every file is read and decoded. Resident
+// memory is sampled while importing to show whether it stays flat, and the
+// utilisation of the devices holding the files shows whether reads keep
+// them busy. Bytes read per file, as counted by the importer, and read
+// calls per file show how many times each file is read. When files are
+// probed first, the time by which all of them had been catalogued is
+// printed too.
+class ImportBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    ImportBenchmark(const QStringList& paths, bool recursive,
+                    IoOrder ioOrder, ReadMode readMode,
+                    QObject* parent = 0);
+
+public slots:
+    void start();
+
+signals:
+    void finished(int exitCode);
+
+private slots:
+    void resultsAvailable();
+    void importFinished();
+
+private:
+    QStringList m_paths;
+    bool m_isRecursive;
+    Importer* m_importer;
+    QElapsedTimer m_timer;
+    int m_fileCount;
+    int m_failedCount;
+    int m_probedCount;
+    qint64 m_probeMilliseconds;
+    qint64 m_byteCount;
+    qint64 m_baselineRss;
+    qint64 m_maxRssGrowth;
+    QStringList m_devices;
+    QMap<QString, qint64> m_deviceBusyTimes;
+    qint64 m_readCalls;
+};
+
+#endif // BENCHMARK_HH
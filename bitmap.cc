@@ -0,0 +1,518 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include "bitmap.hh"
+
+static int popcount(const quint64 word)
+{
+    return __builtin_popcountll(word);
+}
+
+Bitmap::Container::Container()
+    :array()
+    ,words()
+    ,count(0)
+{
+}
+
+bool Bitmap::Container::isBitset() const
+{
+    return !words.isEmpty();
+}
+
+bool Bitmap::Container::contains(const quint16 low) const
+{
+    if (isBitset())
+        return words[low >> 6] & (quint64(1) << (low & 63));
+
+    return std::binary_search(array.constBegin(), array.constEnd(), low);
+}
+
+void Bitmap::Container::add(const quint16 low)
+{
+    if (isBitset()) {
+        quint64& word = words[low >> 6];
+        const quint64 bit = quint64(1) << (low & 63);
+        if (!(word & bit)) {
+            word |= bit;
+            ++count;
+        }
+        return;
+    }
+
+    QVector<quint16>::iterator i = std::lower_bound(array.begin(),
+                                                    array.end(), low);
+    if (i != array.end() && *i == low)
+        return;
+    array.insert(i, low);
+    ++count;
+    if (count > ArrayMax)
+        toBitset();
+}
+
+void Bitmap::Container::remove(const quint16 low)
+{
+    if (isBitset()) {
+        quint64& word = words[low >> 6];
+        const quint64 bit = quint64(1) << (low & 63);
+        if (word & bit) {
+            word &= ~bit;
+            --count;
+        }
+        optimize(ArrayMin);
+        return;
+    }
+
+    QVector<quint16>::iterator i = std::lower_bound(array.begin(),
+                                                    array.end(), low);
+    if (i == array.end() || *i != low)
+        return;
+    array.erase(i);
+    --count;
+}
+
+void Bitmap::Container::toBitset()
+{
+    if (isBitset())
+        return;
+
+    words.fill(0, BitsetWords);
+    for (int i = 0; i < array.size(); ++i)
+        words[array[i] >> 6] |= quint64(1) << (array[i] & 63);
+    array.clear();
+}
+
+// Switches a bitset container back to an array once it has at most
+// arrayMax members.
+void Bitmap::Container::optimize(const int arrayMax)
+{
+    if (!isBitset() || count > arrayMax)
+        return;
+
+    array.clear();
+    array.reserve(count);
+    for (int i = 0; i < BitsetWords; ++i) {
+        quint64 word = words[i];
+        while (word) {
+            const int bit = __builtin_ctzll(word);
+            array.append(quint16(i * 64 + bit));
+            word &= word - 1;
+        }
+    }
+    words.clear();
+}
+
+Bitmap::Bitmap()
+    :m_keys()
+    ,m_containers()
+{
+}
+
+int Bitmap::find(const quint16 key) const
+{
+    QVector<quint16>::const_iterator i = std::lower_bound(m_keys.constBegin(),
+                                                          m_keys.constEnd(),
+                                                          key);
+    const int position = i - m_keys.constBegin();
+    if (i != m_keys.constEnd() && *i == key)
+        return position;
+
+    return -position - 1;
+}
+
+Bitmap::Container& Bitmap::container(const quint16 key)
+{
+    int i = find(key);
+    if (i < 0) {
+        i = -i - 1;
+        m_keys.insert(i, key);
+        m_containers.insert(i, Container());
+    }
+    return m_containers[i];
+}
+
+void Bitmap::add(const quint32 value)
+{
+    container(value >> 16).add(quint16(value));
+}
+
+void Bitmap::addRange(const quint32 first, const quint32 last)
+{
+    for (quint32 key = first >> 16; key <= last >> 16; ++key) {
+        const quint32 low = key == first >> 16 ? first & 0xffff : 0;
+        const quint32 high = key == last >> 16 ? last & 0xffff : 0xffff;
+        Container& c = container(key);
+        if (high - low + 1 + c.count > quint32(ArrayMax))
+            c.toBitset();
+        for (quint32 i = low; i <= high; ++i)
+            c.add(quint16(i));
+    }
+}
+
+void Bitmap::remove(const quint32 value)
+{
+    const int i = find(value >> 16);
+    if (i < 0)
+        return;
+
+    m_containers[i].remove(quint16(value));
+    if (m_containers[i].count == 0) {
+        m_keys.remove(i);
+        m_containers.remove(i);
+    }
+}
+
+bool Bitmap::contains(const quint32 value) const
+{
+    const int i = find(value >> 16);
+    if (i < 0)
+        return false;
+
+    return m_containers[i].contains(quint16(value));
+}
+
+int Bitmap::count() const
+{
+    int n = 0;
+    for (int i = 0; i < m_containers.size(); ++i)
+        n += m_containers[i].count;
+    return n;
+}
+
+bool Bitmap::isEmpty() const
+{
+    return m_keys.isEmpty();
+}
+
+void Bitmap::clear()
+{
+    m_keys.clear();
+    m_containers.clear();
+}
+
+QVector<quint32> Bitmap::values() const
+{
+    QVector<quint32> result;
+    result.reserve(count());
+
+    for (int i = 0; i < m_keys.size(); ++i) {
+        const quint32 high = quint32(m_keys[i]) << 16;
+        const Container& c = m_containers[i];
+        if (!c.isBitset()) {
+            for (int j = 0; j < c.array.size(); ++j)
+                result.append(high | c.array[j]);
+            continue;
+        }
+        for (int j = 0; j < BitsetWords; ++j) {
+            quint64 word = c.words[j];
+            while (word) {
+                result.append(high | (j * 64 + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+
+    return result;
+}
+
+static void extendRanges(QList<Bitmap::Range>& ranges, const quint32 value)
+{
+    if (!ranges.isEmpty() && ranges.last().second + 1 == value)
+        ranges.last().second = value;
+    else
+        ranges.append(Bitmap::Range(value, value));
+}
+
+QList<Bitmap::Range> Bitmap::ranges() const
+{
+    QList<Range> result;
+
+    for (int i = 0; i < m_keys.size(); ++i) {
+        const quint32 high = quint32(m_keys[i]) << 16;
+        const Container& c = m_containers[i];
+        if (!c.isBitset()) {
+            for (int j = 0; j < c.array.size(); ++j)
+                extendRanges(result, high | c.array[j]);
+            continue;
+        }
+        for (int j = 0; j < BitsetWords; ++j) {
+            quint64 word = c.words[j];
+            while (word) {
+                extendRanges(result, high | (j * 64 + __builtin_ctzll(word)));
+                word &= word - 1;
+            }
+        }
+    }
+
+    return result;
+}
+
+Bitmap::Container Bitmap::intersect(const Container& a, const Container& b)
+{
+    Container result;
+
+    if (a.isBitset() && b.isBitset()) {
+        result.words.resize(BitsetWords);
+        const quint64* x = a.words.constData();
+        const quint64* y = b.words.constData();
+        quint64* z = result.words.data();
+        int n = 0;
+        for (int i = 0; i < BitsetWords; ++i) {
+            z[i] = x[i] & y[i];
+            n += popcount(z[i]);
+        }
+        result.count = n;
+        result.optimize(ArrayMax);
+        return result;
+    }
+
+    if (a.isBitset() || b.isBitset()) {
+        const Container& sparse = a.isBitset() ? b : a;
+        const Container& dense = a.isBitset() ? a : b;
+        for (int i = 0; i < sparse.array.size(); ++i) {
+            if (dense.contains(sparse.array[i]))
+                result.array.append(sparse.array[i]);
+        }
+        result.count = result.array.size();
+        return result;
+    }
+
+    result.array.resize(qMin(a.count, b.count));
+    QVector<quint16>::iterator end = std::set_intersection(
+        a.array.constBegin(), a.array.constEnd(),
+        b.array.constBegin(), b.array.constEnd(),
+        result.array.begin());
+    result.array.resize(end - result.array.begin());
+    result.count = result.array.size();
+    return result;
+}
+
+Bitmap::Container Bitmap::unite(const Container& a, const Container& b)
+{
+    Container result;
+
+    if (!a.isBitset() && !b.isBitset() && a.count + b.count <= ArrayMax) {
+        result.array.resize(a.count + b.count);
+        QVector<quint16>::iterator end = std::set_union(
+            a.array.constBegin(), a.array.constEnd(),
+            b.array.constBegin(), b.array.constEnd(),
+            result.array.begin());
+        result.array.resize(end - result.array.begin());
+        result.count = result.array.size();
+        return result;
+    }
+
+    Container x(a);
+    Container y(b);
+    x.toBitset();
+    y.toBitset();
+    result.words.resize(BitsetWords);
+    const quint64* p = x.words.constData();
+    const quint64* q = y.words.constData();
+    quint64* z = result.words.data();
+    int n = 0;
+    for (int i = 0; i < BitsetWords; ++i) {
+        z[i] = p[i] | q[i];
+        n += popcount(z[i]);
+    }
+    result.count = n;
+    result.optimize(ArrayMax);
+    return result;
+}
+
+Bitmap::Container Bitmap::subtract(const Container& a, const Container& b)
+{
+    Container result;
+
+    if (!a.isBitset()) {
+        for (int i = 0; i < a.array.size(); ++i) {
+            if (!b.contains(a.array[i]))
+                result.array.append(a.array[i]);
+        }
+        result.count = result.array.size();
+        return result;
+    }
+
+    result.words = a.words;
+    quint64* z = result.words.data();
+    if (b.isBitset()) {
+        const quint64* y = b.words.constData();
+        int n = 0;
+        for (int i = 0; i < BitsetWords; ++i) {
+            z[i] &= ~y[i];
+            n += popcount(z[i]);
+        }
+        result.count = n;
+    } else {
+        result.count = a.count;
+        for (int i = 0; i < b.array.size(); ++i) {
+            const quint16 low = b.array[i];
+            const quint64 bit = quint64(1) << (low & 63);
+            if (z[low >> 6] & bit) {
+                z[low >> 6] &= ~bit;
+                --result.count;
+            }
+        }
+    }
+    result.optimize(ArrayMax);
+    return result;
+}
+
+int Bitmap::intersectionCount(const Container& a, const Container& b)
+{
+    if (a.isBitset() && b.isBitset()) {
+        const quint64* x = a.words.constData();
+        const quint64* y = b.words.constData();
+        int n = 0;
+        for (int i = 0; i < BitsetWords; ++i)
+            n += popcount(x[i] & y[i]);
+        return n;
+    }
+
+    // A bitset has no array to walk, whatever its count. Hysteresis lets
+    // a bitset hold fewer members than an array.
+    const Container& sparse = a.isBitset()
+        || (!b.isBitset() && a.count > b.count) ? b : a;
+    const Container& other = &sparse == &a ? b : a;
+    int n = 0;
+    for (int i = 0; i < sparse.array.size(); ++i) {
+        if (other.contains(sparse.array[i]))
+            ++n;
+    }
+    return n;
+}
+
+Bitmap Bitmap::operator&(const Bitmap& other) const
+{
+    Bitmap result;
+    int i = 0;
+    int j = 0;
+
+    while (i < m_keys.size() && j < other.m_keys.size()) {
+        if (m_keys[i] < other.m_keys[j]) {
+            ++i;
+        } else if (m_keys[i] > other.m_keys[j]) {
+            ++j;
+        } else {
+            Container c(intersect(m_containers[i], other.m_containers[j]));
+            if (c.count) {
+                result.m_keys.append(m_keys[i]);
+                result.m_containers.append(c);
+            }
+            ++i;
+            ++j;
+        }
+    }
+
+    return result;
+}
+
+Bitmap Bitmap::operator|(const Bitmap& other) const
+{
+    Bitmap result;
+    int i = 0;
+    int j = 0;
+
+    while (i < m_keys.size() || j < other.m_keys.size()) {
+        if (j == other.m_keys.size()
+            || (i < m_keys.size() && m_keys[i] < other.m_keys[j])) {
+            result.m_keys.append(m_keys[i]);
+            result.m_containers.append(m_containers[i]);
+            ++i;
+        } else if (i == m_keys.size() || m_keys[i] > other.m_keys[j]) {
+            result.m_keys.append(other.m_keys[j]);
+            result.m_containers.append(other.m_containers[j]);
+            ++j;
+        } else {
+            result.m_keys.append(m_keys[i]);
+            result.m_containers.append(unite(m_containers[i],
+                                             other.m_containers[j]));
+            ++i;
+            ++j;
+        }
+    }
+
+    return result;
+}
+
+Bitmap Bitmap::operator-(const Bitmap& other) const
+{
+    Bitmap result;
+    int j = 0;
+
+    for (int i = 0; i < m_keys.size(); ++i) {
+        while (j < other.m_keys.size() && other.m_keys[j] < m_keys[i])
+            ++j;
+        if (j == other.m_keys.size() || other.m_keys[j] != m_keys[i]) {
+            result.m_keys.append(m_keys[i]);
+            result.m_containers.append(m_containers[i]);
+            continue;
+        }
+        Container c(subtract(m_containers[i], other.m_containers[j]));
+        if (c.count) {
+            result.m_keys.append(m_keys[i]);
+            result.m_containers.append(c);
+        }
+    }
+
+    return result;
+}
+
+Bitmap& Bitmap::operator&=(const Bitmap& other)
+{
+    *this = *this & other;
+    return *this;
+}
+
+Bitmap& Bitmap::operator|=(const Bitmap& other)
+{
+    *this = *this | other;
+    return *this;
+}
+
+Bitmap& Bitmap::operator-=(const Bitmap& other)
+{
+    *this = *this - other;
+    return *this;
+}
+
+bool Bitmap::operator==(const Bitmap& other) const
+{
+    return values() == other.values();
+}
+
+int Bitmap::intersectionCount(const Bitmap& other) const
+{
+    int n = 0;
+    int i = 0;
+    int j = 0;
+
+    while (i < m_keys.size() && j < other.m_keys.size()) {
+        if (m_keys[i] < other.m_keys[j]) {
+            ++i;
+        } else if (m_keys[i] > other.m_keys[j]) {
+            ++j;
+        } else {
+            n += intersectionCount(m_containers[i], other.m_containers[j]);
+            ++i;
+            ++j;
+        }
+    }
+
+    return n;
+}
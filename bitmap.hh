@@ -0,0 +1,94 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BITMAP_HH
+#define BITMAP_HH
+
+#include <QtCore>
+
+// Compressed set of 32-bit integers in the spirit of Roaring bitmaps. The
+// value space is split into chunks of 65536 by the high 16 bits. A chunk
+// with few members stores its low bits in a sorted array, a chunk with
+// many members is a plain 65536-bit bitset. Set operations between two
+// bitsets are straight loops over 64-bit words which the compiler can
+// vectorize.
+class Bitmap
+{
+public:
+    // Inclusive range of consecutive members.
+    typedef QPair<quint32, quint32> Range;
+
+    Bitmap();
+
+    void add(quint32 value);
+    void addRange(quint32 first, quint32 last);
+    void remove(quint32 value);
+    bool contains(quint32 value) const;
+    int count() const;
+    bool isEmpty() const;
+    void clear();
+    QVector<quint32> values() const;
+    // Members as maximal runs of consecutive values, in ascending order.
+    QList<Range> ranges() const;
+
+    Bitmap operator&(const Bitmap& other) const;
+    Bitmap operator|(const Bitmap& other) const;
+    Bitmap operator-(const Bitmap& other) const;
+    Bitmap& operator&=(const Bitmap& other);
+    Bitmap& operator|=(const Bitmap& other);
+    Bitmap& operator-=(const Bitmap& other);
+    bool operator==(const Bitmap& other) const;
+
+    // Cardinality of the intersection without materializing it.
+    int intersectionCount(const Bitmap& other) const;
+
+private:
+    struct Container
+    {
+        Container();
+
+        bool isBitset() const;
+        bool contains(quint16 low) const;
+        void add(quint16 low);
+        void remove(quint16 low);
+        void toBitset();
+        void optimize(int arrayMax);
+
+        QVector<quint16> array;
+        QVector<quint64> words;
+        int count;
+    };
+
+    static const int BitsetWords = 1024;
+    static const int ArrayMax = 4096;
+    // A bitset shrinking by removals turns back into an array only well
+    // below ArrayMax, so that adding and removing members around the limit
+    // does not convert the container back and forth.
+    static const int ArrayMin = 2048;
+
+    static Container intersect(const Container& a, const Container& b);
+    static Container unite(const Container& a, const Container& b);
+    static Container subtract(const Container& a, const Container& b);
+    static int intersectionCount(const Container& a, const Container& b);
+
+    int find(quint16 key) const;
+    Container& container(quint16 key);
+
+    QVector<quint16> m_keys;
+    QVector<Container> m_containers;
+};
+
+#endif // BITMAP_HH
@@ -0,0 +1,136 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BOUNDEDQUEUE_HH
+#define BOUNDEDQUEUE_HH
+
+#include <QtCore>
+
+// Blocking FIFO queue with a fixed capacity, connecting the stages of a
+// pipeline. A producer blocks while the queue is full, which throttles
+// faster stages to the pace of slower ones, and a consumer blocks while
+// the queue is empty. Closing the queue tells consumers that no more items
+// will come; items already queued are still handed out.
+template <typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(const int capacity)
+        :m_capacity(qMax(1, capacity))
+        ,m_isClosed(false)
+    {
+    }
+
+    // Returns false if the queue was closed before the item fit in.
+    bool push(const T& item)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        while (m_items.size() >= m_capacity && !m_isClosed)
+            m_notFull.wait(&m_mutex);
+        if (m_isClosed)
+            return false;
+
+        m_items.enqueue(item);
+        m_notEmpty.wakeOne();
+        return true;
+    }
+
+    // Returns false once the queue is closed and drained.
+    bool pop(T& item)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        while (m_items.isEmpty() && !m_isClosed)
+            m_notEmpty.wait(&m_mutex);
+        if (m_items.isEmpty())
+            return false;
+
+        item = m_items.dequeue();
+        m_notFull.wakeOne();
+        return true;
+    }
+
+    bool tryPop(T& item)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        if (m_items.isEmpty())
+            return false;
+
+        item = m_items.dequeue();
+        m_notFull.wakeOne();
+        return true;
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+
+        m_isClosed = true;
+        m_notEmpty.wakeAll();
+        m_notFull.wakeAll();
+    }
+
+    // Closes the queue and drops the items in it.
+    void abort()
+    {
+        QMutexLocker locker(&m_mutex);
+
+        m_isClosed = true;
+        m_items.clear();
+        m_notEmpty.wakeAll();
+        m_notFull.wakeAll();
+    }
+
+    void reset()
+    {
+        QMutexLocker locker(&m_mutex);
+
+        m_isClosed = false;
+        m_items.clear();
+    }
+
+    void setCapacity(const int capacity)
+    {
+        QMutexLocker locker(&m_mutex);
+
+        m_capacity = qMax(1, capacity);
+        m_notFull.wakeAll();
+    }
+
+    int size() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_items.size();
+    }
+
+    int capacity() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_capacity;
+    }
+
+private:
+    mutable QMutex m_mutex;
+    QWaitCondition m_notEmpty;
+    QWaitCondition m_notFull;
+    QQueue<T> m_items;
+    int m_capacity;
+    bool m_isClosed;
+};
+
+#endif // BOUNDEDQUEUE_HH
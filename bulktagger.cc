@@ -0,0 +1,158 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QtSql>
+
+#include "bulktagger.hh"
+#include "library.hh"
+#include "textsearch.hh"
+
+// Ids per statement. Progress is reported after each statement and the
+// full-text index is rebuilt for this many rows at a time.
+static const quint64 chunkSize = 4096;
+
+BulkTagger::BulkTagger(QObject* parent)
+    :QObject(parent)
+    ,m_databaseName()
+    ,m_ids()
+    ,m_tag()
+    ,m_watcher(new QFutureWatcher<bool>(this))
+{
+    connect(m_watcher, SIGNAL(finished()), SLOT(workFinished()));
+}
+
+BulkTagger::~BulkTagger()
+{
+    m_watcher->waitForFinished();
+}
+
+void BulkTagger::start(const Bitmap& ids, const QString& tag)
+{
+    if (isRunning())
+        return;
+
+    m_databaseName = QSqlDatabase::database().databaseName();
+    m_ids = ids;
+    m_tag = tag;
+    m_watcher->setFuture(QtConcurrent::run(this, &BulkTagger::run));
+}
+
+bool BulkTagger::isRunning() const
+{
+    return m_watcher->isRunning();
+}
+
+const Bitmap& BulkTagger::ids() const
+{
+    return m_ids;
+}
+
+QString BulkTagger::tag() const
+{
+    return m_tag;
+}
+
+void BulkTagger::workFinished()
+{
+    emit finished(m_watcher->result());
+}
+
+// Tagging writes to a single library: its connection attaches no other
+// library, so the ids are local ids and the lookups go straight to the
+// Image table of the library.
+bool BulkTagger::run()
+{
+    const QString connectionName("BulkTagger");
+    bool isSuccessful;
+
+    if (isFederated()) {
+        qWarning() << "federated catalogs cannot be tagged";
+        return false;
+    }
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE",
+                                                    connectionName);
+        db.setDatabaseName(m_databaseName);
+        // The GUI connection may be holding the write lock for a while.
+        db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=30000");
+        if (!db.open()) {
+            qWarning() << "failed to open database for tagging:"
+                       << db.lastError().databaseText();
+            isSuccessful = false;
+        } else {
+            isSuccessful = tagImages(db);
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+
+    return isSuccessful;
+}
+
+bool BulkTagger::tagImages(QSqlDatabase db)
+{
+    if (!db.transaction()) {
+        qWarning() << "failed to begin tagging transaction:"
+                   << db.lastError().databaseText();
+        return false;
+    }
+
+    QSqlQuery query(db);
+    query.prepare("INSERT OR IGNORE INTO Tagging(file_path, tag)"
+                  "  SELECT file_path, ? FROM Image WHERE id BETWEEN ? AND ?");
+
+    const int total = m_ids.count();
+    int done = 0;
+    int reported = 0;
+
+    foreach (Bitmap::Range range, m_ids.ranges()) {
+        for (quint64 first = range.first; first <= range.second;
+             first += chunkSize) {
+            const quint64 last = qMin(first + chunkSize - 1,
+                                      quint64(range.second));
+            query.bindValue(0, m_tag);
+            query.bindValue(1, first);
+            query.bindValue(2, last);
+            if (!query.exec()) {
+                qWarning() << "failed to tag images:"
+                           << query.lastError().databaseText();
+                db.rollback();
+                return false;
+            }
+            if (!updateSearchText(first, last, db)) {
+                db.rollback();
+                return false;
+            }
+
+            done += last - first + 1;
+            if (done - reported >= int(chunkSize)) {
+                reported = done;
+                emit progressChanged(done, total);
+            }
+        }
+    }
+
+    if (!db.commit()) {
+        qWarning() << "failed to commit tagging transaction:"
+                   << db.lastError().databaseText();
+        db.rollback();
+        return false;
+    }
+    emit progressChanged(total, total);
+
+    return true;
+}
@@ -0,0 +1,59 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef BULKTAGGER_HH
+#define BULKTAGGER_HH
+
+#include <QtSql>
+
+#include "bitmap.hh"
+
+// Tags a set of images in a background transaction through its own
+// database connection. The ids are split into runs of consecutive ids and
+// every run is tagged with set-based statements over id ranges, so tagging
+// a large selection costs a few statements instead of a few per image.
+class BulkTagger : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BulkTagger(QObject* parent = 0);
+    ~BulkTagger();
+
+    void start(const Bitmap& ids, const QString& tag);
+    bool isRunning() const;
+
+    const Bitmap& ids() const;
+    QString tag() const;
+
+signals:
+    void progressChanged(int value, int maximum);
+    void finished(bool isSuccessful);
+
+private slots:
+    void workFinished();
+
+private:
+    bool run();
+    bool tagImages(QSqlDatabase db);
+
+    QString m_databaseName;
+    Bitmap m_ids;
+    QString m_tag;
+    QFutureWatcher<bool>* m_watcher;
+};
+
+#endif // BULKTAGGER_HH
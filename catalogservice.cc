@@ -0,0 +1,366 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "catalogservice.hh"
+#include "catalogsnapshot.hh"
+#include "library.hh"
+#include "locationsearch.hh"
+#include "textsearch.hh"
+
+static const char* const connectionName = "CatalogService";
+
+CatalogService::CatalogService(const QString& databaseName)
+    :QObject()
+    ,m_databaseName(databaseName)
+    ,m_thread()
+    ,m_sortKeysGeneration(0)
+    ,m_snapshotGeneration(0)
+    ,m_searchGeneration(0)
+{
+    qRegisterMetaType<qint64>("qint64");
+    qRegisterMetaType<Bitmap>("Bitmap");
+    qRegisterMetaType<QList<Metadata> >("QList<Metadata>");
+    qRegisterMetaType<SortKeys>("SortKeys");
+    qRegisterMetaType<TagIndex>("TagIndex");
+    qRegisterMetaType<FacetIndex>("FacetIndex");
+    qRegisterMetaType<Timeline>("Timeline");
+    qRegisterMetaType<SimilarityIndex>("SimilarityIndex");
+
+    moveToThread(&m_thread);
+    m_thread.start();
+    QMetaObject::invokeMethod(this, "open", Qt::QueuedConnection);
+}
+
+CatalogService::~CatalogService()
+{
+    QMetaObject::invokeMethod(this, "close", Qt::BlockingQueuedConnection);
+    m_thread.quit();
+    m_thread.wait();
+}
+
+void CatalogService::requestSortKeys()
+{
+    const int generation = m_sortKeysGeneration.fetchAndAddOrdered(1) + 1;
+    QMetaObject::invokeMethod(this, "loadSortKeys", Qt::QueuedConnection,
+                              Q_ARG(int, generation));
+}
+
+void CatalogService::requestIndexes()
+{
+    QMetaObject::invokeMethod(this, "loadIndexes", Qt::QueuedConnection);
+}
+
+void CatalogService::requestSnapshot()
+{
+    const int generation = m_snapshotGeneration.fetchAndAddOrdered(1) + 1;
+    QMetaObject::invokeMethod(this, "writeSnapshot", Qt::QueuedConnection,
+                              Q_ARG(int, generation));
+}
+
+void CatalogService::requestOutdatedImages()
+{
+    QMetaObject::invokeMethod(this, "findOutdatedImages",
+                              Qt::QueuedConnection);
+}
+
+void CatalogService::requestNearbyImages(const qint64 imageId,
+                                         const double radius)
+{
+    QMetaObject::invokeMethod(this, "selectNearbyImages",
+                              Qt::QueuedConnection,
+                              Q_ARG(qint64, imageId),
+                              Q_ARG(double, radius));
+}
+
+void CatalogService::requestImagesInBox(const double south,
+                                        const double west,
+                                        const double north,
+                                        const double east)
+{
+    QMetaObject::invokeMethod(this, "selectImagesInBox",
+                              Qt::QueuedConnection,
+                              Q_ARG(double, south), Q_ARG(double, west),
+                              Q_ARG(double, north), Q_ARG(double, east));
+}
+
+void CatalogService::requestFilePaths(const Bitmap& imageIds)
+{
+    QMetaObject::invokeMethod(this, "selectFilePaths", Qt::QueuedConnection,
+                              Q_ARG(Bitmap, imageIds));
+}
+
+void CatalogService::requestSearch(const QString& text)
+{
+    const int generation = m_searchGeneration.fetchAndAddOrdered(1) + 1;
+    QMetaObject::invokeMethod(this, "selectSearch", Qt::QueuedConnection,
+                              Q_ARG(QString, text),
+                              Q_ARG(int, generation));
+}
+
+void CatalogService::requestThumbnailJobs()
+{
+    QMetaObject::invokeMethod(this, "selectThumbnailJobs",
+                              Qt::QueuedConnection);
+}
+
+void CatalogService::updateThumbnails(const QList<Metadata>& jobs)
+{
+    QMetaObject::invokeMethod(this, "writeThumbnails", Qt::QueuedConnection,
+                              Q_ARG(QList<Metadata>, jobs));
+}
+
+void CatalogService::removeTag(const qint64 imageId, const QString& filePath,
+                               const QString& tag)
+{
+    QMetaObject::invokeMethod(this, "deleteTag", Qt::QueuedConnection,
+                              Q_ARG(qint64, imageId),
+                              Q_ARG(QString, filePath),
+                              Q_ARG(QString, tag));
+}
+
+void CatalogService::open()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    db.setDatabaseName(m_databaseName);
+    // Imports write through the GUI thread connection and may hold the
+    // write lock for a while.
+    db.setConnectOptions("QSQLITE_BUSY_TIMEOUT=30000");
+    if (!db.open() || !attachLibraries(db)) {
+        qCritical() << "failed to open catalog service database:"
+                    << db.lastError().databaseText();
+    }
+}
+
+void CatalogService::close()
+{
+    database().close();
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+QSqlDatabase CatalogService::database() const
+{
+    return QSqlDatabase::database(connectionName, false);
+}
+
+void CatalogService::loadSortKeys(const int generation)
+{
+    if (generation != m_sortKeysGeneration)
+        return;
+
+    SortKeys sortKeys;
+    if (sortKeys.load(database()))
+        emit sortKeysReady(sortKeys);
+    else
+        emit sortKeysFailed();
+}
+
+// An index which fails to load is delivered empty, the failure has been
+// warned about by the index itself.
+void CatalogService::loadIndexes()
+{
+    const QSqlDatabase db(database());
+    TagIndex tagIndex;
+    FacetIndex facetIndex;
+    Timeline timeline;
+    SimilarityIndex similarityIndex;
+
+    tagIndex.load(db);
+    facetIndex.load(db);
+    timeline.load(db);
+    similarityIndex.load(db);
+
+    emit indexesReady(tagIndex, facetIndex, timeline, similarityIndex);
+}
+
+void CatalogService::findOutdatedImages()
+{
+    QSqlQuery query(database());
+    QStringList filePaths;
+
+    query.setForwardOnly(true);
+    query.prepare("SELECT file_path FROM Image WHERE metadata_version < ?");
+    query.addBindValue(metadataVersion);
+    if (!query.exec()) {
+        qWarning() << "failed to find outdated images:"
+                   << query.lastError().databaseText();
+        return;
+    }
+    while (query.next())
+        filePaths.append(query.value(0).toString());
+
+    emit outdatedImagesFound(filePaths);
+}
+
+void CatalogService::selectNearbyImages(const qint64 imageId,
+                                        const double radius)
+{
+    const QSqlDatabase db(database());
+    double latitude;
+    double longitude;
+    Bitmap imageIds;
+
+    if (!imageLocation(imageId, &latitude, &longitude, db)) {
+        emit locationSearchFailed("The image does not have a location");
+        return;
+    }
+    if (!findImagesNear(latitude, longitude, radius, &imageIds, db)) {
+        emit locationSearchFailed("Failed to find nearby images");
+        return;
+    }
+
+    emit nearbyImagesFound(imageIds, radius);
+}
+
+void CatalogService::selectImagesInBox(const double south,
+                                       const double west,
+                                       const double north,
+                                       const double east)
+{
+    Bitmap imageIds;
+
+    if (!findImagesInBox(south, west, north, east, &imageIds, database())) {
+        emit locationSearchFailed("Failed to find images in the area");
+        return;
+    }
+
+    emit imagesInBoxFound(imageIds);
+}
+
+// Every library is looked up by its own primary key.
+void CatalogService::selectFilePaths(const Bitmap& imageIds)
+{
+    QSqlQuery query(database());
+    QStringList filePaths;
+
+    query.setForwardOnly(true);
+    foreach (Bitmap::Range range, imageIds.ranges()) {
+        foreach (LibraryIdRange libraryRange,
+                 libraryIdRanges(range.first, range.second)) {
+            query.prepare(QString("SELECT file_path FROM %1"
+                                  "  WHERE id BETWEEN ? AND ?")
+                          .arg(libraryTable(libraryRange.library, "Image")));
+            query.addBindValue(libraryRange.first);
+            query.addBindValue(libraryRange.last);
+            if (!query.exec()) {
+                qWarning() << "failed to look up file paths:"
+                           << query.lastError().databaseText();
+                continue;
+            }
+            while (query.next())
+                filePaths.append(query.value(0).toString());
+        }
+    }
+
+    emit filePathsFound(filePaths);
+}
+
+void CatalogService::selectSearch(const QString& text,
+                                  const int generation)
+{
+    if (generation != m_searchGeneration)
+        return;
+
+    Bitmap imageIds;
+    const bool isSuccessful = searchImages(text, &imageIds, database());
+    emit searchFinished(text, imageIds, isSuccessful);
+}
+
+void CatalogService::selectThumbnailJobs()
+{
+    QSqlQuery query(database());
+    QList<Metadata> jobs;
+
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT id, file_path, exif_orientation FROM Image")) {
+        qWarning() << "failed to list images for thumbnail regeneration:"
+                   << query.lastError().databaseText();
+        return;
+    }
+    while (query.next()) {
+        Metadata metadata;
+        metadata.insert("id", query.value(0));
+        metadata.insert("filePath", query.value(1));
+        metadata.insert("orientation", query.value(2));
+        jobs.append(metadata);
+    }
+
+    emit thumbnailJobsFound(jobs);
+}
+
+// Images whose thumbnails could not be made keep their old ones.
+void CatalogService::writeThumbnails(const QList<Metadata>& jobs)
+{
+    QSqlDatabase db(database());
+    QSqlQuery query(db);
+
+    db.transaction();
+    query.prepare("UPDATE Image SET thumbnail_file_path = ?,"
+                  "  thumbnail_pixel_width = ?, thumbnail_pixel_height = ?,"
+                  "  phash = COALESCE(?, phash)"
+                  "  WHERE id = ?");
+    foreach (const Metadata& metadata, jobs) {
+        if (!metadata.value("isThumbnailed").toBool())
+            continue;
+        const QSize size(metadata.value("thumbnailImageSize").toSize());
+        query.addBindValue(metadata.value("thumbnailFilePath"));
+        query.addBindValue(size.width());
+        query.addBindValue(size.height());
+        query.addBindValue(metadata.value("perceptualHash"));
+        query.addBindValue(metadata.value("id"));
+        if (!query.exec())
+            qWarning() << "failed to update thumbnails:"
+                       << query.lastError().databaseText();
+    }
+    if (!db.commit()) {
+        qWarning() << "failed to commit thumbnail updates:"
+                   << db.lastError().databaseText();
+        db.rollback();
+        emit thumbnailsUpdated(false);
+        return;
+    }
+
+    emit thumbnailsUpdated(true);
+}
+
+void CatalogService::writeSnapshot(const int generation)
+{
+    if (generation != m_snapshotGeneration)
+        return;
+
+    if (CatalogSnapshot::write(CatalogSnapshot::filePath(m_databaseName),
+                               database()))
+        emit snapshotWritten();
+}
+
+void CatalogService::deleteTag(const qint64 imageId, const QString& filePath,
+                               const QString& tag)
+{
+    QSqlDatabase db(database());
+    QSqlQuery query(db);
+
+    db.transaction();
+    query.prepare("DELETE FROM Tagging WHERE file_path = ? AND tag = ?");
+    query.addBindValue(filePath);
+    query.addBindValue(tag);
+    if (!query.exec() || query.numRowsAffected() == 0
+        || !updateSearchText(imageId, imageId, db) || !db.commit()) {
+        db.rollback();
+        emit tagRemoved(imageId, tag, false);
+        return;
+    }
+
+    emit tagRemoved(imageId, tag, true);
+}
@@ -0,0 +1,116 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CATALOGSERVICE_HH
+#define CATALOGSERVICE_HH
+
+#include <QtSql>
+
+#include "bitmap.hh"
+#include "facetindex.hh"
+#include "metadata.hh"
+#include "similarityindex.hh"
+#include "sortkeys.hh"
+#include "tagindex.hh"
+#include "timeline.hh"
+
+// Runs catalog queries on a thread of its own, through a database
+// connection owned by that thread, so that the GUI thread never waits for
+// SQLite. Requests return immediately and their results are delivered as
+// signals to the thread which made them.
+//
+// Lookups are coalesced: a lookup still waiting in the queue when a newer
+// lookup of the same kind is requested is dropped.
+class CatalogService : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CatalogService(const QString& databaseName);
+    ~CatalogService();
+
+    void requestSortKeys();
+    // Loads the in-memory indexes of the catalog. Requests made after this
+    // one are served after the indexes have been delivered.
+    void requestIndexes();
+    // Rewrites the catalog snapshot of the database.
+    void requestSnapshot();
+    // Finds the images an older metadata version catalogued.
+    void requestOutdatedImages();
+    // Finds the images within the given distance in metres of the
+    // location of the image.
+    void requestNearbyImages(qint64 imageId, double radius);
+    void requestImagesInBox(double south, double west, double north,
+                            double east);
+    // Looks up the file paths of the images, in id order.
+    void requestFilePaths(const Bitmap& imageIds);
+    // Searches the full-text index, see searchImages().
+    void requestSearch(const QString& text);
+    // Lists the id, file path and orientation of every image, for making
+    // their thumbnails again.
+    void requestThumbnailJobs();
+    // Records the thumbnails made by the jobs which have isThumbnailed
+    // set, in one transaction.
+    void updateThumbnails(const QList<Metadata>& jobs);
+    void removeTag(qint64 imageId, const QString& filePath,
+                   const QString& tag);
+
+signals:
+    void sortKeysReady(const SortKeys& sortKeys);
+    void sortKeysFailed();
+    void indexesReady(const TagIndex& tagIndex, const FacetIndex& facetIndex,
+                      const Timeline& timeline,
+                      const SimilarityIndex& similarityIndex);
+    void snapshotWritten();
+    void outdatedImagesFound(const QStringList& filePaths);
+    void nearbyImagesFound(const Bitmap& imageIds, double radius);
+    void imagesInBoxFound(const Bitmap& imageIds);
+    void locationSearchFailed(const QString& message);
+    void filePathsFound(const QStringList& filePaths);
+    void searchFinished(const QString& text, const Bitmap& imageIds,
+                        bool isSuccessful);
+    void thumbnailJobsFound(const QList<Metadata>& jobs);
+    void thumbnailsUpdated(bool isSuccessful);
+    void tagRemoved(qint64 imageId, const QString& tag, bool isSuccessful);
+
+private slots:
+    void open();
+    void close();
+    void loadSortKeys(int generation);
+    void loadIndexes();
+    void writeSnapshot(int generation);
+    void findOutdatedImages();
+    void selectNearbyImages(qint64 imageId, double radius);
+    void selectImagesInBox(double south, double west, double north,
+                           double east);
+    void selectFilePaths(const Bitmap& imageIds);
+    void selectSearch(const QString& text, int generation);
+    void selectThumbnailJobs();
+    void writeThumbnails(const QList<Metadata>& jobs);
+    void deleteTag(qint64 imageId, const QString& filePath,
+                   const QString& tag);
+
+private:
+    QSqlDatabase database() const;
+
+    QString m_databaseName;
+    QThread m_thread;
+    QAtomicInt m_sortKeysGeneration;
+    QAtomicInt m_snapshotGeneration;
+    QAtomicInt m_searchGeneration;
+};
+
+#endif // CATALOGSERVICE_HH
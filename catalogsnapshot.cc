@@ -0,0 +1,373 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "catalogsnapshot.hh"
+#include "library.hh"
+
+static const char magic[8] = {'S', 'Q', 'I', 'M', 'S', 'N', 'A', 'P'};
+
+struct CatalogSnapshot::Header
+{
+    char magic[8];
+    quint32 version;
+    quint32 recordSize;
+    qint64 generation;
+    quint32 count;
+    quint32 reserved;
+    quint64 stringsSize;
+};
+
+// Orders record indexes by the ids of the records, and record indexes
+// against a plain id for binary searches.
+class RecordIdLess
+{
+public:
+    explicit RecordIdLess(const CatalogSnapshot::Record* records)
+        :m_records(records)
+    {
+    }
+
+    bool operator()(const quint32 a, const quint32 b) const
+    {
+        return m_records[a].id < m_records[b].id;
+    }
+
+    bool operator()(const quint32 a, const qint64 b) const
+    {
+        return m_records[a].id < b;
+    }
+
+private:
+    const CatalogSnapshot::Record* m_records;
+};
+
+static void appendString(QByteArray& strings, const QString& string,
+                         quint32* offset, quint32* size)
+{
+    const QByteArray utf8(string.toUtf8());
+
+    *offset = quint32(strings.size());
+    *size = quint32(utf8.size());
+    strings.append(utf8);
+}
+
+static bool writeAll(QFile& file, const void* data, const qint64 size)
+{
+    return file.write(static_cast<const char*>(data), size) == size;
+}
+
+// Times are stored as seconds, the database has them as text without a
+// time zone which SQLite reads as UTC.
+static QDateTime wallClockTime(const qint64 seconds)
+{
+    const QDateTime utc(QDateTime::fromMSecsSinceEpoch(seconds * 1000)
+                        .toUTC());
+
+    return QDateTime(utc.date(), utc.time());
+}
+
+CatalogSnapshot::CatalogSnapshot()
+    :m_file()
+    ,m_data(0)
+    ,m_header(0)
+    ,m_records(0)
+    ,m_idOrder(0)
+    ,m_strings(0)
+{
+}
+
+CatalogSnapshot::~CatalogSnapshot()
+{
+    close();
+}
+
+// A federated catalog has a snapshot of its own next to the main library,
+// named after the set of libraries it federates.
+QString CatalogSnapshot::filePath(const QString& databaseName)
+{
+    if (!isFederated())
+        return databaseName + ".snapshot";
+
+    const QByteArray key(libraries().join("\n").toUtf8());
+    return QString("%1.%2.snapshot").arg(databaseName).arg(
+        QString(QCryptographicHash::hash(key, QCryptographicHash::Md5)
+                .toHex().left(16)));
+}
+
+qint64 CatalogSnapshot::generation(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+
+    if (!query.exec("SELECT value FROM Generation") || !query.next()) {
+        qWarning() << "failed to read the catalog generation:"
+                   << query.lastError().databaseText();
+        return -1;
+    }
+
+    return query.value(0).toLongLong();
+}
+
+bool CatalogSnapshot::write(const QString& filePath, QSqlDatabase db)
+{
+    QVector<Record> records;
+    QByteArray strings;
+
+    // The generation and the rows are read in one transaction so that
+    // they match.
+    if (!db.transaction()) {
+        qWarning() << "failed to begin catalog snapshot transaction:"
+                   << db.lastError().databaseText();
+        return false;
+    }
+
+    const qint64 currentGeneration = generation(db);
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (currentGeneration < 0
+        || !query.exec("SELECT id,"
+                       "  COALESCE(CAST(strftime('%s', exif_datetime)"
+                       "                AS INTEGER), 0),"
+                       "  COALESCE(CAST(strftime('%s', mtime)"
+                       "                AS INTEGER), 0),"
+                       "  file_size, pixel_width, pixel_height,"
+                       "  exif_orientation, thumbnail_file_path,"
+                       "  thumbnail_pixel_width, thumbnail_pixel_height,"
+                       "  file_path"
+                       " FROM Image ORDER BY file_path")) {
+        qWarning() << "failed to read catalog snapshot rows:"
+                   << query.lastError().databaseText();
+        db.rollback();
+        return false;
+    }
+
+    while (query.next()) {
+        Record record;
+        memset(&record, 0, sizeof(record));
+        record.id = query.value(0).toLongLong();
+        record.captureTime = query.value(1).toLongLong();
+        record.modificationTime = query.value(2).toLongLong();
+        record.fileSize = query.value(3).toLongLong();
+        record.pixelWidth = query.value(4).toInt();
+        record.pixelHeight = query.value(5).toInt();
+        record.orientation = query.value(6).toInt();
+        appendString(strings, query.value(7).toString(),
+                     &record.thumbnailFilePathOffset,
+                     &record.thumbnailFilePathSize);
+        record.thumbnailPixelWidth = query.value(8).toInt();
+        record.thumbnailPixelHeight = query.value(9).toInt();
+        appendString(strings, query.value(10).toString(),
+                     &record.filePathOffset, &record.filePathSize);
+        records.append(record);
+    }
+    query.finish();
+    db.commit();
+
+    QVector<quint32> idOrder(records.size());
+    for (int i = 0; i < idOrder.size(); ++i)
+        idOrder[i] = quint32(i);
+    std::sort(idOrder.begin(), idOrder.end(),
+              RecordIdLess(records.constData()));
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = formatVersion;
+    header.recordSize = sizeof(Record);
+    header.generation = currentGeneration;
+    header.count = quint32(records.size());
+    header.stringsSize = quint64(strings.size());
+
+    const QString temporaryFilePath(filePath + ".tmp");
+    QFile file(temporaryFilePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "failed to open catalog snapshot for writing:"
+                   << file.errorString();
+        return false;
+    }
+    if (!writeAll(file, &header, sizeof(header))
+        || !writeAll(file, records.constData(),
+                     qint64(records.size()) * sizeof(Record))
+        || !writeAll(file, idOrder.constData(),
+                     qint64(idOrder.size()) * sizeof(quint32))
+        || !writeAll(file, strings.constData(), strings.size())
+        || !file.flush() || fsync(file.handle()) != 0) {
+        qWarning() << "failed to write catalog snapshot:"
+                   << file.errorString();
+        file.close();
+        file.remove();
+        return false;
+    }
+    file.close();
+
+    // Unlike QFile::rename(), rename() replaces the old snapshot
+    // atomically.
+    if (rename(QFile::encodeName(temporaryFilePath).constData(),
+               QFile::encodeName(filePath).constData()) != 0) {
+        qWarning() << "failed to replace catalog snapshot:"
+                   << strerror(errno);
+        QFile::remove(temporaryFilePath);
+        return false;
+    }
+
+    return true;
+}
+
+bool CatalogSnapshot::open(const QString& filePath, const qint64 generation)
+{
+    close();
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 fileSize = m_file.size();
+    if (fileSize < qint64(sizeof(Header))) {
+        qWarning() << "catalog snapshot is truncated:" << filePath;
+        close();
+        return false;
+    }
+
+    m_data = m_file.map(0, fileSize);
+    if (!m_data) {
+        qWarning() << "failed to map catalog snapshot:"
+                   << m_file.errorString();
+        close();
+        return false;
+    }
+
+    const Header* header = reinterpret_cast<const Header*>(m_data);
+    if (memcmp(header->magic, magic, sizeof(magic)) != 0
+        || header->version != formatVersion
+        || header->recordSize != sizeof(Record)
+        || quint64(fileSize) != sizeof(Header)
+           + quint64(header->count) * (sizeof(Record) + sizeof(quint32))
+           + header->stringsSize) {
+        qWarning() << "catalog snapshot is not valid:" << filePath;
+        close();
+        return false;
+    }
+
+    // A snapshot of an older generation is stale, not broken.
+    if (header->generation != generation) {
+        close();
+        return false;
+    }
+
+    const Record* records = reinterpret_cast<const Record*>(
+        m_data + sizeof(Header));
+    const quint32* idOrder = reinterpret_cast<const quint32*>(
+        records + header->count);
+
+    // Lookups index the records with the id order entries and binary
+    // search them by id, so the entries have to be in range and sorted.
+    for (quint32 i = 0; i < header->count; ++i) {
+        if (idOrder[i] >= header->count
+            || (i > 0 && records[idOrder[i]].id
+                <= records[idOrder[i - 1]].id)) {
+            qWarning() << "catalog snapshot is not valid:" << filePath;
+            close();
+            return false;
+        }
+    }
+
+    m_header = header;
+    m_records = records;
+    m_idOrder = idOrder;
+    m_strings = reinterpret_cast<const char*>(m_idOrder + header->count);
+
+    return true;
+}
+
+void CatalogSnapshot::close()
+{
+    if (m_data)
+        m_file.unmap(m_data);
+    m_file.close();
+
+    m_data = 0;
+    m_header = 0;
+    m_records = 0;
+    m_idOrder = 0;
+    m_strings = 0;
+}
+
+bool CatalogSnapshot::isOpen() const
+{
+    return m_header != 0;
+}
+
+int CatalogSnapshot::size() const
+{
+    return m_header ? int(m_header->count) : 0;
+}
+
+const CatalogSnapshot::Record& CatalogSnapshot::at(const int index) const
+{
+    return m_records[index];
+}
+
+int CatalogSnapshot::indexOf(const qint64 id) const
+{
+    if (!m_header)
+        return -1;
+
+    const quint32* end = m_idOrder + m_header->count;
+    const quint32* i = std::lower_bound(m_idOrder, end, id,
+                                        RecordIdLess(m_records));
+    if (i == end || m_records[*i].id != id)
+        return -1;
+
+    return int(*i);
+}
+
+QSqlRecord CatalogSnapshot::record(const int index,
+                                   const QSqlRecord& columns) const
+{
+    const Record& r = m_records[index];
+    QSqlRecord result(columns);
+
+    result.setValue("id", r.id);
+    result.setValue("file_path", string(r.filePathOffset, r.filePathSize));
+    result.setValue("file_size", r.fileSize);
+    result.setValue("mtime", wallClockTime(r.modificationTime));
+    result.setValue("pixel_width", r.pixelWidth);
+    result.setValue("pixel_height", r.pixelHeight);
+    result.setValue("exif_datetime", wallClockTime(r.captureTime));
+    result.setValue("exif_orientation", r.orientation);
+    result.setValue("thumbnail_file_path",
+                    string(r.thumbnailFilePathOffset,
+                           r.thumbnailFilePathSize));
+    result.setValue("thumbnail_pixel_width", r.thumbnailPixelWidth);
+    result.setValue("thumbnail_pixel_height", r.thumbnailPixelHeight);
+
+    return result;
+}
+
+QString CatalogSnapshot::string(const quint32 offset,
+                                const quint32 size) const
+{
+    if (quint64(offset) + size > m_header->stringsSize)
+        return QString();
+
+    return QString::fromUtf8(m_strings + offset, int(size));
+}
@@ -0,0 +1,99 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CATALOGSNAPSHOT_HH
+#define CATALOGSNAPSHOT_HH
+
+#include <QtSql>
+
+// Memory-mapped binary copy of the Image table columns the grid shows,
+// for filling the grid at startup without reading the database. The
+// database stays the source of truth: every change to the Image table
+// bumps the catalog generation and a snapshot is only used while its
+// generation is the current one.
+//
+// The file is a header, fixed size records in path order, record indexes
+// in id order for lookups by id, and the UTF-8 paths the records point
+// to. Snapshots are written to a temporary file which is then renamed
+// over the old one, so a reader never sees a partial snapshot.
+class CatalogSnapshot
+{
+public:
+    static const quint32 formatVersion = 1;
+
+    struct Record
+    {
+        qint64 id;
+        // Seconds since the epoch, 0 if unknown.
+        qint64 captureTime;
+        qint64 modificationTime;
+        qint64 fileSize;
+        quint32 filePathOffset;
+        quint32 filePathSize;
+        quint32 thumbnailFilePathOffset;
+        quint32 thumbnailFilePathSize;
+        qint32 pixelWidth;
+        qint32 pixelHeight;
+        qint32 thumbnailPixelWidth;
+        qint32 thumbnailPixelHeight;
+        qint32 orientation;
+        qint32 reserved;
+    };
+
+    CatalogSnapshot();
+    ~CatalogSnapshot();
+
+    // Snapshot file of the given database.
+    static QString filePath(const QString& databaseName);
+    // Current catalog generation, or -1 if it cannot be read.
+    static qint64 generation(QSqlDatabase db = QSqlDatabase::database());
+    // Writes a snapshot of the catalog as it is in the database.
+    static bool write(const QString& filePath,
+                      QSqlDatabase db = QSqlDatabase::database());
+
+    // Maps the snapshot file. Fails if the file is not a valid snapshot
+    // of the given generation.
+    bool open(const QString& filePath, qint64 generation);
+    void close();
+    bool isOpen() const;
+
+    int size() const;
+    const Record& at(int index) const;
+    // Index of the record of the given image, or -1 if the image is not
+    // in the snapshot.
+    int indexOf(qint64 id) const;
+
+    // The given record as a row of the Image table with the given
+    // columns. Columns the snapshot does not have are left null.
+    QSqlRecord record(int index, const QSqlRecord& columns) const;
+
+private:
+    struct Header;
+
+    CatalogSnapshot(const CatalogSnapshot&);
+    CatalogSnapshot& operator=(const CatalogSnapshot&);
+
+    QString string(quint32 offset, quint32 size) const;
+
+    QFile m_file;
+    uchar* m_data;
+    const Header* m_header;
+    const Record* m_records;
+    const quint32* m_idOrder;
+    const char* m_strings;
+};
+
+#endif // CATALOGSNAPSHOT_HH
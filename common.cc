@@ -68,3 +68,34 @@ QString imageSizeToString(const QSize& size)
     return QString("%1 x %2 (%3 megapixels)")
         .arg(w).arg(h).arg(w * h / 1000000.0, 0, 'f', 1);
 }
+
+// Thumbnail edge lengths to generate, smallest first. Every configured
+// size is generated for every configured device pixel ratio, so that
+// high density screens get sharp thumbnails too.
+QList<int> thumbnailLevels()
+{
+    QSettings settings;
+    const QStringList sizes(settings.value("thumbnails/sizes", "80,160,320")
+                            .toString().split(',', QString::SkipEmptyParts));
+    const QStringList ratios(settings.value("thumbnails/pixelRatios", "1,2")
+                             .toString().split(',', QString::SkipEmptyParts));
+    QList<int> levels;
+
+    foreach (QString size, sizes) {
+        foreach (QString ratio, ratios) {
+            const int level = size.toInt() * ratio.toInt();
+            if (level > 0 && !levels.contains(level))
+                levels.append(level);
+        }
+    }
+    if (levels.isEmpty())
+        levels.append(80);
+    qSort(levels);
+
+    return levels;
+}
+
+QString thumbnailFilePath(const QString& filePath, const int size)
+{
+    return cacheDir(filePath).filePath(QString("thumbnail-%1.png").arg(size));
+}
@@ -23,5 +23,7 @@ QDir cacheDir(const QString& filePath);
 bool makeCacheDir(const QString& filePath);
 QString fileSizeToString(const qint64 bytes);
 QString imageSizeToString(const QSize& size);
+QList<int> thumbnailLevels();
+QString thumbnailFilePath(const QString& filePath, int size);
 
 #endif // COMMON_HH
@@ -0,0 +1,89 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "exportdialog.hh"
+
+ExportDialog::ExportDialog(Exporter* const exporter, const int imageCount,
+                           QWidget* const parent)
+    :QDialog(parent)
+    ,m_exporter(exporter)
+    ,m_directoryEdit(new QLineEdit(this))
+    ,m_maximumSizeSpinBox(new QSpinBox(this))
+    ,m_qualitySpinBox(new QSpinBox(this))
+    ,m_fileNameTemplateEdit(new QLineEdit(this))
+{
+    setWindowTitle(QString("Export %1 images").arg(imageCount));
+
+    QPushButton* browseButton = new QPushButton("&Browse...", this);
+    connect(browseButton, SIGNAL(clicked()), SLOT(browse()));
+    QHBoxLayout* directoryLayout = new QHBoxLayout();
+    directoryLayout->addWidget(m_directoryEdit);
+    directoryLayout->addWidget(browseButton);
+
+    m_maximumSizeSpinBox->setRange(0, 100000);
+    m_maximumSizeSpinBox->setSuffix(" px");
+    m_maximumSizeSpinBox->setSpecialValueText("Original size");
+    m_qualitySpinBox->setRange(1, 100);
+    m_fileNameTemplateEdit->setToolTip(
+        "{name}: file name without suffix\n"
+        "{index}: position in the export\n"
+        "{date}: capture date\n"
+        "{time}: capture time\n"
+        "A slash starts a subdirectory.");
+
+    m_directoryEdit->setText(m_exporter->targetDirectory());
+    m_maximumSizeSpinBox->setValue(m_exporter->maximumSize());
+    m_qualitySpinBox->setValue(m_exporter->quality());
+    m_fileNameTemplateEdit->setText(m_exporter->fileNameTemplate());
+
+    QDialogButtonBox* buttonBox = new QDialogButtonBox(
+        QDialogButtonBox::Ok | QDialogButtonBox::Cancel, Qt::Horizontal,
+        this);
+    connect(buttonBox, SIGNAL(accepted()), SLOT(accept()));
+    connect(buttonBox, SIGNAL(rejected()), SLOT(reject()));
+
+    QFormLayout* layout = new QFormLayout(this);
+    layout->addRow("&Directory", directoryLayout);
+    layout->addRow("&Longest side", m_maximumSizeSpinBox);
+    layout->addRow("&Quality", m_qualitySpinBox);
+    layout->addRow("File &names", m_fileNameTemplateEdit);
+    layout->addRow(buttonBox);
+}
+
+void ExportDialog::accept()
+{
+    const QString fileNameTemplate(m_fileNameTemplateEdit->text().trimmed());
+
+    if (m_directoryEdit->text().isEmpty() || fileNameTemplate.isEmpty())
+        return;
+
+    m_exporter->setTargetDirectory(m_directoryEdit->text());
+    m_exporter->setMaximumSize(m_maximumSizeSpinBox->value());
+    m_exporter->setQuality(m_qualitySpinBox->value());
+    m_exporter->setFileNameTemplate(fileNameTemplate);
+    m_exporter->saveSettings();
+
+    QDialog::accept();
+}
+
+void ExportDialog::browse()
+{
+    const QString directory(QFileDialog::getExistingDirectory(
+                                this, "Export to", m_directoryEdit->text()));
+
+    if (!directory.isEmpty())
+        m_directoryEdit->setText(directory);
+}
@@ -0,0 +1,48 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EXPORTDIALOG_HH
+#define EXPORTDIALOG_HH
+
+#include <QtGui>
+
+#include "exporter.hh"
+
+// Asks for the target directory, size, quality and file name template of
+// an export. The exporter's options are shown first and are set, and
+// saved, when the dialog is accepted.
+class ExportDialog : public QDialog
+{
+    Q_OBJECT
+
+public:
+    ExportDialog(Exporter* exporter, int imageCount, QWidget* parent = 0);
+
+public slots:
+    virtual void accept();
+
+private slots:
+    void browse();
+
+private:
+    Exporter* m_exporter;
+    QLineEdit* m_directoryEdit;
+    QSpinBox* m_maximumSizeSpinBox;
+    QSpinBox* m_qualitySpinBox;
+    QLineEdit* m_fileNameTemplateEdit;
+};
+
+#endif // EXPORTDIALOG_HH
@@ -0,0 +1,424 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "exporter.hh"
+#include "library.hh"
+#include "orientedscale.hh"
+
+static const char* const connectionName = "Exporter";
+
+// Images are looked up this many at a time.
+static const int feedChunkSize = 256;
+
+QHash<qint64, Metadata> imagesToExport(const Bitmap& ids, QSqlDatabase db)
+{
+    QHash<qint64, Metadata> images;
+    QList<QSqlQuery> queries;
+
+    // Each library is looked up by its own primary key.
+    for (int i = 0; i < qMax(1, libraries().size()); ++i) {
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        query.prepare(QString("SELECT id, file_path, exif_orientation,"
+                              "  exif_datetime"
+                              " FROM %1 WHERE id BETWEEN ? AND ?")
+                      .arg(libraryTable(i, "Image")));
+        queries.append(query);
+    }
+
+    foreach (Bitmap::Range range, ids.ranges()) {
+        foreach (LibraryIdRange libraryRange,
+                 libraryIdRanges(range.first, range.second)) {
+            QSqlQuery& query = queries[libraryRange.library];
+            query.bindValue(0, libraryRange.first);
+            query.bindValue(1, libraryRange.last);
+            if (!query.exec()) {
+                qWarning() << "failed to list images to export:"
+                           << query.lastError().databaseText();
+                continue;
+            }
+            while (query.next()) {
+                Metadata metadata;
+                metadata.insert("filePath", query.value(1));
+                metadata.insert("orientation", query.value(2));
+                metadata.insert("timestamp", query.value(3).toDateTime());
+                images.insert(globalImageId(libraryRange.library,
+                                            query.value(0).toLongLong()),
+                              metadata);
+            }
+        }
+    }
+
+    return images;
+}
+
+// Size of the exported image in display orientation.
+static QSize exportSize(const QSize& size, const int maximumSize)
+{
+    if (maximumSize <= 0
+        || (size.width() <= maximumSize && size.height() <= maximumSize))
+        return size;
+
+    return size.scaled(maximumSize, maximumSize, Qt::KeepAspectRatio)
+        .expandedTo(QSize(1, 1));
+}
+
+ExportJob::ExportJob()
+    :filePath()
+    ,targetFilePath()
+    ,orientation(1)
+    ,isValid(true)
+    ,data()
+    ,readCharge(0)
+    ,image()
+{
+}
+
+Exporter::Exporter(QObject* parent)
+    :QObject(parent)
+    ,m_targetDirectory()
+    ,m_maximumSize(0)
+    ,m_quality(85)
+    ,m_fileNameTemplate("{name}")
+    ,m_databaseName()
+    ,m_ids()
+    ,m_doneCount(0)
+    ,m_failedCount(0)
+    ,m_isCanceled(0)
+    ,m_isRunning(0)
+{
+}
+
+Exporter::~Exporter()
+{
+    cancel();
+    waitForFinished();
+}
+
+void Exporter::loadSettings()
+{
+    QSettings settings;
+
+    setTargetDirectory(settings.value("export/directory",
+                                      QDir::homePath()).toString());
+    setMaximumSize(settings.value("export/maximumSize", 2048).toInt());
+    setQuality(settings.value("export/quality", 85).toInt());
+    setFileNameTemplate(settings.value("export/fileNameTemplate",
+                                       "{name}").toString());
+}
+
+void Exporter::saveSettings() const
+{
+    QSettings settings;
+
+    settings.setValue("export/directory", targetDirectory());
+    settings.setValue("export/maximumSize", m_maximumSize);
+    settings.setValue("export/quality", m_quality);
+    settings.setValue("export/fileNameTemplate", m_fileNameTemplate);
+}
+
+QString Exporter::targetDirectory() const
+{
+    return m_targetDirectory.absolutePath();
+}
+
+void Exporter::setTargetDirectory(const QString& directory)
+{
+    m_targetDirectory = QDir(directory);
+}
+
+int Exporter::maximumSize() const
+{
+    return m_maximumSize;
+}
+
+void Exporter::setMaximumSize(const int size)
+{
+    m_maximumSize = qMax(0, size);
+}
+
+int Exporter::quality() const
+{
+    return m_quality;
+}
+
+void Exporter::setQuality(const int quality)
+{
+    m_quality = qBound(0, quality, 100);
+}
+
+QString Exporter::fileNameTemplate() const
+{
+    return m_fileNameTemplate;
+}
+
+void Exporter::setFileNameTemplate(const QString& fileNameTemplate)
+{
+    m_fileNameTemplate = fileNameTemplate;
+}
+
+void Exporter::start(const QList<qint64>& ids)
+{
+    m_databaseName = QSqlDatabase::database().databaseName();
+    m_ids = ids;
+    m_doneCount = 0;
+    m_failedCount = 0;
+    m_isCanceled = 0;
+    m_isRunning = 1;
+
+    configure(PipelineSettings());
+    startPass();
+}
+
+void Exporter::cancel()
+{
+    m_isCanceled = 1;
+    abortPass();
+}
+
+bool Exporter::isCanceled() const
+{
+    return m_isCanceled;
+}
+
+bool Exporter::isRunning() const
+{
+    return m_isRunning;
+}
+
+void Exporter::waitForFinished()
+{
+    waitForPass();
+}
+
+int Exporter::imageCount() const
+{
+    return m_ids.size();
+}
+
+int Exporter::failedCount() const
+{
+    return m_failedCount;
+}
+
+QString Exporter::fileName(const QString& fileNameTemplate,
+                           const Metadata& metadata, const int index,
+                           const int count)
+{
+    const QDateTime timestamp(metadata.value("timestamp").toDateTime());
+    const int indexWidth = QString::number(count).size();
+    QString name(fileNameTemplate);
+
+    name.replace("{name}", QFileInfo(metadata.value("filePath").toString())
+                 .completeBaseName());
+    name.replace("{index}", QString("%1").arg(index + 1, indexWidth, 10,
+                                              QChar('0')));
+    name.replace("{date}", timestamp.toString("yyyy-MM-dd"));
+    name.replace("{time}", timestamp.toString("HHmmss"));
+
+    return name;
+}
+
+bool Exporter::complete(Job& job)
+{
+    if (!job.isValid)
+        m_failedCount.ref();
+    const int done = m_doneCount.fetchAndAddOrdered(1) + 1;
+    emit progressChanged(done, m_ids.size());
+    return true;
+}
+
+// The catalog is read through a connection of the feed thread, the
+// thread which started the export does not wait for it.
+void Exporter::feed()
+{
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE",
+                                                    connectionName);
+        db.setDatabaseName(m_databaseName);
+        if (!db.open() || !attachLibraries(db)) {
+            qWarning() << "failed to open the catalog for export:"
+                       << db.lastError().databaseText();
+            m_isCanceled = 1;
+        }
+
+        QSet<QString> targetFilePaths;
+        for (int i = 0; i < m_ids.size() && !m_isCanceled;
+             i += feedChunkSize) {
+            if (!feed(i, qMin(feedChunkSize, m_ids.size() - i),
+                      targetFilePaths, db))
+                break;
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+// Target paths are chosen here, in export order, so that clashing names
+// get the same suffixes every time. Images no longer in the catalog fail.
+bool Exporter::feed(const int first, const int count,
+                    QSet<QString>& targetFilePaths, QSqlDatabase db)
+{
+    Bitmap ids;
+    for (int i = first; i < first + count; ++i)
+        ids.add(quint32(m_ids[i]));
+    const QHash<qint64, Metadata> images(imagesToExport(ids, db));
+
+    for (int i = first; i < first + count; ++i) {
+        if (m_isCanceled)
+            return false;
+
+        Job job;
+        if (!images.contains(m_ids[i])) {
+            job.isValid = false;
+            if (!m_readQueue.push(job))
+                return false;
+            continue;
+        }
+
+        const Metadata& metadata = images[m_ids[i]];
+        const QString name(fileName(m_fileNameTemplate, metadata, i,
+                                    m_ids.size()));
+        QString targetFilePath(m_targetDirectory.absoluteFilePath(
+                                   name + ".jpg"));
+        for (int n = 2; targetFilePaths.contains(targetFilePath); ++n) {
+            targetFilePath = m_targetDirectory.absoluteFilePath(
+                QString("%1-%2.jpg").arg(name).arg(n));
+        }
+        targetFilePaths.insert(targetFilePath);
+
+        job.filePath = metadata.value("filePath").toString();
+        job.targetFilePath = targetFilePath;
+        job.orientation = metadata.value("orientation").toInt();
+        if (!m_readQueue.push(job))
+            return false;
+    }
+
+    return true;
+}
+
+void Exporter::passFinished()
+{
+    m_isRunning = 0;
+    emit finished();
+}
+
+void Exporter::read(Job& job)
+{
+    if (!job.isValid)
+        return;
+
+    QFile file(job.filePath);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "failed to open " << job.filePath << ": "
+                   << file.errorString();
+        job.isValid = false;
+        return;
+    }
+    if (!m_readBudget.acquire(file.size())) {
+        job.isValid = false;
+        return;
+    }
+    job.readCharge = file.size();
+    job.data = file.readAll();
+}
+
+void Exporter::decode(Job& job)
+{
+    if (!job.isValid)
+        return;
+
+    QBuffer buffer(&job.data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+
+    // Decoders which can, JPEG among them, decode straight to a fraction
+    // of the full size. Twice the export size is asked for, the rest of
+    // the way is left to the box filter which keeps the result smooth.
+    const QSize imageSize(reader.size());
+    QSize decodeSize(imageSize);
+    if (imageSize.isValid()) {
+        const QSize size(orientedSize(
+                             exportSize(orientedSize(imageSize,
+                                                     job.orientation),
+                                        m_maximumSize),
+                             job.orientation) * 2);
+        if (size.width() < imageSize.width()
+            && size.height() < imageSize.height()) {
+            decodeSize = size;
+            reader.setScaledSize(decodeSize);
+        }
+    }
+
+    // The reservation is held until the decoded image is freed.
+    PixelReservation reservation(
+        &m_pixelBudget,
+        decodeSize.isValid()
+        ? qint64(decodeSize.width()) * decodeSize.height() : 0);
+    if (!reservation.isAcquired()) {
+        job.isValid = false;
+        return;
+    }
+
+    const QImage image(reader.read());
+    job.data.clear();
+    if (image.isNull()) {
+        qWarning() << "failed to decode " << job.filePath << ": "
+                   << reader.errorString();
+        job.isValid = false;
+        return;
+    }
+
+    const QSize displaySize(orientedSize(imageSize.isValid()
+                                         ? imageSize : image.size(),
+                                         job.orientation));
+    job.image = orientedScaled(image, job.orientation,
+                               exportSize(displaySize, m_maximumSize));
+}
+
+void Exporter::write(Job& job)
+{
+    if (!job.isValid)
+        return;
+
+    // JPEG has no transparency, transparent images are put on white.
+    QImage image(job.image);
+    job.image = QImage();
+    if (image.hasAlphaChannel()) {
+        QImage opaqueImage(image.size(), QImage::Format_RGB32);
+        opaqueImage.fill(qRgb(255, 255, 255));
+        QPainter painter(&opaqueImage);
+        painter.drawImage(0, 0, image);
+        painter.end();
+        image = opaqueImage;
+    }
+
+    if (!QDir().mkpath(QFileInfo(job.targetFilePath).absolutePath())) {
+        qWarning() << "failed to create the directory of "
+                   << job.targetFilePath;
+        job.isValid = false;
+        return;
+    }
+
+    QImageWriter writer(job.targetFilePath, "jpeg");
+    writer.setQuality(m_quality);
+    if (!writer.write(image)) {
+        qWarning() << "failed to write " << job.targetFilePath << ": "
+                   << writer.errorString();
+        job.isValid = false;
+    }
+}
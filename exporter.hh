@@ -0,0 +1,125 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef EXPORTER_HH
+#define EXPORTER_HH
+
+#include <QtSql>
+#include <QtGui>
+
+#include "bitmap.hh"
+#include "metadata.hh"
+#include "pipeline.hh"
+
+// Metadata of the catalogued images with the given ids, by id, as the
+// exporter needs it: file path, orientation and timestamp.
+QHash<qint64, Metadata> imagesToExport(
+    const Bitmap& ids, QSqlDatabase db = QSqlDatabase::database());
+
+// An image on its way through the export pipeline.
+struct ExportJob
+{
+    ExportJob();
+
+    QString filePath;
+    QString targetFilePath;
+    int orientation;
+    bool isValid;
+    QByteArray data;
+    // Bytes of the read budget held for the data, see Pipeline.
+    qint64 readCharge;
+    QImage image;
+};
+
+// Export pipeline writing resized JPEG copies of images, see Pipeline.
+// The feed stage looks the images up in the catalog through a connection
+// of its own, the decode stage decodes them, scaled down by the decoder
+// where the format allows it, and orients and resizes them in a single
+// pass, and the write stage encodes and saves the copies.
+//
+// Exported files are named after a template in which {name} stands for
+// the base name of the image, {index} for its position in the export,
+// {date} and {time} for its capture date and time. The template may name
+// subdirectories of the target directory. Existing files are replaced,
+// names which would clash within an export get a numbered suffix.
+class Exporter : public QObject, private Pipeline<ExportJob>
+{
+    Q_OBJECT
+
+public:
+    explicit Exporter(QObject* parent = 0);
+    ~Exporter();
+
+    // Export options are kept in the export/* settings.
+    void loadSettings();
+    void saveSettings() const;
+
+    QString targetDirectory() const;
+    void setTargetDirectory(const QString& directory);
+    // Longest side of the exported images, 0 keeps the original size.
+    // Images are never scaled up.
+    int maximumSize() const;
+    void setMaximumSize(int size);
+    int quality() const;
+    void setQuality(int quality);
+    QString fileNameTemplate() const;
+    void setFileNameTemplate(const QString& fileNameTemplate);
+
+    // Exports the images with the given ids, numbered in the given order.
+    void start(const QList<qint64>& ids);
+    void cancel();
+    bool isCanceled() const;
+    bool isRunning() const;
+    void waitForFinished();
+
+    int imageCount() const;
+    int failedCount() const;
+
+    // Expands the file name template for the given image, which is the
+    // index:th of count images.
+    static QString fileName(const QString& fileNameTemplate,
+                            const Metadata& metadata, int index, int count);
+
+signals:
+    void progressChanged(int value, int maximum);
+    void finished();
+
+private:
+    typedef ExportJob Job;
+
+    virtual void feed();
+    bool feed(int first, int count, QSet<QString>& targetFilePaths,
+              QSqlDatabase db);
+    virtual void read(Job& job);
+    virtual void decode(Job& job);
+    virtual void write(Job& job);
+    virtual bool complete(Job& job);
+    virtual void passFinished();
+
+    QDir m_targetDirectory;
+    int m_maximumSize;
+    int m_quality;
+    QString m_fileNameTemplate;
+    QString m_databaseName;
+    QList<qint64> m_ids;
+
+    QAtomicInt m_doneCount;
+    QAtomicInt m_failedCount;
+    QAtomicInt m_isCanceled;
+    QAtomicInt m_isRunning;
+};
+
+#endif // EXPORTER_HH
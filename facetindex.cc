@@ -0,0 +1,180 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include "facetindex.hh"
+
+FacetIndex::ImageValues::ImageValues()
+{
+    for (int i = 0; i < FacetCount; ++i)
+        ids[i] = -1;
+}
+
+FacetIndex::FacetIndex()
+    :m_imageValues()
+{
+}
+
+bool FacetIndex::load(QSqlDatabase db)
+{
+    clear();
+
+    // Images without a timestamp have the epoch, which is no year.
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT id, camera_make, camera_model, lens_model,"
+                    "  CASE WHEN julianday(exif_datetime) <> 2440587.5"
+                    "    THEN strftime('%Y', exif_datetime) END"
+                    "  FROM Image")) {
+        qWarning() << "failed to load facets:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+    while (query.next()) {
+        setImage(query.value(0).toUInt(),
+                 cameraName(query.value(1).toString(),
+                            query.value(2).toString()),
+                 query.value(3).toString().trimmed(),
+                 query.value(4).toString());
+    }
+
+    return true;
+}
+
+void FacetIndex::clear()
+{
+    for (int i = 0; i < FacetCount; ++i) {
+        m_values[i].ids.clear();
+        m_values[i].names.clear();
+        m_values[i].images.clear();
+    }
+    m_imageValues.clear();
+}
+
+void FacetIndex::setImage(const qint64 id, const QString& cameraMake,
+                          const QString& cameraModel,
+                          const QString& lensModel,
+                          const QDateTime& captureTime)
+{
+    QString year;
+    if (captureTime.isValid() && captureTime.toTime_t() != 0)
+        year = QString::number(captureTime.date().year());
+
+    setImage(quint32(id), cameraName(cameraMake, cameraModel),
+             lensModel.trimmed(), year);
+}
+
+void FacetIndex::setImage(const quint32 id, const QString& camera,
+                          const QString& lens, const QString& year)
+{
+    removeImage(id);
+
+    ImageValues imageValues;
+    imageValues.ids[CameraFacet] = internValue(CameraFacet, camera);
+    imageValues.ids[LensFacet] = internValue(LensFacet, lens);
+    imageValues.ids[YearFacet] = internValue(YearFacet, year);
+
+    bool hasValues = false;
+    for (int i = 0; i < FacetCount; ++i) {
+        if (imageValues.ids[i] >= 0) {
+            m_values[i].images[imageValues.ids[i]].add(id);
+            hasValues = true;
+        }
+    }
+    if (hasValues)
+        m_imageValues.insert(id, imageValues);
+}
+
+void FacetIndex::removeImage(const qint64 id)
+{
+    QHash<quint32, ImageValues>::iterator i
+        = m_imageValues.find(quint32(id));
+    if (i == m_imageValues.end())
+        return;
+
+    for (int facet = 0; facet < FacetCount; ++facet) {
+        const int valueId = i.value().ids[facet];
+        if (valueId >= 0)
+            m_values[facet].images[valueId].remove(quint32(id));
+    }
+    m_imageValues.erase(i);
+}
+
+QStringList FacetIndex::values(const Facet facet) const
+{
+    const Values& values = m_values[facet];
+    QStringList result;
+
+    for (int i = 0; i < values.names.size(); ++i) {
+        if (!values.images[i].isEmpty())
+            result << values.names[i];
+    }
+    result.sort();
+    if (facet == YearFacet)
+        std::reverse(result.begin(), result.end());
+
+    return result;
+}
+
+const Bitmap& FacetIndex::images(const Facet facet,
+                                 const QString& value) const
+{
+    static const Bitmap noImages;
+
+    const int valueId = m_values[facet].ids.value(value, -1);
+    if (valueId < 0)
+        return noImages;
+
+    return m_values[facet].images[valueId];
+}
+
+QString FacetIndex::cameraName(const QString& make, const QString& model)
+{
+    const QString trimmedMake(make.trimmed());
+    const QString trimmedModel(model.trimmed());
+
+    // Makes such as "NIKON CORPORATION" are repeated by their first word
+    // only, as in "NIKON D850".
+    const QString brand(trimmedMake.section(' ', 0, 0));
+    if (trimmedModel.isEmpty())
+        return trimmedMake;
+    if (brand.isEmpty()
+        || trimmedModel.startsWith(brand, Qt::CaseInsensitive))
+        return trimmedModel;
+
+    return trimmedMake + ' ' + trimmedModel;
+}
+
+// Values which lose their last image keep their id, so that ids held by
+// images never dangle; they are skipped when listing values.
+int FacetIndex::internValue(const Facet facet, const QString& value)
+{
+    if (value.isEmpty())
+        return -1;
+
+    Values& values = m_values[facet];
+    QHash<QString, int>::const_iterator i = values.ids.constFind(value);
+    if (i != values.ids.constEnd())
+        return i.value();
+
+    const int valueId = values.names.size();
+    values.ids.insert(value, valueId);
+    values.names.append(value);
+    values.images.append(Bitmap());
+
+    return valueId;
+}
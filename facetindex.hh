@@ -0,0 +1,78 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FACETINDEX_HH
+#define FACETINDEX_HH
+
+#include <QtSql>
+
+#include "bitmap.hh"
+
+// In-memory index from the camera, lens and capture year of the images to
+// their ids, one bitmap per distinct value like the tag index. Counting
+// the images of a value within a filter is an intersection count of two
+// bitmaps, so facet counts never need a GROUP BY over the catalog.
+class FacetIndex
+{
+public:
+    enum Facet { CameraFacet, LensFacet, YearFacet, FacetCount };
+
+    FacetIndex();
+
+    bool load(QSqlDatabase db = QSqlDatabase::database());
+    void clear();
+    // Sets the facet values of an image, replacing any it had before.
+    // Empty fields and timestamps at the epoch have no value.
+    void setImage(qint64 id, const QString& cameraMake,
+                  const QString& cameraModel, const QString& lensModel,
+                  const QDateTime& captureTime);
+    void removeImage(qint64 id);
+
+    // Values of the facet carried by at least one image. Years are in
+    // descending order, other values in sorted order.
+    QStringList values(Facet facet) const;
+    // Images carrying the value, empty if no image carries it.
+    const Bitmap& images(Facet facet, const QString& value) const;
+
+    // Camera name shown for a make and a model. Models usually repeat
+    // the make, in which case the model alone is the name.
+    static QString cameraName(const QString& make, const QString& model);
+
+private:
+    struct Values
+    {
+        QHash<QString, int> ids;
+        QVector<QString> names;
+        QVector<Bitmap> images;
+    };
+
+    // Value ids of an image per facet, -1 for none.
+    struct ImageValues
+    {
+        ImageValues();
+
+        int ids[FacetCount];
+    };
+
+    void setImage(quint32 id, const QString& camera, const QString& lens,
+                  const QString& year);
+    int internValue(Facet facet, const QString& value);
+
+    Values m_values[FacetCount];
+    QHash<quint32, ImageValues> m_imageValues;
+};
+
+#endif // FACETINDEX_HH
@@ -0,0 +1,174 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "facetwidget.hh"
+
+FacetWidget::FacetWidget(const FacetIndex* facetIndex,
+                         const TagIndex* tagIndex, QWidget* parent)
+    :QTreeWidget(parent)
+    ,m_facetIndex(facetIndex)
+    ,m_tagIndex(tagIndex)
+    ,m_scope()
+    ,m_hasScope(false)
+{
+    static const char* const facetNames[FacetCount] = {
+        "Camera", "Lens", "Year", "Tag"
+    };
+
+    setHeaderHidden(true);
+    setSelectionMode(QAbstractItemView::NoSelection);
+    for (int facet = 0; facet < FacetCount; ++facet) {
+        m_facetItems[facet] = new QTreeWidgetItem(this);
+        m_facetItems[facet]->setText(0, facetNames[facet]);
+        m_facetItems[facet]->setFlags(Qt::ItemIsEnabled);
+        m_facetItems[facet]->setExpanded(true);
+    }
+
+    connect(this, SIGNAL(itemClicked(QTreeWidgetItem*, int)),
+            SLOT(toggleValue(QTreeWidgetItem*)));
+}
+
+void FacetWidget::reload()
+{
+    setUpdatesEnabled(false);
+    for (int facet = 0; facet < FacetCount; ++facet) {
+        qDeleteAll(m_facetItems[facet]->takeChildren());
+        foreach (QString value, values(facet)) {
+            QTreeWidgetItem* item = new QTreeWidgetItem(m_facetItems[facet]);
+            item->setData(0, Qt::UserRole, value);
+        }
+    }
+    updateCounts();
+    setUpdatesEnabled(true);
+}
+
+void FacetWidget::setScope(const Bitmap* const images)
+{
+    m_hasScope = images != 0;
+    m_scope = images ? *images : Bitmap();
+
+    setUpdatesEnabled(false);
+    updateCounts();
+    setUpdatesEnabled(true);
+}
+
+bool FacetWidget::isFiltered() const
+{
+    for (int facet = 0; facet < FacetCount; ++facet) {
+        if (!m_choices[facet].isEmpty())
+            return true;
+    }
+
+    return false;
+}
+
+Bitmap FacetWidget::filter() const
+{
+    Bitmap result;
+    bool isFirst = true;
+
+    for (int facet = 0; facet < FacetCount; ++facet) {
+        if (m_choices[facet].isEmpty())
+            continue;
+        if (isFirst)
+            result = images(facet, m_choices[facet]);
+        else
+            result &= images(facet, m_choices[facet]);
+        isFirst = false;
+    }
+
+    return result;
+}
+
+void FacetWidget::clearFilter()
+{
+    for (int facet = 0; facet < FacetCount; ++facet)
+        m_choices[facet].clear();
+
+    setUpdatesEnabled(false);
+    updateCounts();
+    setUpdatesEnabled(true);
+}
+
+void FacetWidget::toggleValue(QTreeWidgetItem* const item)
+{
+    const int facet = indexOfTopLevelItem(item->parent());
+    if (facet < 0)
+        return;
+
+    const QString value(item->data(0, Qt::UserRole).toString());
+    if (m_choices[facet] == value)
+        m_choices[facet].clear();
+    else
+        m_choices[facet] = value;
+
+    setUpdatesEnabled(false);
+    updateCounts();
+    setUpdatesEnabled(true);
+    emit filterChanged();
+}
+
+QStringList FacetWidget::values(const int facet) const
+{
+    if (facet == TagFacet)
+        return m_tagIndex->tags();
+
+    return m_facetIndex->values(FacetIndex::Facet(facet));
+}
+
+const Bitmap& FacetWidget::images(const int facet,
+                                  const QString& value) const
+{
+    if (facet == TagFacet)
+        return m_tagIndex->images(value);
+
+    return m_facetIndex->images(FacetIndex::Facet(facet), value);
+}
+
+// Values no image in scope carries are hidden, unless chosen. Only the
+// counts are computed again, the values stay the same until reload().
+void FacetWidget::updateCounts()
+{
+    for (int facet = 0; facet < FacetCount; ++facet) {
+        const Bitmap* scope = m_hasScope ? &m_scope : 0;
+        Bitmap narrowedScope;
+        for (int other = 0; other < FacetCount; ++other) {
+            if (other == facet || m_choices[other].isEmpty())
+                continue;
+            const Bitmap& chosen = images(other, m_choices[other]);
+            narrowedScope = scope ? *scope & chosen : chosen;
+            scope = &narrowedScope;
+        }
+
+        QTreeWidgetItem* const facetItem = m_facetItems[facet];
+        for (int i = 0; i < facetItem->childCount(); ++i) {
+            QTreeWidgetItem* const item = facetItem->child(i);
+            const QString value(item->data(0, Qt::UserRole).toString());
+            const Bitmap& valueImages = images(facet, value);
+            const int count = scope
+                ? valueImages.intersectionCount(*scope)
+                : valueImages.count();
+            const bool isChosen = value == m_choices[facet];
+
+            item->setText(0, QString("%1 (%2)")
+                          .arg(value, locale().toString(count)));
+            QFont font(item->font(0));
+            font.setBold(isChosen);
+            item->setFont(0, font);
+            item->setHidden(count == 0 && !isChosen);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FACETWIDGET_HH
+#define FACETWIDGET_HH
+
+#include <QtGui>
+
+#include "facetindex.hh"
+#include "tagindex.hh"
+
+// Camera, lens, year and tag values of the catalog with their image
+// counts, such as "2019 (8,002)". Clicking a value narrows the grid to
+// its images and clicking it again lifts the restriction; at most one
+// value per facet is chosen at a time.
+//
+// Counts are of the images within the scope set by the other filters of
+// the grid and the values chosen in the other facets, so that every
+// count is the number of images clicking the value would show.
+class FacetWidget : public QTreeWidget
+{
+    Q_OBJECT
+
+public:
+    FacetWidget(const FacetIndex* facetIndex, const TagIndex* tagIndex,
+                QWidget* parent = 0);
+
+    // Lists the values again after the indexes have changed.
+    void reload();
+    // Images the counts are given within, all images if null.
+    void setScope(const Bitmap* images);
+
+    bool isFiltered() const;
+    // Images carrying every chosen value.
+    Bitmap filter() const;
+    // Unchooses every value without emitting filterChanged().
+    void clearFilter();
+
+signals:
+    void filterChanged();
+
+private slots:
+    void toggleValue(QTreeWidgetItem* item);
+
+private:
+    enum Facet { CameraFacet, LensFacet, YearFacet, TagFacet, FacetCount };
+
+    QStringList values(int facet) const;
+    const Bitmap& images(int facet, const QString& value) const;
+    void updateCounts();
+
+    const FacetIndex* m_facetIndex;
+    const TagIndex* m_tagIndex;
+    QTreeWidgetItem* m_facetItems[FacetCount];
+    QString m_choices[FacetCount];
+    Bitmap m_scope;
+    bool m_hasScope;
+};
+
+#endif // FACETWIDGET_HH
@@ -0,0 +1,453 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef SQIM_HAVE_IO_URING
+#include <liburing.h>
+#endif
+
+#include "filereader.hh"
+
+ReadMode readModeFromString(const QString& string, bool* ok)
+{
+    if (ok)
+        *ok = true;
+
+    if (string == "threads")
+        return ThreadedReadMode;
+    if (ok && !string.isEmpty() && string != "async")
+        *ok = false;
+    return AsyncReadMode;
+}
+
+QString readModeToString(const ReadMode mode)
+{
+    switch (mode) {
+    case ThreadedReadMode:
+        return "threads";
+    default:
+        return "async";
+    }
+}
+
+FileReader::Request::Request()
+    :filePath()
+    ,size(0)
+    ,tag(0)
+    ,isRead(false)
+    ,data()
+{
+}
+
+#ifdef SQIM_HAVE_IO_URING
+
+// User data of cancellation requests, reads carry the index of their slot.
+static const quintptr cancelUserData = ~quintptr(0);
+
+struct FileReader::Ring
+{
+    // A read in flight, the offset tells how much of the request's buffer
+    // has been filled by earlier, short reads.
+    struct Slot
+    {
+        Request request;
+        int fd;
+        qint64 size;
+        qint64 offset;
+    };
+
+    struct io_uring ring;
+    QVector<Slot> slots;
+    QList<int> freeSlots;
+    int unsubmittedCount;
+};
+
+// Queues a read of the rest of the buffer from the offset on. If the
+// submission queue is full, the queued reads are submitted to make room.
+static bool prepareRead(struct io_uring* const ring,
+                        int* const unsubmittedCount, const int fd,
+                        QByteArray& buffer, const qint64 offset,
+                        const int index)
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+
+    while (!sqe) {
+        const int error = io_uring_submit(ring);
+        if (error == -EINTR)
+            continue;
+        if (error < 0) {
+            qWarning() << "failed to submit reads:" << strerror(-error);
+            return false;
+        }
+        if (error == 0) {
+            qWarning() << "failed to submit reads: submission queue is full";
+            return false;
+        }
+        *unsubmittedCount = qMax(0, *unsubmittedCount - error);
+        sqe = io_uring_get_sqe(ring);
+    }
+
+    io_uring_prep_read(sqe, fd, buffer.data() + offset,
+                       unsigned(buffer.size() - offset), offset);
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(quintptr(index)));
+    ++*unsubmittedCount;
+    return true;
+}
+
+#else
+
+struct FileReader::Ring
+{
+};
+
+#endif // SQIM_HAVE_IO_URING
+
+FileReader::FileReader(const int depth)
+    :m_ring(0)
+    ,m_depth(qMax(1, depth))
+    ,m_inFlightCount(0)
+    ,m_completed()
+{
+#ifdef SQIM_HAVE_IO_URING
+    m_ring = new Ring;
+    // Cancellations take a submission entry of their own for every read.
+    const int error = io_uring_queue_init(2 * m_depth, &m_ring->ring, 0);
+    if (error < 0) {
+        qWarning() << "failed to set up io_uring, reading with threads:"
+                   << strerror(-error);
+        delete m_ring;
+        m_ring = 0;
+        return;
+    }
+    m_ring->slots.resize(m_depth);
+    for (int i = 0; i < m_depth; ++i)
+        m_ring->freeSlots.append(i);
+    m_ring->unsubmittedCount = 0;
+#endif
+}
+
+FileReader::~FileReader()
+{
+    cancel();
+#ifdef SQIM_HAVE_IO_URING
+    if (m_ring)
+        io_uring_queue_exit(&m_ring->ring);
+#endif
+    delete m_ring;
+}
+
+bool FileReader::isAsynchronous() const
+{
+    return m_ring;
+}
+
+int FileReader::depth() const
+{
+    return m_depth;
+}
+
+void FileReader::submit(const Request& request)
+{
+    Request submitted(request);
+
+    if (!m_ring) {
+        readSynchronously(submitted);
+        m_completed.enqueue(submitted);
+        return;
+    }
+
+    submitAsynchronously(submitted);
+}
+
+int FileReader::pendingCount() const
+{
+    return m_completed.size() + m_inFlightCount;
+}
+
+bool FileReader::isFull() const
+{
+    return pendingCount() >= m_depth;
+}
+
+bool FileReader::takeCompleted(Request& request)
+{
+    while (m_completed.isEmpty()) {
+        if (!m_inFlightCount)
+            return false;
+        if (!waitAsynchronously())
+            abortAsynchronously();
+    }
+
+    request = m_completed.dequeue();
+    return true;
+}
+
+void FileReader::cancel()
+{
+    if (m_inFlightCount)
+        abortAsynchronously();
+    m_completed.clear();
+}
+
+// Files are opened with an ordinary system call, which is served from the
+// inode cache, and sized by the caller. Reads are queued for submission
+// and submitted together once a completion is waited for, so that a burst
+// of requests costs one system call.
+#ifdef SQIM_HAVE_IO_URING
+void FileReader::submitAsynchronously(Request& request)
+{
+    const qint64 size = request.size;
+
+    if (size > INT_MAX) {
+        qWarning() << request.filePath << " is too large to read";
+        m_completed.enqueue(request);
+        return;
+    }
+    if (size <= 0) {
+        request.isRead = true;
+        m_completed.enqueue(request);
+        return;
+    }
+
+    const QByteArray path(QFile::encodeName(request.filePath));
+    const int fd = open(path.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        qWarning() << "failed to open " << request.filePath << ": "
+                   << strerror(errno);
+        m_completed.enqueue(request);
+        return;
+    }
+
+    const int index = m_ring->freeSlots.takeLast();
+    Ring::Slot& slot = m_ring->slots[index];
+    slot.request = request;
+    slot.request.data.resize(int(size));
+    slot.fd = fd;
+    slot.size = size;
+    slot.offset = 0;
+    if (!prepareRead(&m_ring->ring, &m_ring->unsubmittedCount, slot.fd,
+                     slot.request.data, slot.offset, index)) {
+        close(fd);
+        request.data.clear();
+        m_completed.enqueue(request);
+        slot.request = Request();
+        m_ring->freeSlots.append(index);
+        return;
+    }
+    ++m_inFlightCount;
+}
+
+// Short reads are resubmitted for the rest of the file. If the submission
+// is interrupted or refused for now and nothing has been submitted
+// earlier, there is no completion to wait for and the caller retries.
+bool FileReader::waitAsynchronously()
+{
+    if (m_ring->unsubmittedCount) {
+        const int error = io_uring_submit(&m_ring->ring);
+        if (error == -EINTR || error == -EAGAIN) {
+            if (m_inFlightCount - m_ring->unsubmittedCount <= 0)
+                return true;
+        } else if (error < 0) {
+            qWarning() << "failed to submit reads:" << strerror(-error);
+            return false;
+        } else {
+            m_ring->unsubmittedCount = qMax(0, m_ring->unsubmittedCount
+                                            - error);
+        }
+    }
+
+    struct io_uring_cqe* cqe;
+    const int error = io_uring_wait_cqe(&m_ring->ring, &cqe);
+    if (error == -EINTR || error == -EAGAIN)
+        return true;
+    if (error < 0) {
+        qWarning() << "failed to wait for reads:" << strerror(-error);
+        return false;
+    }
+
+    const quintptr userData = quintptr(io_uring_cqe_get_data(cqe));
+    const int result = cqe->res;
+    io_uring_cqe_seen(&m_ring->ring, cqe);
+    if (userData == cancelUserData)
+        return true;
+
+    const int index = int(userData);
+    Ring::Slot& slot = m_ring->slots[index];
+    if (result < 0) {
+        qWarning() << "failed to read " << slot.request.filePath << ": "
+                   << strerror(-result);
+        slot.request.data.clear();
+    } else {
+        slot.offset += result;
+        // A file which shrank while it was read is taken as it was.
+        if (result != 0 && slot.offset < slot.size) {
+            if (prepareRead(&m_ring->ring, &m_ring->unsubmittedCount,
+                            slot.fd, slot.request.data, slot.offset,
+                            index))
+                return true;
+            slot.request.data.clear();
+        } else {
+            slot.request.data.resize(int(slot.offset));
+            slot.request.isRead = true;
+        }
+    }
+
+    close(slot.fd);
+    m_completed.enqueue(slot.request);
+    slot.request = Request();
+    m_ring->freeSlots.append(index);
+    --m_inFlightCount;
+    return true;
+}
+
+// The buffers belong to the kernel until their reads complete, so the
+// reads in flight are canceled and waited for before they are handed back
+// unread. If the ring fails to deliver the completions, the buffers are
+// left to the kernel and the reader falls back to blocking reads.
+void FileReader::abortAsynchronously()
+{
+    QList<int> inFlight;
+    for (int i = 0; i < m_depth; ++i) {
+        if (!m_ring->freeSlots.contains(i))
+            inFlight.append(i);
+    }
+
+    foreach (int index, inFlight) {
+        struct io_uring_sqe* const sqe = io_uring_get_sqe(&m_ring->ring);
+        if (!sqe)
+            break;
+        io_uring_prep_cancel(sqe, reinterpret_cast<void*>(quintptr(index)),
+                             0);
+        io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(cancelUserData));
+    }
+    io_uring_submit(&m_ring->ring);
+    m_ring->unsubmittedCount = 0;
+
+    bool isFailed = false;
+    while (m_inFlightCount && !isFailed) {
+        struct io_uring_cqe* cqe;
+        struct __kernel_timespec timeout;
+        timeout.tv_sec = 1;
+        timeout.tv_nsec = 0;
+        const int error = io_uring_wait_cqe_timeout(&m_ring->ring, &cqe,
+                                                    &timeout);
+        if (error == -EINTR)
+            continue;
+        if (error < 0) {
+            isFailed = true;
+            break;
+        }
+
+        const quintptr userData = quintptr(io_uring_cqe_get_data(cqe));
+        io_uring_cqe_seen(&m_ring->ring, cqe);
+        if (userData == cancelUserData)
+            continue;
+
+        const int index = int(userData);
+        Ring::Slot& slot = m_ring->slots[index];
+        close(slot.fd);
+        slot.request.isRead = false;
+        slot.request.data.clear();
+        m_completed.enqueue(slot.request);
+        slot.request = Request();
+        m_ring->freeSlots.append(index);
+        --m_inFlightCount;
+    }
+
+    if (!isFailed)
+        return;
+
+    qWarning() << "failed to cancel reads, reading without io_uring";
+    for (int i = 0; i < m_depth; ++i) {
+        if (m_ring->freeSlots.contains(i))
+            continue;
+        Ring::Slot& slot = m_ring->slots[i];
+        // A reference to the buffer is leaked, the kernel may still
+        // write to it.
+        new QByteArray(slot.request.data);
+        close(slot.fd);
+        Request request(slot.request);
+        request.isRead = false;
+        request.data = QByteArray();
+        m_completed.enqueue(request);
+    }
+    m_inFlightCount = 0;
+    io_uring_queue_exit(&m_ring->ring);
+    delete m_ring;
+    m_ring = 0;
+}
+#else
+void FileReader::submitAsynchronously(Request& request)
+{
+    readSynchronously(request);
+    m_completed.enqueue(request);
+}
+
+bool FileReader::waitAsynchronously()
+{
+    return false;
+}
+
+void FileReader::abortAsynchronously()
+{
+    m_inFlightCount = 0;
+}
+#endif // SQIM_HAVE_IO_URING
+
+// A file which shrank since it was sized is taken as it is.
+void FileReader::readSynchronously(Request& request)
+{
+    if (request.size > INT_MAX) {
+        qWarning() << request.filePath << " is too large to read";
+        return;
+    }
+
+    const QByteArray path(QFile::encodeName(request.filePath));
+    const int fd = open(path.constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        qWarning() << "failed to open " << request.filePath << ": "
+                   << strerror(errno);
+        return;
+    }
+
+    request.data.resize(int(qMax(qint64(0), request.size)));
+    int offset = 0;
+    while (offset < request.data.size()) {
+        const ssize_t result = ::read(fd, request.data.data() + offset,
+                                      request.data.size() - offset);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result < 0) {
+            qWarning() << "failed to read " << request.filePath << ": "
+                       << strerror(errno);
+            close(fd);
+            request.data.clear();
+            return;
+        }
+        if (result == 0)
+            break;
+        offset += int(result);
+    }
+    close(fd);
+
+    request.data.resize(offset);
+    request.isRead = true;
+}
@@ -0,0 +1,95 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FILEREADER_HH
+#define FILEREADER_HH
+
+#include <QtCore>
+
+// Ways the import reads files.
+enum ReadMode {
+    // Every read thread reads one file at a time with blocking reads.
+    ThreadedReadMode,
+    // One thread keeps the reads of several files in flight at once
+    // through io_uring, so that the device sees a request per file.
+    // Builds without io_uring and kernels refusing to set up a ring read
+    // with threads instead.
+    AsyncReadMode
+};
+
+ReadMode readModeFromString(const QString& string, bool* ok = 0);
+QString readModeToString(ReadMode mode);
+
+// Reads whole files, or a prefix of them, keeping up to a given number of
+// reads in flight. Requests are submitted as room frees up and taken back
+// as they complete, in completion order. A reader is used by one thread at
+// a time.
+class FileReader
+{
+public:
+    struct Request
+    {
+        Request();
+
+        QString filePath;
+        // Bytes read from the start of the file, found by the caller so
+        // that the reader need not stat the file.
+        qint64 size;
+        // Tells the caller which of its requests completed.
+        int tag;
+        bool isRead;
+        QByteArray data;
+    };
+
+    // Sets up a submission queue for depth reads. If io_uring is not
+    // available, the reader is not asynchronous and a request is read as
+    // it is submitted.
+    explicit FileReader(int depth);
+    ~FileReader();
+
+    bool isAsynchronous() const;
+    int depth() const;
+
+    // Starts reading the file of the request. Must not be called while the
+    // reader is full.
+    void submit(const Request& request);
+    // Number of submitted requests which have not been taken back.
+    int pendingCount() const;
+    bool isFull() const;
+    // Waits for a request to complete and takes it back. Failures are
+    // reported and leave the request unread. Returns false if no request
+    // is pending.
+    bool takeCompleted(Request& request);
+    // Cancels the reads in flight and drops every pending request.
+    void cancel();
+
+    // Reads the file of the request with blocking reads.
+    static void readSynchronously(Request& request);
+
+private:
+    struct Ring;
+
+    void submitAsynchronously(Request& request);
+    bool waitAsynchronously();
+    void abortAsynchronously();
+
+    Ring* m_ring;
+    int m_depth;
+    int m_inFlightCount;
+    QQueue<Request> m_completed;
+};
+
+#endif // FILEREADER_HH
@@ -0,0 +1,46 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "filestatus.hh"
+
+FileStatus::FileStatus()
+    :device(0)
+    ,inode(0)
+    ,size(0)
+    ,lastModified()
+{
+}
+
+bool statFile(const QString& filePath, FileStatus* const status)
+{
+    struct stat st;
+
+    if (stat(QFile::encodeName(filePath).constData(), &st) != 0) {
+        qWarning() << "failed to stat " << filePath << ": "
+                   << strerror(errno);
+        return false;
+    }
+
+    status->device = st.st_dev;
+    status->inode = st.st_ino;
+    status->size = st.st_size;
+    status->lastModified = QDateTime::fromTime_t(uint(st.st_mtime));
+    return true;
+}
@@ -0,0 +1,38 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef FILESTATUS_HH
+#define FILESTATUS_HH
+
+#include <QtCore>
+
+// Details of a file from a single stat, carried along with the file so
+// that it is not stat'ed again.
+struct FileStatus
+{
+    FileStatus();
+
+    quint64 device;
+    quint64 inode;
+    qint64 size;
+    QDateTime lastModified;
+};
+
+// Stats the file, following symbolic links. Returns false, after warning,
+// if the file cannot be stat'ed.
+bool statFile(const QString& filePath, FileStatus* status);
+
+#endif // FILESTATUS_HH
@@ -14,14 +14,51 @@
 // You should have received a copy of the GNU General Public License
 // along with this program. If not, see <http://www.gnu.org/licenses/>.
 
+#include "common.hh"
 #include "imageitemdelegate.hh"
 
 ImageItemDelegate::ImageItemDelegate(QAbstractItemView* view, QObject *parent)
     : QStyledItemDelegate(parent)
     ,m_view(view)
+    ,m_thumbnailLevels(thumbnailLevels())
 {
 }
 
+// Returns the smallest stored thumbnail level at least as large as the
+// requested size, or the largest level if none is. Images imported before
+// thumbnail levels existed only have the thumbnail recorded in the
+// catalog.
+QPixmap ImageItemDelegate::thumbnail(const QModelIndex& index,
+                                     const int size) const
+{
+    const QString filePath(index.sibling(index.row(), 1).data().toString());
+    int level = m_thumbnailLevels.last();
+
+    foreach (int candidate, m_thumbnailLevels) {
+        if (candidate >= size) {
+            level = candidate;
+            break;
+        }
+    }
+
+    QPixmap pixmap;
+    const QString levelFilePath(thumbnailFilePath(filePath, level));
+    if (QPixmapCache::find(levelFilePath, &pixmap))
+        return pixmap;
+
+    if (pixmap.load(levelFilePath)) {
+        QPixmapCache::insert(levelFilePath, pixmap);
+        return pixmap;
+    }
+
+    const QString fallbackFilePath(index.data().toString());
+    if (!QPixmapCache::find(fallbackFilePath, &pixmap)
+        && pixmap.load(fallbackFilePath))
+        QPixmapCache::insert(fallbackFilePath, pixmap);
+
+    return pixmap;
+}
+
 void ImageItemDelegate::paint(QPainter *painter,
                               const QStyleOptionViewItem &option,
                               const QModelIndex &index) const
@@ -34,7 +71,15 @@ void ImageItemDelegate::paint(QPainter *painter,
     rect.setWidth(rect.width() - 3);
     rect.setHeight(rect.height() - 3);
 
-    painter->drawPixmap(rect, QPixmap(index.data().toString()));
+    int size = qMax(rect.width(), rect.height());
+#if QT_VERSION >= 0x050000
+    size *= painter->device()->devicePixelRatio();
+#endif
+
+    painter->save();
+    painter->setRenderHint(QPainter::SmoothPixmapTransform);
+    painter->drawPixmap(rect, thumbnail(index, size));
+    painter->restore();
 
     // Draw rects to create more distinctive visualization for item selection
     // and current item.
@@ -62,7 +107,6 @@ QSize ImageItemDelegate::sizeHint(const QStyleOptionViewItem& option,
     if (index.column() != 8)
         return QStyledItemDelegate::sizeHint(option, index);
 
-    int thumbnailPixelWidth = index.sibling(index.row(), 9).data().toInt();
-    int thumbnailPixelHeight = index.sibling(index.row(), 10).data().toInt();
-    return QSize(thumbnailPixelWidth, thumbnailPixelHeight);
+    // Thumbnails are square, the view's icon size is the zoom level.
+    return m_view->iconSize();
 }
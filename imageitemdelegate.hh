@@ -31,7 +31,10 @@ public:
     QSize sizeHint(const QStyleOptionViewItem& option, const QModelIndex& index) const;
 
 private:
+    QPixmap thumbnail(const QModelIndex& index, int size) const;
+
     QAbstractItemView* m_view;
+    QList<int> m_thumbnailLevels;
 
 };
 
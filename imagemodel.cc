@@ -0,0 +1,335 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "imagemodel.hh"
+#include "library.hh"
+
+// Rows are fetched from the database this many at a time, centered around
+// the row a view asked for.
+static const int fetchBlockSize = 128;
+
+ImageModel::ImageModel(QObject* parent)
+    :QAbstractTableModel(parent)
+    ,m_columns(QSqlDatabase::database().record("Image"))
+    ,m_sortColumn(0)
+    ,m_sortOrder(Qt::AscendingOrder)
+    ,m_allIds()
+    ,m_ids()
+    ,m_rows()
+    ,m_isFiltered(false)
+    ,m_filter()
+    ,m_snapshot(0)
+    ,m_records(32 * fetchBlockSize)
+{
+}
+
+int ImageModel::rowCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return m_ids.size();
+}
+
+int ImageModel::columnCount(const QModelIndex& parent) const
+{
+    if (parent.isValid())
+        return 0;
+
+    return m_columns.count();
+}
+
+QVariant ImageModel::data(const QModelIndex& index, int role) const
+{
+    if (!index.isValid())
+        return QVariant();
+
+    if (role != Qt::DisplayRole && role != Qt::EditRole)
+        return QVariant();
+
+    const QSqlRecord* r = record(index.row());
+    if (!r)
+        return QVariant();
+
+    return r->value(index.column());
+}
+
+QVariant ImageModel::headerData(int section, Qt::Orientation orientation,
+                                int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+
+    return m_columns.fieldName(section);
+}
+
+void ImageModel::sort(const int column, const Qt::SortOrder order)
+{
+    m_sortColumn = column;
+    m_sortOrder = order;
+    select();
+}
+
+int ImageModel::sortColumn() const
+{
+    return m_sortColumn;
+}
+
+Qt::SortOrder ImageModel::sortOrder() const
+{
+    return m_sortOrder;
+}
+
+bool ImageModel::select()
+{
+    QSqlQuery query;
+    query.setForwardOnly(true);
+
+    // Image id breaks ties to make the order stable between selects.
+    const QString direction(m_sortOrder == Qt::AscendingOrder
+                            ? "ASC" : "DESC");
+    if (!query.exec(QString("SELECT id FROM Image ORDER BY %1 %2, id %2")
+                    .arg(m_columns.fieldName(m_sortColumn))
+                    .arg(direction))) {
+        qWarning() << "failed to select images:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+
+    QVector<qint64> ids;
+    while (query.next())
+        ids.append(query.value(0).toLongLong());
+    setSortedIds(m_sortColumn, m_sortOrder, ids);
+
+    return true;
+}
+
+void ImageModel::setSortedIds(const int column, const Qt::SortOrder order,
+                              const QVector<qint64>& ids)
+{
+    beginResetModel();
+    m_sortColumn = column;
+    m_sortOrder = order;
+    m_allIds = ids;
+    m_records.clear();
+    applyFilter();
+    endResetModel();
+}
+
+void ImageModel::appendImage(const qint64 id)
+{
+    m_allIds.append(id);
+
+    if (m_isFiltered && !m_filter.contains(quint32(id)))
+        return;
+
+    beginInsertRows(QModelIndex(), m_ids.size(), m_ids.size());
+    if (!m_rows.isEmpty())
+        m_rows.insert(id, m_ids.size());
+    m_ids.append(id);
+    endInsertRows();
+}
+
+void ImageModel::setSnapshot(const CatalogSnapshot* const snapshot)
+{
+    m_snapshot = snapshot;
+    m_records.clear();
+    if (!m_ids.isEmpty())
+        emit dataChanged(index(0, 0),
+                         index(m_ids.size() - 1, m_columns.count() - 1));
+}
+
+void ImageModel::setFilter(const Bitmap& filter)
+{
+    beginResetModel();
+    m_filter = filter;
+    m_isFiltered = true;
+    applyFilter();
+    endResetModel();
+}
+
+void ImageModel::clearFilter()
+{
+    beginResetModel();
+    m_filter.clear();
+    m_isFiltered = false;
+    applyFilter();
+    endResetModel();
+}
+
+bool ImageModel::isFiltered() const
+{
+    return m_isFiltered;
+}
+
+void ImageModel::applyFilter()
+{
+    m_rows.clear();
+
+    if (!m_isFiltered) {
+        m_ids = m_allIds;
+        return;
+    }
+
+    m_ids.clear();
+    m_ids.reserve(m_filter.count());
+    for (int i = 0; i < m_allIds.size(); ++i) {
+        if (m_filter.contains(quint32(m_allIds[i])))
+            m_ids.append(m_allIds[i]);
+    }
+}
+
+qint64 ImageModel::imageId(const int row) const
+{
+    if (row < 0 || row >= m_ids.size())
+        return -1;
+
+    return m_ids[row];
+}
+
+int ImageModel::row(const qint64 id) const
+{
+    if (m_rows.isEmpty()) {
+        m_rows.reserve(m_ids.size());
+        for (int i = 0; i < m_ids.size(); ++i)
+            m_rows.insert(m_ids[i], i);
+    }
+
+    return m_rows.value(id, -1);
+}
+
+Bitmap ImageModel::imageIds(const QItemSelection& selection) const
+{
+    Bitmap ids;
+
+    foreach (QItemSelectionRange range, selection) {
+        const int last = qMin(range.bottom(), m_ids.size() - 1);
+        for (int row = qMax(0, range.top()); row <= last; ++row)
+            ids.add(quint32(m_ids[row]));
+    }
+
+    return ids;
+}
+
+Bitmap ImageModel::imageIds() const
+{
+    Bitmap ids;
+
+    foreach (qint64 id, m_ids) {
+        ids.add(quint32(id));
+    }
+
+    return ids;
+}
+
+QList<qint64> ImageModel::orderedImageIds(
+    const QItemSelection& selection) const
+{
+    if (selection.isEmpty())
+        return m_ids.toList();
+
+    QList<int> rows;
+    foreach (QItemSelectionRange range, selection) {
+        const int last = qMin(range.bottom(), m_ids.size() - 1);
+        for (int row = qMax(0, range.top()); row <= last; ++row)
+            rows.append(row);
+    }
+    qSort(rows);
+
+    QList<qint64> ids;
+    foreach (int row, rows) {
+        ids.append(m_ids[row]);
+    }
+
+    return ids;
+}
+
+int ImageModel::rowForDate(const QDate& date) const
+{
+    const int column = m_columns.indexOf("exif_datetime");
+    const bool ascending = m_sortOrder == Qt::AscendingOrder;
+    int first = 0;
+    int last = m_ids.size();
+
+    // Binary search touching only a logarithmic number of rows, each of
+    // which fetches at most one block.
+    while (first < last) {
+        const int middle = first + (last - first) / 2;
+        const QDate middleDate(
+            data(index(middle, column)).toDateTime().date());
+        if (ascending ? middleDate < date : middleDate > date)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    return first;
+}
+
+const QSqlRecord* ImageModel::record(const int row) const
+{
+    if (row < 0 || row >= m_ids.size())
+        return 0;
+
+    const qint64 id = m_ids[row];
+    if (m_records.contains(id))
+        return m_records.object(id);
+
+    if (m_snapshot) {
+        const int index = m_snapshot->indexOf(id);
+        if (index >= 0) {
+            m_records.insert(id, new QSqlRecord(
+                                 m_snapshot->record(index, m_columns)));
+            return m_records.object(id);
+        }
+    }
+
+    // Every library is asked for its own ids, so that the rows come
+    // through its primary key rather than through the federated view.
+    const int first = qMax(0, row - fetchBlockSize / 2);
+    const int last = qMin(m_ids.size(), first + fetchBlockSize);
+    QMap<int, QStringList> libraryIds;
+    for (int i = first; i < last; ++i) {
+        if (m_records.contains(m_ids[i]))
+            continue;
+        if (m_snapshot && m_snapshot->indexOf(m_ids[i]) >= 0)
+            continue;
+        libraryIds[libraryIndex(m_ids[i])]
+            << QString::number(localImageId(m_ids[i]));
+    }
+
+    QSqlQuery query;
+    query.setForwardOnly(true);
+    QMap<int, QStringList>::const_iterator i = libraryIds.constBegin();
+    for (; i != libraryIds.constEnd(); ++i) {
+        if (!query.exec(QString("SELECT * FROM %1.Image WHERE id IN (%2)")
+                        .arg(librarySchema(i.key()))
+                        .arg(i.value().join(",")))) {
+            qWarning() << "failed to fetch images:"
+                       << query.lastError().databaseText();
+            return 0;
+        }
+        while (query.next()) {
+            QSqlRecord* const record = new QSqlRecord(query.record());
+            const qint64 recordId = globalImageId(
+                i.key(), record->value(0).toLongLong());
+            record->setValue(0, recordId);
+            m_records.insert(recordId, record);
+        }
+    }
+
+    return m_records.object(id);
+}
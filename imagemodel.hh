@@ -0,0 +1,100 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef IMAGEMODEL_HH
+#define IMAGEMODEL_HH
+
+#include <QtSql>
+
+#include "bitmap.hh"
+#include "catalogsnapshot.hh"
+
+// Table model over the Image table. Only the ordered list of image ids is
+// kept in memory, rows are fetched in blocks when a view asks for them.
+// Columns are the columns of the Image table in their declaration order.
+// Rows of images in a current catalog snapshot are read from the
+// snapshot instead of the database.
+class ImageModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    explicit ImageModel(QObject* parent = 0);
+
+    virtual int rowCount(const QModelIndex& parent = QModelIndex()) const;
+    virtual int columnCount(const QModelIndex& parent = QModelIndex()) const;
+    virtual QVariant data(const QModelIndex& index,
+                          int role = Qt::DisplayRole) const;
+    virtual QVariant headerData(int section, Qt::Orientation orientation,
+                                int role = Qt::DisplayRole) const;
+    virtual void sort(int column, Qt::SortOrder order = Qt::AscendingOrder);
+
+    int sortColumn() const;
+    Qt::SortOrder sortOrder() const;
+
+    bool select();
+    // Replaces the rows with images already sorted by the given column,
+    // as looked up by CatalogService.
+    void setSortedIds(int column, Qt::SortOrder order,
+                      const QVector<qint64>& ids);
+    void appendImage(qint64 id);
+    // The snapshot must stay open and current while it is set, or be
+    // unset first.
+    void setSnapshot(const CatalogSnapshot* snapshot);
+
+    void setFilter(const Bitmap& filter);
+    void clearFilter();
+    bool isFiltered() const;
+
+    qint64 imageId(int row) const;
+    int row(qint64 id) const;
+    // Ids of the images in the selected rows, found without creating an
+    // index per row.
+    Bitmap imageIds(const QItemSelection& selection) const;
+    // Ids of the images in all rows.
+    Bitmap imageIds() const;
+    // Ids of the images in the selected rows, or in all rows if nothing is
+    // selected, in row order.
+    QList<qint64> orderedImageIds(const QItemSelection& selection) const;
+
+    // Returns the first row captured on the given date, or the row where
+    // such images would be. Must only be called when the model is sorted
+    // by capture time.
+    int rowForDate(const QDate& date) const;
+
+private:
+    // Views ask for data synchronously, so rows missing from the snapshot
+    // are fetched on the calling thread, a block at a time by primary key.
+    const QSqlRecord* record(int row) const;
+    void applyFilter();
+
+    QSqlRecord m_columns;
+    int m_sortColumn;
+    Qt::SortOrder m_sortOrder;
+
+    QVector<qint64> m_allIds;
+    QVector<qint64> m_ids;
+    // Rows of the ids, built on the first lookup after the rows changed.
+    mutable QHash<qint64, int> m_rows;
+
+    bool m_isFiltered;
+    Bitmap m_filter;
+
+    const CatalogSnapshot* m_snapshot;
+    mutable QCache<qint64, QSqlRecord> m_records;
+};
+
+#endif // IMAGEMODEL_HH
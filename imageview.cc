@@ -15,6 +15,13 @@
 // along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "imageview.hh"
+#include "orientedscale.hh"
+
+static QImage orientedImage(const QImage& image, const int orientation)
+{
+    return orientedScaled(image, orientation,
+                          orientedSize(image.size(), orientation));
+}
 
 ImageView::ImageView(QWidget *parent)
     :QScrollArea(parent)
@@ -55,14 +62,16 @@ void ImageView::loadImage()
         return;
 
     m_imageReader.setFileName(m_imageFilePath);
-    m_imageSize = m_imageReader.size();
+    m_imageSize = orientedSize(m_imageReader.size(), m_imageOrientation);
     m_imageReader.setScaledSize(m_imageReader.size() * 0.2);
-    m_transform = exifTransform(m_imageOrientation);
+    // The orientation is applied to the pixels, the transform only holds
+    // the rotations made in the view.
+    m_transform = QTransform();
 
     QPixmap pixmap;
     if (!QPixmapCache::find(m_imageFilePath, &pixmap)) {
-        pixmap = QPixmap::fromImageReader(&m_imageReader)
-            .transformed(m_transform);
+        pixmap = QPixmap::fromImage(orientedImage(m_imageReader.read(),
+                                                  m_imageOrientation));
         QPixmapCache::insert(m_imageFilePath, pixmap);
     }
     m_imageLabel->setPixmap(pixmap);
@@ -162,9 +171,15 @@ void ImageView::zoomTo(const qreal zoomLevel, const QPoint &focalPoint)
     // image Just-In-Time.
     if (currentSize.width() > pixmapSize.width() ||
         currentSize.height() > pixmapSize.height()) {
-        if (m_imageSize != pixmapSize) {
-            QPixmap pixmap(m_imageReader.fileName());
-            m_imageLabel->setPixmap(pixmap.transformed(m_transform));
+        const QSize imageSize(
+            m_transform.mapRect(QRect(QPoint(), m_imageSize)).size());
+        if (imageSize != pixmapSize) {
+            const QPixmap pixmap(QPixmap::fromImage(
+                                     orientedImage(
+                                         QImage(m_imageReader.fileName()),
+                                         m_imageOrientation))
+                                 .transformed(m_transform));
+            m_imageLabel->setPixmap(pixmap);
             zoomTo(currentSize.width() / qreal(pixmap.size().width()),
                    focalPoint);
         }
@@ -0,0 +1,772 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "common.hh"
+#include "importer.hh"
+#include "orientedscale.hh"
+#include "similarityindex.hh"
+
+static bool thumbnailsAreUpToDate(const QString& filePath,
+                                  const QDateTime& lastModified,
+                                  const QList<int>& levels)
+{
+    foreach (int level, levels) {
+        QFileInfo levelFileInfo(thumbnailFilePath(filePath, level));
+        if (!levelFileInfo.exists()
+            || levelFileInfo.lastModified() < lastModified) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Renders one oriented thumbnail per level, smallest first. The image is
+// scaled down only to the largest level, oriented in the same pass, and
+// every smaller level is scaled from the one above it.
+static QList<QImage> renderThumbnails(const QImage& image,
+                                      const QList<int>& levels,
+                                      const int orientation)
+{
+    QList<QImage> thumbnails;
+    QImage source(image);
+    QRect sourceRect(image.rect());
+    int sourceOrientation = orientation;
+
+    for (int i = levels.size() - 1; i >= 0; --i) {
+        const int level = levels[i];
+
+        QSize size(orientedSize(sourceRect.size(), sourceOrientation));
+        size.scale(level, level, Qt::KeepAspectRatio);
+        size = size.expandedTo(QSize(1, 1));
+
+        QImage thumbnail(level, level, QImage::Format_ARGB32_Premultiplied);
+        if (thumbnail.isNull())
+            return QList<QImage>();
+        thumbnail.fill(0);
+
+        const QRect targetRect(QPoint((level - size.width()) / 2,
+                                      (level - size.height()) / 2), size);
+        drawOrientedScaled(source, sourceRect, sourceOrientation,
+                           &thumbnail, targetRect);
+        thumbnails.prepend(thumbnail);
+
+        source = thumbnail;
+        sourceRect = targetRect;
+        sourceOrientation = 1;
+    }
+
+    return thumbnails;
+}
+
+static bool saveThumbnails(const QString& filePath,
+                           const QList<QImage>& thumbnails,
+                           const QList<int>& levels,
+                           Metadata& metadata)
+{
+    for (int i = 0; i < thumbnails.size(); ++i) {
+        const QString levelFilePath(thumbnailFilePath(filePath, levels[i]));
+        if (!thumbnails[i].save(levelFilePath)) {
+            qWarning() << "failed to save the thumbnail image to "
+                       << levelFilePath;
+            return false;
+        }
+    }
+
+    // Hash the smallest thumbnail as it was saved, so that the hash can be
+    // recomputed later from the cached file alone.
+    metadata.insert("perceptualHash",
+                    qint64(perceptualHash(thumbnails.first())));
+    return true;
+}
+
+static void insertThumbnailInfo(const QString& filePath,
+                                const QList<int>& levels,
+                                Metadata& metadata)
+{
+    metadata.insert("thumbnailFilePath",
+                    QFileInfo(thumbnailFilePath(filePath, levels.first()))
+                    .absoluteFilePath());
+    metadata.insert("thumbnailImageSize",
+                    QSize(levels.first(), levels.first()));
+}
+
+static void hashThumbnail(const QString& filePath, const QList<int>& levels,
+                          Metadata& metadata)
+{
+    QImage thumbnail(thumbnailFilePath(filePath, levels.first()));
+    if (!thumbnail.isNull())
+        metadata.insert("perceptualHash", qint64(perceptualHash(thumbnail)));
+}
+
+// Estimates the number of pixels decoding the image allocates from the
+// dimensions Exiv2 already read, or from the image header if Exiv2 did not
+// know them.
+static qint64 decodedPixels(const Metadata& metadata, QImageReader& reader)
+{
+    QSize size(metadata["imageSize"].toSize());
+
+    if (size.isEmpty())
+        size = reader.size();
+
+    if (size.isEmpty())
+        return 0;
+
+    return qint64(size.width()) * size.height();
+}
+
+bool makeThumbnails(Metadata& metadata)
+{
+    const QString filePath(metadata.value("filePath").toString());
+    const QList<int> levels(thumbnailLevels());
+
+    if (!makeCacheDir(filePath))
+        return false;
+
+    insertThumbnailInfo(filePath, levels, metadata);
+    if (thumbnailsAreUpToDate(filePath, QFileInfo(filePath).lastModified(),
+                              levels)) {
+        hashThumbnail(filePath, levels, metadata);
+        return true;
+    }
+
+    QImage image(filePath);
+    if (!image.format()) {
+        qWarning() << filePath << " has unknown image format";
+        return false;
+    }
+
+    const int orientation = metadata.value("orientation").toInt();
+    const QList<QImage> thumbnails(renderThumbnails(image, levels,
+                                                    orientation));
+    if (thumbnails.isEmpty()) {
+        qWarning() << "failed to create a thumbnail image from " << filePath;
+        return false;
+    }
+
+    return saveThumbnails(filePath, thumbnails, levels, metadata);
+}
+
+static const char* const connectionName = "Importer";
+// Files whose metadata the probe pass keeps for the full pass.
+static const int parsedMetadataLimit = 4096;
+
+ImportJob::ImportJob()
+    :filePath()
+    ,walkIndex(0)
+    ,fileStatus()
+    ,catalogId(-1)
+    ,catalogTimestamp()
+    ,isValid(true)
+    ,isUpToDate(false)
+    ,data()
+    ,readCharge(0)
+    ,metadata()
+    ,thumbnails()
+{
+}
+
+Importer::Importer(QObject* parent)
+    :QObject(parent)
+    ,m_paths()
+    ,m_isRecursive(false)
+    ,m_thumbnailLevels()
+    ,m_databaseName()
+    ,m_ioOrder(ioOrderFromString(
+                   QSettings().value("import/ioOrder").toString()))
+    ,m_ioOrderWindow(4096)
+    ,m_readMode(readModeFromString(
+                    QSettings().value("import/readMode").toString()))
+    ,m_fileReader(0)
+    ,m_regenerateThumbnails(false)
+    ,m_probeSize(0)
+    ,m_isProbing(false)
+    ,m_probeMutex()
+    ,m_parsedMetadata()
+    ,m_probeFailures()
+    ,m_walkIndex(0)
+    ,m_runningMutex()
+    ,m_runningChanged()
+    ,m_isRunning(false)
+    ,m_results(1)
+    ,m_fileCount(0)
+    ,m_isWalkFinished(0)
+    ,m_isCanceled(0)
+    ,m_bytesReadMutex()
+    ,m_bytesRead(0)
+{
+}
+
+Importer::~Importer()
+{
+    cancel();
+    waitForFinished();
+    delete m_fileReader;
+}
+
+void Importer::setIoOrder(const IoOrder order)
+{
+    m_ioOrder = order;
+}
+
+void Importer::setReadMode(const ReadMode mode)
+{
+    m_readMode = mode;
+}
+
+ReadMode Importer::readMode() const
+{
+    return m_fileReader ? AsyncReadMode : ThreadedReadMode;
+}
+
+void Importer::setCatalog(const QString& databaseName)
+{
+    m_databaseName = databaseName;
+}
+
+// Regenerated thumbnails replace cached ones even if they are up to date.
+void Importer::setRegenerateThumbnails(const bool regenerate)
+{
+    m_regenerateThumbnails = regenerate;
+}
+
+void Importer::start(const QStringList& paths, const bool recursive)
+{
+    QSettings settings;
+    const PipelineSettings pipelineSettings;
+    const int readBatchSize = qMax(
+        1, settings.value("import/readBatchSize", 32).toInt());
+    const qint64 kibibyte = 1024;
+
+    m_paths = paths;
+    m_isRecursive = recursive;
+    m_thumbnailLevels = thumbnailLevels();
+    m_ioOrderWindow = qMax(1, settings.value("import/ioOrderWindow",
+                                             4096).toInt());
+    m_probeSize = kibibyte * qMax(
+        0, settings.value("import/probeSize", 128).toInt());
+    m_isProbing = m_probeSize > 0;
+    m_parsedMetadata.clear();
+    m_probeFailures.clear();
+    m_fileCount = 0;
+    m_isWalkFinished = 0;
+    m_isCanceled = 0;
+    m_bytesRead = 0;
+
+    delete m_fileReader;
+    m_fileReader = 0;
+    if (m_readMode == AsyncReadMode) {
+        m_fileReader = new FileReader(readBatchSize);
+        if (!m_fileReader->isAsynchronous()) {
+            delete m_fileReader;
+            m_fileReader = 0;
+        }
+    }
+
+    configure(pipelineSettings);
+    m_results.reset();
+    m_results.setCapacity(4 * pipelineSettings.queueDepth);
+    if (m_fileReader) {
+        // The reader is filled from the read queue, which has to hold as
+        // many files.
+        m_readQueue.setCapacity(qMax(pipelineSettings.queueDepth,
+                                     readBatchSize));
+        setThreadCount(ReadStage, 1);
+    }
+
+    m_runningMutex.lock();
+    m_isRunning = true;
+    m_runningMutex.unlock();
+    startPass();
+}
+
+void Importer::cancel()
+{
+    m_isCanceled = 1;
+    abortPass();
+    m_results.abort();
+}
+
+bool Importer::isCanceled() const
+{
+    return m_isCanceled;
+}
+
+// The last write worker of the probe pass starts the full pass, the import
+// is running until a pass finishes without starting another one.
+void Importer::waitForFinished()
+{
+    m_runningMutex.lock();
+    while (m_isRunning)
+        m_runningChanged.wait(&m_runningMutex);
+    m_runningMutex.unlock();
+
+    waitForPass();
+}
+
+bool Importer::takeResult(Metadata& metadata)
+{
+    return m_results.tryPop(metadata);
+}
+
+qint64 Importer::bytesRead() const
+{
+    QMutexLocker locker(&m_bytesReadMutex);
+    return m_bytesRead;
+}
+
+int Importer::fileCount() const
+{
+    return m_fileCount;
+}
+
+bool Importer::isWalkFinished() const
+{
+    return m_isWalkFinished;
+}
+
+QString Importer::queueStatus() const
+{
+    return QString("Queued for reading: %1/%2, decoding: %3/%4, "
+                   "writing: %5/%6")
+        .arg(m_readQueue.size()).arg(m_readQueue.capacity())
+        .arg(m_decodeQueue.size()).arg(m_decodeQueue.capacity())
+        .arg(m_writeQueue.size()).arg(m_writeQueue.capacity())
+        + QString(", decoded megapixels: %1/%2")
+        .arg(m_pixelBudget.used() / 1000000)
+        .arg(m_pixelBudget.capacity() / 1000000);
+}
+
+// Files the probe pass could not parse are reported by it, and skipped by
+// the full pass.
+bool Importer::complete(Job& job)
+{
+    if (m_isProbing && !job.isValid) {
+        m_probeMutex.lock();
+        m_probeFailures.add(job.walkIndex);
+        m_probeMutex.unlock();
+    }
+    if (job.isValid && job.catalogId >= 0) {
+        job.metadata.insert("id", job.catalogId);
+        job.metadata.insert("catalogTimestamp", job.catalogTimestamp);
+    }
+    if (!m_results.push(job.isValid ? job.metadata : Metadata()))
+        return false;
+    emit resultsAvailable();
+    return true;
+}
+
+// Files are looked up in the catalog through a connection of the feed
+// thread. Without a catalog there is nothing to look up, and no query is
+// made, as that would use the default connection of the GUI thread.
+void Importer::feed()
+{
+    m_walkIndex = 0;
+    if (m_databaseName.isEmpty()) {
+        feed(0);
+        return;
+    }
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE",
+                                                    connectionName);
+        db.setDatabaseName(m_databaseName);
+        if (!db.open()) {
+            qWarning() << "failed to open the catalog for import:"
+                       << db.lastError().databaseText();
+        }
+        QSqlQuery query(db);
+        query.setForwardOnly(true);
+        query.prepare("SELECT id, exif_datetime, metadata_version"
+                      " FROM Image WHERE file_path = ?");
+        feed(&query);
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+}
+
+void Importer::feed(QSqlQuery* const query)
+{
+    // Paths are sorted by disk locality a window at a time, in path order
+    // they are passed on as soon as they are found.
+    const int windowSize = m_ioOrder == PathIoOrder ? 1 : m_ioOrderWindow;
+    QStringList window;
+
+    foreach (QString path, m_paths) {
+        if (!QFileInfo(path).isDir()) {
+            window.append(QFileInfo(path).canonicalFilePath());
+            if (window.size() >= windowSize && !feed(window, query))
+                return;
+            continue;
+        }
+
+        QDirIterator it(path, QDir::Files | QDir::Hidden | QDir::System,
+                        m_isRecursive ? QDirIterator::Subdirectories
+                        : QDirIterator::NoIteratorFlags);
+        while (it.hasNext()) {
+            window.append(QFileInfo(it.next()).canonicalFilePath());
+            if (window.size() >= windowSize && !feed(window, query))
+                return;
+        }
+    }
+
+    if (feed(window, query) && !m_isProbing)
+        m_isWalkFinished = 1;
+}
+
+// Every file is stat'ed here once, the later stages use the status the
+// job carries.
+bool Importer::feed(QStringList& window, QSqlQuery* const query)
+{
+    QStringList filePaths;
+    QList<FileStatus> statuses;
+    QHash<QString, quint32> walkIndices;
+    Job job;
+
+    foreach (QString filePath, window) {
+        const quint32 walkIndex = m_walkIndex++;
+        if (!m_isProbing && m_probeFailures.contains(walkIndex))
+            continue;
+        FileStatus status;
+        // Dangling symbolic links do not have a canonical path.
+        if (filePath.isEmpty() || !statFile(filePath, &status))
+            continue;
+        filePaths.append(filePath);
+        statuses.append(status);
+        walkIndices.insert(filePath, walkIndex);
+    }
+    window.clear();
+
+    sortByDiskLocality(filePaths, statuses, m_ioOrder);
+
+    for (int i = 0; i < filePaths.size(); ++i) {
+        if (m_isCanceled)
+            return false;
+
+        job.filePath = filePaths[i];
+        job.walkIndex = walkIndices.value(job.filePath);
+        job.fileStatus = statuses[i];
+        if (!lookUp(job, query))
+            continue;
+        m_fileCount.ref();
+        if (!m_readQueue.push(job))
+            return false;
+        // The read queue is the batch of files read next, by the time
+        // a reader gets to this one it is hopefully in the page cache.
+        // Probes read only the first bytes of the file, and asynchronous
+        // reads are in flight already.
+        if (m_ioOrder != PathIoOrder && !m_isProbing && !m_fileReader)
+            adviseWillNeed(job.filePath);
+    }
+
+    return true;
+}
+
+// Probes skip catalogued files, the grid shows them already. The full pass
+// skips files catalogued by the current metadata version whose thumbnails
+// are up to date. Returns false if the file is skipped.
+bool Importer::lookUp(Job& job, QSqlQuery* const query) const
+{
+    job.catalogId = -1;
+    job.catalogTimestamp = QDateTime();
+    if (!query)
+        return true;
+
+    query->addBindValue(job.filePath);
+    if (!query->exec()) {
+        qWarning() << "failed to look up " << job.filePath << ":"
+                   << query->lastError().databaseText();
+        return true;
+    }
+    if (!query->next())
+        return true;
+
+    job.catalogId = query->value(0).toLongLong();
+    job.catalogTimestamp = query->value(1).toDateTime();
+    const int version = query->value(2).toInt();
+    query->finish();
+
+    if (m_isProbing)
+        return false;
+
+    return version < metadataVersion || m_regenerateThumbnails
+        || !thumbnailsAreUpToDate(job.filePath, job.fileStatus.lastModified,
+                                  m_thumbnailLevels);
+}
+
+// The paths are walked once more after the probe pass. Results are not
+// reset, the ones of the probe pass may not have been taken yet.
+void Importer::passFinished()
+{
+    if (m_isProbing && !m_isCanceled) {
+        m_isProbing = false;
+        startPass();
+        return;
+    }
+    m_paths.clear();
+    m_parsedMetadata.clear();
+    m_probeFailures.clear();
+
+    m_runningMutex.lock();
+    m_isRunning = false;
+    m_runningChanged.wakeAll();
+    m_runningMutex.unlock();
+    emit finished();
+}
+
+// Returns true if the file has to be read, files with up to date
+// thumbnails only need their metadata. Probes always read the prefix.
+bool Importer::prepareRead(Job& job) const
+{
+    if (m_isProbing)
+        return true;
+
+    if (!makeCacheDir(job.filePath)) {
+        job.isValid = false;
+        return false;
+    }
+
+    job.isUpToDate = !m_regenerateThumbnails
+        && thumbnailsAreUpToDate(job.filePath,
+                                 job.fileStatus.lastModified,
+                                 m_thumbnailLevels);
+    return !job.isUpToDate;
+}
+
+FileReader::Request Importer::readRequest(const Job& job) const
+{
+    FileReader::Request request;
+
+    request.filePath = job.filePath;
+    request.size = m_isProbing ? qMin(m_probeSize, job.fileStatus.size)
+        : job.fileStatus.size;
+    return request;
+}
+
+void Importer::finishRead(Job& job, const FileReader::Request& request)
+{
+    job.data = request.data;
+    job.isValid = request.isRead;
+
+    QMutexLocker locker(&m_bytesReadMutex);
+    m_bytesRead += request.data.size();
+}
+
+// Charges the bytes of the request to the read budget. Returns false if
+// they do not fit without waiting, or if the import was canceled meanwhile,
+// the job is then invalid.
+bool Importer::acquireRead(Job& job, const FileReader::Request& request,
+                           const bool isBlocking)
+{
+    const bool isAcquired = isBlocking
+        ? m_readBudget.acquire(request.size)
+        : m_readBudget.tryAcquire(request.size);
+
+    if (isAcquired)
+        job.readCharge = request.size;
+    else if (isBlocking)
+        job.isValid = false;
+    return isAcquired;
+}
+
+void Importer::read(Job& job)
+{
+    if (!prepareRead(job))
+        return;
+
+    FileReader::Request request(readRequest(job));
+    if (!acquireRead(job, request, true))
+        return;
+    FileReader::readSynchronously(request);
+    finishRead(job, request);
+}
+
+// In the asynchronous read mode the reader is kept full from the read
+// queue, which is waited on only while no read is in flight, and every
+// file is handed on as soon as its read completes. The read budget is
+// likewise waited on only while no read is in flight, as the reads in
+// flight hold part of it; a job which does not fit is held back until
+// reads complete.
+void Importer::readJobs()
+{
+    if (!m_fileReader) {
+        Pipeline<ImportJob>::readJobs();
+        return;
+    }
+
+    // Jobs being read, by the tags of their requests.
+    QHash<int, Job> jobs;
+    int nextTag = 0;
+    bool isQueueOpen = true;
+    bool isAborted = false;
+    bool isHeldBack = false;
+    Job job;
+
+    while (!isAborted && (isQueueOpen || isHeldBack || !jobs.isEmpty())) {
+        while ((isQueueOpen || isHeldBack) && !m_fileReader->isFull()) {
+            if (!isHeldBack) {
+                if (jobs.isEmpty()) {
+                    if (!m_readQueue.pop(job)) {
+                        isQueueOpen = false;
+                        break;
+                    }
+                } else if (!m_readQueue.tryPop(job)) {
+                    break;
+                }
+
+                if (!prepareRead(job)) {
+                    isAborted = !m_decodeQueue.push(job);
+                    if (isAborted)
+                        break;
+                    continue;
+                }
+            }
+
+            FileReader::Request request(readRequest(job));
+            isHeldBack = !acquireRead(job, request, jobs.isEmpty());
+            if (isHeldBack) {
+                isAborted = !job.isValid;
+                isHeldBack = !isAborted;
+                break;
+            }
+            request.tag = nextTag;
+            jobs.insert(nextTag++, job);
+            m_fileReader->submit(request);
+        }
+
+        FileReader::Request request;
+        if (isAborted || !m_fileReader->takeCompleted(request))
+            continue;
+        job = jobs.take(request.tag);
+        finishRead(job, request);
+        isAborted = !m_decodeQueue.push(job);
+    }
+
+    // Reads still in flight after a cancel are canceled too.
+    m_fileReader->cancel();
+}
+
+void Importer::decode(Job& job)
+{
+    if (!job.isValid)
+        return;
+
+    if (m_isProbing) {
+        probe(job);
+        return;
+    }
+
+    // Files with up to date thumbnails are not read by the read stage,
+    // their metadata is parsed from the file. Files the probe pass parsed
+    // whole are not parsed again.
+    m_probeMutex.lock();
+    job.metadata = m_parsedMetadata.take(job.filePath);
+    m_probeMutex.unlock();
+    if (job.metadata.isEmpty())
+        job.metadata = getMetadata(job.filePath, job.fileStatus, job.data);
+    if (job.metadata.isEmpty()) {
+        qCritical() << "failed to parse metadata";
+        job.isValid = false;
+        return;
+    }
+
+    if (job.isUpToDate)
+        return;
+
+    // The same buffer Exiv2 parsed is decoded, the header the size
+    // estimate needs is read only once.
+    QBuffer buffer(&job.data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+
+    // The reservation is held until the full-resolution image is freed.
+    const qint64 pixels = decodedPixels(job.metadata, reader);
+    PixelReservation reservation(&m_pixelBudget, pixels);
+    if (!reservation.isAcquired()) {
+        job.isValid = false;
+        return;
+    }
+
+    QImage image;
+    const bool isLoaded = reader.read(&image);
+    buffer.close();
+    job.data.clear();
+    if (!isLoaded) {
+        qWarning() << job.filePath << " has unknown image format";
+        job.isValid = false;
+        return;
+    }
+
+    job.thumbnails = renderThumbnails(
+        image, m_thumbnailLevels, job.metadata.value("orientation").toInt());
+    if (job.thumbnails.isEmpty()) {
+        qWarning() << "failed to create a thumbnail image from "
+                   << job.filePath;
+        job.isValid = false;
+    }
+}
+
+// The prefix is parsed on its own if it is shorter than the file; when it
+// misses some of the fields the grid needs, the whole file is parsed.
+void Importer::probe(Job& job)
+{
+    const bool isPrefix = job.data.size() < job.fileStatus.size;
+
+    job.metadata = isPrefix
+        ? probeMetadata(job.filePath, job.fileStatus, job.data)
+        : getMetadata(job.filePath, job.fileStatus, job.data);
+    job.data.clear();
+    if (!job.metadata.isEmpty() && isPrefix) {
+        job.metadata.insert("isProbed", true);
+        return;
+    }
+
+    // The whole file has been parsed, the full pass only makes the
+    // thumbnails.
+    if (job.metadata.isEmpty())
+        job.metadata = getMetadata(job.filePath, job.fileStatus);
+    if (job.metadata.isEmpty()) {
+        job.isValid = false;
+        return;
+    }
+
+    // Files beyond the limit are parsed again by the full pass, so that
+    // memory use does not grow with the number of files.
+    m_probeMutex.lock();
+    if (m_parsedMetadata.size() < parsedMetadataLimit)
+        m_parsedMetadata.insert(job.filePath, job.metadata);
+    m_probeMutex.unlock();
+}
+
+void Importer::write(Job& job)
+{
+    if (!job.isValid)
+        return;
+
+    insertThumbnailInfo(job.filePath, m_thumbnailLevels, job.metadata);
+    if (m_isProbing)
+        return;
+
+    if (job.isUpToDate) {
+        hashThumbnail(job.filePath, m_thumbnailLevels, job.metadata);
+        return;
+    }
+
+    if (!saveThumbnails(job.filePath, job.thumbnails, m_thumbnailLevels,
+                        job.metadata)) {
+        qWarning() << "failed to make a thumbnail";
+        job.isValid = false;
+    }
+    job.thumbnails.clear();
+}
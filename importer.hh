@@ -0,0 +1,187 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef IMPORTER_HH
+#define IMPORTER_HH
+
+#include <QtGui>
+#include <QtSql>
+
+#include "bitmap.hh"
+#include "filereader.hh"
+#include "iolocality.hh"
+#include "metadata.hh"
+#include "pipeline.hh"
+
+// Brings the thumbnails of the image described by the metadata up to date
+// with the configured thumbnail levels. The metadata must contain the file
+// path and the orientation, the thumbnail details are added to it.
+bool makeThumbnails(Metadata& metadata);
+
+// A file on its way through the import pipeline.
+struct ImportJob
+{
+    ImportJob();
+
+    QString filePath;
+    // Position of the path in the walk, the same in both passes as long as
+    // the tree does not change meanwhile.
+    quint32 walkIndex;
+    // Stat'ed once by the feed stage.
+    FileStatus fileStatus;
+    // Id and capture time of the file in the catalog, the id is -1 if the
+    // file is not catalogued.
+    qint64 catalogId;
+    QDateTime catalogTimestamp;
+    bool isValid;
+    bool isUpToDate;
+    QByteArray data;
+    // Bytes of the read budget held for the data, see Pipeline.
+    qint64 readCharge;
+    Metadata metadata;
+    QList<QImage> thumbnails;
+};
+
+// Import pipeline, see Pipeline. The read stage reads the files, several
+// requests in flight to keep disks and network mounts busy, the decode
+// stage parses the metadata and decodes and scales the images, and the
+// write stage encodes and saves the thumbnails.
+//
+// Directories are walked lazily by the feed stage and results are handed
+// out one at a time, so memory use does not grow with the number of files.
+//
+// Files can be read in on-disk order instead of the given order. Pending
+// files are then sorted in windows of import/ioOrderWindow files and the
+// kernel is asked to read ahead every file queued for reading.
+//
+// In the asynchronous read mode a single read thread keeps up to
+// import/readBatchSize reads in flight through io_uring, so that fast
+// devices get a deep queue of requests, and hands each file on as soon as
+// it has been read. Without io_uring the read threads are used.
+//
+// Unless import/probeSize is 0, files are first probed: the first
+// import/probeSize KiB of every file not yet catalogued are read for the
+// metadata the catalog needs, and the results, marked isProbed, are handed
+// out before any thumbnail is made. Files whose prefix misses the
+// dimensions or the timestamp are parsed whole, and their results are
+// complete. The paths are then walked again in a full pass which makes the
+// thumbnails and parses the complete metadata of the probed files. Files
+// the probe pass failed to parse are reported by it and skipped by the
+// full pass.
+//
+// With a catalog set, results of catalogued files carry their id and
+// catalogTimestamp, their capture time in the catalog. Files catalogued by
+// the current metadata version with up to date thumbnails are skipped.
+//
+// Decodes are admitted against a budget of import/pixelBudget megapixels,
+// estimated from the image header before decoding. Images of at least
+// import/largeImageMegapixels are decoded one at a time. The file data
+// read but not yet decoded, queued or in flight, is bounded by
+// import/readBudget MiB.
+class Importer : public QObject, private Pipeline<ImportJob>
+{
+    Q_OBJECT
+
+public:
+    explicit Importer(QObject* parent = 0);
+    ~Importer();
+
+    void setIoOrder(IoOrder order);
+    void setReadMode(ReadMode mode);
+    // The mode files are read in, once started, asynchronous only if
+    // io_uring could be set up.
+    ReadMode readMode() const;
+    void setRegenerateThumbnails(bool regenerate);
+    // Files are looked up in the catalog of the given database, none is
+    // looked up if the name is empty.
+    void setCatalog(const QString& databaseName);
+
+    // Imports the given files and the files in the given directories,
+    // descending into subdirectories if recursive is set.
+    void start(const QStringList& paths, bool recursive = false);
+    void cancel();
+    bool isCanceled() const;
+    void waitForFinished();
+
+    // Takes the metadata of the next imported file. The metadata is empty
+    // if the file could not be imported.
+    bool takeResult(Metadata& metadata);
+
+    // Number of results the files found so far make, final once the import
+    // has finished. Probed files are counted once for each pass.
+    int fileCount() const;
+    // True once the last pass has found every file, the file count does
+    // not grow any more.
+    bool isWalkFinished() const;
+    // Bytes the read stage has read from the imported files.
+    qint64 bytesRead() const;
+    QString queueStatus() const;
+
+signals:
+    void resultsAvailable();
+    void finished();
+
+private:
+    typedef ImportJob Job;
+
+    virtual void feed();
+    void feed(QSqlQuery* query);
+    bool feed(QStringList& window, QSqlQuery* query);
+    bool lookUp(Job& job, QSqlQuery* query) const;
+    bool prepareRead(Job& job) const;
+    FileReader::Request readRequest(const Job& job) const;
+    bool acquireRead(Job& job, const FileReader::Request& request,
+                     bool isBlocking);
+    void finishRead(Job& job, const FileReader::Request& request);
+    virtual void read(Job& job);
+    virtual void readJobs();
+    virtual void decode(Job& job);
+    virtual void write(Job& job);
+    virtual bool complete(Job& job);
+    virtual void passFinished();
+    void probe(Job& job);
+
+    QStringList m_paths;
+    bool m_isRecursive;
+    QList<int> m_thumbnailLevels;
+    QString m_databaseName;
+    IoOrder m_ioOrder;
+    int m_ioOrderWindow;
+    ReadMode m_readMode;
+    FileReader* m_fileReader;
+    bool m_regenerateThumbnails;
+    qint64 m_probeSize;
+    bool m_isProbing;
+    // Metadata of the files the probe pass parsed whole, by path, up to
+    // parsedMetadataLimit files, and the walk indices of the files it
+    // failed to parse.
+    QMutex m_probeMutex;
+    QHash<QString, Metadata> m_parsedMetadata;
+    Bitmap m_probeFailures;
+    quint32 m_walkIndex;
+    QMutex m_runningMutex;
+    QWaitCondition m_runningChanged;
+    bool m_isRunning;
+
+    BoundedQueue<Metadata> m_results;
+    QAtomicInt m_fileCount;
+    QAtomicInt m_isWalkFinished;
+    QAtomicInt m_isCanceled;
+    mutable QMutex m_bytesReadMutex;
+    qint64 m_bytesRead;
+};
+
+#endif // IMPORTER_HH
@@ -0,0 +1,150 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <string.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "iolocality.hh"
+
+IoOrder ioOrderFromString(const QString& string, bool* ok)
+{
+    if (ok)
+        *ok = true;
+
+    if (string == "inode")
+        return InodeIoOrder;
+    if (string == "extent")
+        return ExtentIoOrder;
+    if (ok && string != "path")
+        *ok = false;
+    return PathIoOrder;
+}
+
+QString ioOrderToString(const IoOrder order)
+{
+    switch (order) {
+    case InodeIoOrder:
+        return "inode";
+    case ExtentIoOrder:
+        return "extent";
+    default:
+        return "path";
+    }
+}
+
+struct LocalityKey
+{
+    quint64 device;
+    quint64 position;
+    int index;
+
+    bool operator<(const LocalityKey& other) const
+    {
+        if (device != other.device)
+            return device < other.device;
+        if (position != other.position)
+            return position < other.position;
+        return index < other.index;
+    }
+};
+
+static bool firstExtent(const int fd, quint64* physical)
+{
+    struct {
+        struct fiemap map;
+        struct fiemap_extent extent;
+    } request;
+
+    memset(&request, 0, sizeof(request));
+    request.map.fm_start = 0;
+    request.map.fm_length = FIEMAP_MAX_OFFSET;
+    request.map.fm_extent_count = 1;
+
+    if (ioctl(fd, FS_IOC_FIEMAP, &request.map) != 0)
+        return false;
+    if (request.map.fm_mapped_extents == 0)
+        return false;
+
+    *physical = request.extent.fe_physical;
+    return true;
+}
+
+static LocalityKey localityKey(const QString& filePath,
+                               const FileStatus& status,
+                               const IoOrder order, const int index)
+{
+    LocalityKey key;
+    key.device = status.device;
+    key.position = status.inode;
+    key.index = index;
+
+    if (order != ExtentIoOrder)
+        return key;
+
+    const QByteArray path(QFile::encodeName(filePath));
+    const int fd = open(path.constData(), O_RDONLY);
+    if (fd < 0)
+        return key;
+
+    quint64 physical;
+    if (firstExtent(fd, &physical))
+        key.position = physical;
+
+    close(fd);
+    return key;
+}
+
+void sortByDiskLocality(QStringList& filePaths, QList<FileStatus>& statuses,
+                        const IoOrder order)
+{
+    if (order == PathIoOrder)
+        return;
+
+    QVector<LocalityKey> keys;
+    keys.reserve(filePaths.size());
+    for (int i = 0; i < filePaths.size(); ++i)
+        keys.append(localityKey(filePaths[i], statuses[i], order, i));
+
+    std::sort(keys.begin(), keys.end());
+
+    QStringList sortedFilePaths;
+    QList<FileStatus> sortedStatuses;
+    sortedFilePaths.reserve(filePaths.size());
+    sortedStatuses.reserve(statuses.size());
+    for (int i = 0; i < keys.size(); ++i) {
+        sortedFilePaths.append(filePaths[keys[i].index]);
+        sortedStatuses.append(statuses[keys[i].index]);
+    }
+    filePaths = sortedFilePaths;
+    statuses = sortedStatuses;
+}
+
+void adviseWillNeed(const QString& filePath)
+{
+    const QByteArray path(QFile::encodeName(filePath));
+    const int fd = open(path.constData(), O_RDONLY);
+    if (fd < 0)
+        return;
+
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+    close(fd);
+}
@@ -0,0 +1,50 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef IOLOCALITY_HH
+#define IOLOCALITY_HH
+
+#include <QtCore>
+
+#include "filestatus.hh"
+
+// Orders in which the import reads files. Reading files in the order they
+// lie on disk turns the random seeks of a rotational disk into mostly
+// forward sweeps.
+enum IoOrder {
+    // Paths are read in the order they were given.
+    PathIoOrder,
+    // Paths are sorted by inode number, which on most file systems
+    // follows the on-disk placement closely enough.
+    InodeIoOrder,
+    // Paths are sorted by the physical offset of their first extent as
+    // reported by FIEMAP, falling back to the inode number on file
+    // systems without FIEMAP.
+    ExtentIoOrder
+};
+
+IoOrder ioOrderFromString(const QString& string, bool* ok = 0);
+QString ioOrderToString(IoOrder order);
+
+// Sorts the files, and their statuses along, by their place on disk. Inode
+// order is found from the statuses alone, extent order opens every file.
+void sortByDiskLocality(QStringList& filePaths, QList<FileStatus>& statuses,
+                        IoOrder order);
+
+// Asks the kernel to start reading the file into the page cache.
+void adviseWillNeed(const QString& filePath);
+
+#endif // IOLOCALITY_HH
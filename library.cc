@@ -0,0 +1,190 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "library.hh"
+
+static QStringList libraryFilePaths;
+
+// Tables whose rows are federated. The Generation of a federated catalog
+// is the sum of the generations of its libraries, which grows whenever
+// any of them changes.
+static const char* const federatedTables[] = {
+    "Image", "Tagging", "Timeline", "ImageLocation"
+};
+
+QString libraryFilePath(const QString& rootPath)
+{
+    return QDir(rootPath).filePath(".sqim/db.sqlite3");
+}
+
+void setLibraries(const QStringList& filePaths)
+{
+    libraryFilePaths = filePaths;
+}
+
+QStringList libraries()
+{
+    return libraryFilePaths;
+}
+
+bool isFederated()
+{
+    return libraryFilePaths.size() > 1;
+}
+
+QString librarySchema(const int index)
+{
+    if (index == 0)
+        return "main";
+
+    return QString("library%1").arg(index);
+}
+
+int libraryIndex(const qint64 imageId)
+{
+    return int(imageId >> libraryIdBits);
+}
+
+qint64 localImageId(const qint64 imageId)
+{
+    return imageId & ((Q_INT64_C(1) << libraryIdBits) - 1);
+}
+
+qint64 globalImageId(const int index, const qint64 localId)
+{
+    return (qint64(index) << libraryIdBits) | localId;
+}
+
+QList<LibraryIdRange> libraryIdRanges(const qint64 firstId,
+                                      const qint64 lastId)
+{
+    QList<LibraryIdRange> ranges;
+    const qint64 maxLocalId = (Q_INT64_C(1) << libraryIdBits) - 1;
+    const int lastLibrary = qMin(libraryIndex(lastId),
+                                 qMax(1, libraryFilePaths.size()) - 1);
+
+    for (int i = libraryIndex(firstId); i <= lastLibrary; ++i) {
+        LibraryIdRange range;
+        range.library = i;
+        range.first = i == libraryIndex(firstId) ? localImageId(firstId) : 0;
+        range.last = i == libraryIndex(lastId)
+            ? localImageId(lastId) : maxLocalId;
+        ranges.append(range);
+    }
+
+    return ranges;
+}
+
+QString libraryTable(const int index, const QString& table)
+{
+    return QString("%1.%2").arg(librarySchema(index)).arg(table);
+}
+
+static bool execStatement(QSqlQuery& query, const QString& statement,
+                          const QString& description)
+{
+    if (!query.exec(statement)) {
+        qWarning() << "failed to" << description << ":"
+                   << query.lastError().databaseText();
+        return false;
+    }
+
+    return true;
+}
+
+// Columns of the table of the index:th library, ids mapped to global ids.
+static QString federatedColumns(const QSqlRecord& record, const int index)
+{
+    QStringList columns;
+
+    for (int i = 0; i < record.count(); ++i) {
+        const QString name(record.fieldName(i));
+        if (name == "id" && index > 0)
+            columns << QString("(%1 << %2) | id AS id")
+                .arg(index).arg(libraryIdBits);
+        else
+            columns << name;
+    }
+
+    return columns.join(", ");
+}
+
+bool attachLibraries(QSqlDatabase db)
+{
+    if (!isFederated())
+        return true;
+
+    if (libraryFilePaths.size() > maxLibraryCount) {
+        qWarning() << "at most" << maxLibraryCount
+                   << "libraries can be federated";
+        return false;
+    }
+
+    // The ids of every library, the first one included, must fit in the
+    // low bits.
+    QSqlQuery query(db);
+    for (int i = 0; i < libraryFilePaths.size(); ++i) {
+        if (i > 0) {
+            query.prepare(QString("ATTACH DATABASE ? AS %1")
+                          .arg(librarySchema(i)));
+            query.addBindValue(libraryFilePaths[i]);
+            if (!query.exec()) {
+                qWarning() << "failed to attach library"
+                           << libraryFilePaths[i] << ":"
+                           << query.lastError().databaseText();
+                return false;
+            }
+        }
+
+        if (!execStatement(query, QString("SELECT MAX(id) FROM %1.Image")
+                           .arg(librarySchema(i)), "read image ids"))
+            return false;
+        if (query.next()
+            && query.value(0).toLongLong() >= Q_INT64_C(1) << libraryIdBits) {
+            qWarning() << "library" << libraryFilePaths[i]
+                       << "has too many images to be federated";
+            return false;
+        }
+        query.finish();
+    }
+
+    const int tableCount = sizeof(federatedTables) / sizeof(*federatedTables);
+    for (int t = 0; t < tableCount; ++t) {
+        const QString table(federatedTables[t]);
+        const QSqlRecord record(db.record(table));
+        QStringList selects;
+        for (int i = 0; i < libraryFilePaths.size(); ++i) {
+            selects << QString("SELECT %1 FROM %2.%3")
+                .arg(federatedColumns(record, i))
+                .arg(librarySchema(i)).arg(table);
+        }
+        if (!execStatement(query, QString("CREATE TEMP VIEW %1 AS %2")
+                           .arg(table).arg(selects.join(" UNION ALL ")),
+                           "create federated " + table + " view"))
+            return false;
+    }
+
+    QStringList generations;
+    for (int i = 0; i < libraryFilePaths.size(); ++i) {
+        generations << QString("SELECT value FROM %1.Generation")
+            .arg(librarySchema(i));
+    }
+    return execStatement(query,
+                         QString("CREATE TEMP VIEW Generation AS"
+                                 "  SELECT SUM(value) AS value FROM (%1)")
+                         .arg(generations.join(" UNION ALL ")),
+                         "create federated Generation view");
+}
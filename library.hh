@@ -0,0 +1,78 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LIBRARY_HH
+#define LIBRARY_HH
+
+#include <QtSql>
+
+// Catalogs are kept in libraries, one database per archive root, so that
+// a disk can be catalogued and opened on its own and imports into
+// different libraries do not share a write lock.
+//
+// Several libraries can be browsed as one catalog. The first library is
+// the main database of every connection and the others are attached to
+// it. Temporary views named after the catalog tables then shadow the
+// tables of the main database with the union of the tables of every
+// library, so queries written for a single library read the federated
+// catalog unchanged. A federated catalog is read-only.
+//
+// Queries ordered by a column of a view, like the path order of the sort
+// keys and the snapshot, make SQLite sort the union of the libraries, it
+// does not merge the ordered scans of each library. They run on the
+// catalog service thread.
+//
+// Image ids stay 32-bit: the index of the library of an image is kept in
+// the bits above the lowest libraryIdBits, which hold the id of the image
+// within its library, so at most maxLibraryCount libraries are federated.
+// Images of the first library keep their ids.
+static const int libraryIdBits = 28;
+static const int maxLibraryCount = 1 << (32 - libraryIdBits);
+
+// Range of local image ids of one library.
+struct LibraryIdRange
+{
+    int library;
+    qint64 first;
+    qint64 last;
+};
+
+// Database of the library rooted at the given directory.
+QString libraryFilePath(const QString& rootPath);
+
+// Sets the database files of the libraries, the first one being the main
+// database. Must be called before any connection is opened.
+void setLibraries(const QStringList& filePaths);
+QStringList libraries();
+bool isFederated();
+
+// Attaches the libraries after the first to the connection and creates
+// the federated views. Does nothing for a single library.
+bool attachLibraries(QSqlDatabase db);
+
+// Schema name of the index:th library in attached connections.
+QString librarySchema(int index);
+int libraryIndex(qint64 imageId);
+qint64 localImageId(qint64 imageId);
+qint64 globalImageId(int index, qint64 localId);
+// Splits a range of global image ids into ranges of local ids, so that
+// lookups by id use the primary key of the library table rather than
+// filter the federated view.
+QList<LibraryIdRange> libraryIdRanges(qint64 firstId, qint64 lastId);
+// Name of the table of the index:th library, qualified by its schema.
+QString libraryTable(int index, const QString& table);
+
+#endif // LIBRARY_HH
@@ -0,0 +1,208 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QtSql>
+
+#include "locationsearch.hh"
+
+// Mean radius of the Earth in metres.
+static const double earthRadius = 6371008.8;
+
+static double radians(const double degrees)
+{
+    return degrees * M_PI / 180.0;
+}
+
+static double degrees(const double radians)
+{
+    return radians * 180.0 / M_PI;
+}
+
+// Great-circle distance in metres by the haversine formula, which stays
+// accurate for short distances.
+static double distance(const double latitude1, const double longitude1,
+                       const double latitude2, const double longitude2)
+{
+    const double dLatitude = radians(latitude2 - latitude1);
+    const double dLongitude = radians(longitude2 - longitude1);
+    const double a = qPow(qSin(dLatitude / 2.0), 2)
+        + qCos(radians(latitude1)) * qCos(radians(latitude2))
+        * qPow(qSin(dLongitude / 2.0), 2);
+
+    return 2.0 * earthRadius * qAtan2(qSqrt(a), qSqrt(1.0 - a));
+}
+
+struct Location
+{
+    quint32 id;
+    double latitude;
+    double longitude;
+};
+
+// Images whose location is within the box, by the index first and then by
+// the exact coordinates, as the index rounds them outwards.
+static bool selectBox(const double south, const double west,
+                      const double north, const double east,
+                      QVector<Location>* result, QSqlDatabase db)
+{
+    QList<QPair<double, double> > longitudeRanges;
+    if (west <= east) {
+        longitudeRanges << qMakePair(west, east);
+    } else {
+        longitudeRanges << qMakePair(west, 180.0)
+                        << qMakePair(-180.0, east);
+    }
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    query.prepare("SELECT Image.id, Image.latitude, Image.longitude"
+                  "  FROM ImageLocation"
+                  "  JOIN Image ON Image.id = ImageLocation.id"
+                  "  WHERE ImageLocation.max_latitude >= ?"
+                  "    AND ImageLocation.min_latitude <= ?"
+                  "    AND ImageLocation.max_longitude >= ?"
+                  "    AND ImageLocation.min_longitude <= ?");
+
+    for (int i = 0; i < longitudeRanges.size(); ++i) {
+        query.bindValue(0, south);
+        query.bindValue(1, north);
+        query.bindValue(2, longitudeRanges[i].first);
+        query.bindValue(3, longitudeRanges[i].second);
+        if (!query.exec()) {
+            qWarning() << "failed to find images by location:"
+                       << query.lastError().databaseText();
+            return false;
+        }
+        while (query.next()) {
+            Location location;
+            location.id = query.value(0).toUInt();
+            location.latitude = query.value(1).toDouble();
+            location.longitude = query.value(2).toDouble();
+            if (location.latitude >= south && location.latitude <= north
+                && location.longitude >= longitudeRanges[i].first
+                && location.longitude <= longitudeRanges[i].second)
+                result->append(location);
+        }
+    }
+
+    return true;
+}
+
+bool updateLocation(const qint64 imageId, QSqlDatabase db)
+{
+    QSqlQuery query(db);
+
+    query.prepare("DELETE FROM ImageLocation WHERE id = ?");
+    query.addBindValue(imageId);
+    if (!query.exec()) {
+        qWarning() << "failed to remove image location:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+
+    query.prepare("INSERT INTO ImageLocation(id, min_latitude, max_latitude,"
+                  "                          min_longitude, max_longitude)"
+                  "  SELECT id, latitude, latitude, longitude, longitude"
+                  "  FROM Image"
+                  "  WHERE id = ? AND latitude IS NOT NULL"
+                  "    AND longitude IS NOT NULL");
+    query.addBindValue(imageId);
+    if (!query.exec()) {
+        qWarning() << "failed to insert image location:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+
+    return true;
+}
+
+bool imageLocation(const qint64 imageId, double* const latitude,
+                   double* const longitude, QSqlDatabase db)
+{
+    QSqlQuery query(db);
+
+    query.prepare("SELECT latitude, longitude FROM Image"
+                  "  WHERE id = ? AND latitude IS NOT NULL"
+                  "    AND longitude IS NOT NULL");
+    query.addBindValue(imageId);
+    if (!query.exec() || !query.next())
+        return false;
+
+    *latitude = query.value(0).toDouble();
+    *longitude = query.value(1).toDouble();
+
+    return true;
+}
+
+bool findImagesInBox(const double south, const double west,
+                     const double north, const double east,
+                     Bitmap* const result, QSqlDatabase db)
+{
+    QVector<Location> locations;
+
+    result->clear();
+    if (!selectBox(south, west, north, east, &locations, db))
+        return false;
+
+    foreach (const Location& location, locations) {
+        result->add(location.id);
+    }
+
+    return true;
+}
+
+// The circle is bounded by a box first, so that the index does the work
+// and only the images in its corners are measured in vain.
+bool findImagesNear(const double latitude, const double longitude,
+                    const double radius, Bitmap* const result,
+                    QSqlDatabase db)
+{
+    const double angle = radius / earthRadius;
+    double south = latitude - degrees(angle);
+    double north = latitude + degrees(angle);
+    double west = -180.0;
+    double east = 180.0;
+
+    // A circle around a pole spans every longitude.
+    if (south > -90.0 && north < 90.0) {
+        const double sinAngle = qSin(angle) / qCos(radians(latitude));
+        if (sinAngle < 1.0) {
+            const double dLongitude = degrees(qAsin(sinAngle));
+            west = longitude - dLongitude;
+            east = longitude + dLongitude;
+            if (west < -180.0)
+                west += 360.0;
+            if (east > 180.0)
+                east -= 360.0;
+        }
+    }
+    south = qMax(south, -90.0);
+    north = qMin(north, 90.0);
+
+    QVector<Location> locations;
+
+    result->clear();
+    if (!selectBox(south, west, north, east, &locations, db))
+        return false;
+
+    foreach (const Location& location, locations) {
+        if (distance(latitude, longitude, location.latitude,
+                     location.longitude) <= radius)
+            result->add(location.id);
+    }
+
+    return true;
+}
@@ -0,0 +1,47 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LOCATIONSEARCH_HH
+#define LOCATIONSEARCH_HH
+
+#include <QtSql>
+
+#include "bitmap.hh"
+
+// Spatial index over the GPS coordinates of images, kept in the
+// ImageLocation table as points. It must be updated in the same
+// transaction as the rows it describes.
+bool updateLocation(qint64 imageId,
+                    QSqlDatabase db = QSqlDatabase::database());
+
+// Coordinates of the image in degrees. Returns false if the image has no
+// location.
+bool imageLocation(qint64 imageId, double* latitude, double* longitude,
+                   QSqlDatabase db = QSqlDatabase::database());
+
+// Finds images located within the box. A box whose west edge is east of
+// its east edge crosses the antimeridian.
+bool findImagesInBox(double south, double west, double north, double east,
+                     Bitmap* result,
+                     QSqlDatabase db = QSqlDatabase::database());
+
+// Finds images located within the given great-circle distance in metres
+// of the point.
+bool findImagesNear(double latitude, double longitude, double radius,
+                    Bitmap* result,
+                    QSqlDatabase db = QSqlDatabase::database());
+
+#endif // LOCATIONSEARCH_HH
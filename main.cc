@@ -14,7 +14,15 @@
 // You should have received a copy of the GNU General Public License
 // along with this program. If not, see <http://www.gnu.org/licenses/>.
 
+#include "benchmark.hh"
+#include "exporter.hh"
+#include "filereader.hh"
+#include "iolocality.hh"
+#include "library.hh"
 #include "mainwindow.hh"
+#include "similarityindex.hh"
+#include "startup.hh"
+#include "tagindex.hh"
 
 static void printHelp()
 {
@@ -25,6 +33,60 @@ static void printHelp()
     cout << "Options:" << endl;
     cout << " -h, --help         display this help and exit" << endl;
     cout << " -r, --recursive    search DIR recursively" << endl;
+    cout << "     --find-similar=FILE" << endl;
+    cout << "                    print catalogued images similar to FILE and exit"
+         << endl;
+    cout << "     --radius=N     maximum Hamming distance of similar images"
+         << endl;
+    cout << "                    (default: 10)" << endl;
+    cout << "     --export=DIR   export catalogued images as JPEG files to DIR"
+         << endl;
+    cout << "                    and exit; the options below default to"
+         << endl;
+    cout << "                    the settings of the last export" << endl;
+    cout << "     --tags=QUERY   export only images matching the tag QUERY,"
+         << endl;
+    cout << "                    e.g. 'family AND NOT blurry'" << endl;
+    cout << "     --size=N       longest side of exported images in pixels,"
+         << endl;
+    cout << "                    0 keeps the original size" << endl;
+    cout << "     --quality=N    JPEG quality of exported images, 1-100"
+         << endl;
+    cout << "     --name=TEMPLATE" << endl;
+    cout << "                    names of exported files, {name}, {index},"
+         << endl;
+    cout << "                    {date} and {time} are replaced" << endl;
+    cout << "     --library=PATH catalog of the library rooted at directory"
+         << endl;
+    cout << "                    PATH or in database file PATH (default:"
+         << endl;
+    cout << "                    home directory); given several times, the"
+         << endl;
+    cout << "                    libraries are browsed as one read-only"
+         << endl;
+    cout << "                    catalog" << endl;
+    cout << "     --io-order=MODE" << endl;
+    cout << "                    order in which imported files are read: path,"
+         << endl;
+    cout << "                    inode or extent (default: path)" << endl;
+    cout << "     --read-mode=MODE" << endl;
+    cout << "                    how imported files are read: async, many"
+         << endl;
+    cout << "                    at once through io_uring where available,"
+         << endl;
+    cout << "                    or threads (default: async)" << endl;
+    cout << "     --import-benchmark" << endl;
+    cout << "                    run the import pipeline over DIRs and FILEs"
+         << endl;
+    cout << "                    without cataloguing them, print throughput"
+         << endl;
+    cout << "                    and exit; drop the page cache beforehand"
+         << endl;
+    cout << "                    to measure cold-cache reads" << endl;
+    cout << "     --startup-benchmark" << endl;
+    cout << "                    print the startup milestones once the catalog"
+         << endl;
+    cout << "                    is shown and exit" << endl;
     cout << "     --version      output version information and exit" << endl;
     cout << endl;
     cout << "Parameters:" << endl;
@@ -65,6 +127,7 @@ static QHash<QString, QVariant> parseArgs(QStringList args)
     QHash<QString, QVariant> options;
 
     options["recursive"] = false;
+    options["radius"] = 10;
 
     // Skip the first argument which is the program name in Linux.
     args.takeFirst();
@@ -82,6 +145,103 @@ static QHash<QString, QVariant> parseArgs(QStringList args)
             options["recursive"] = true;
             args.takeFirst();
             continue;
+        } else if (arg.startsWith("--find-similar=")) {
+            options["findSimilar"] = arg.section('=', 1);
+            args.takeFirst();
+            continue;
+        } else if (arg.startsWith("--radius=")) {
+            bool ok;
+            const int radius = arg.section('=', 1).toInt(&ok);
+            if (!ok || radius < 0 || radius > SimilarityIndex::MaxRadius) {
+                printError(QString("invalid radius '%1'")
+                           .arg(arg.section('=', 1)));
+                exit(1);
+            }
+            options["radius"] = radius;
+            args.takeFirst();
+            continue;
+        } else if (arg.startsWith("--export=")) {
+            options["export"] = arg.section('=', 1);
+            args.takeFirst();
+            continue;
+        } else if (arg.startsWith("--tags=")) {
+            options["tags"] = arg.section('=', 1);
+            args.takeFirst();
+            continue;
+        } else if (arg.startsWith("--size=")) {
+            bool ok;
+            const int size = arg.section('=', 1).toInt(&ok);
+            if (!ok || size < 0) {
+                printError(QString("invalid size '%1'")
+                           .arg(arg.section('=', 1)));
+                exit(1);
+            }
+            options["size"] = size;
+            args.takeFirst();
+            continue;
+        } else if (arg.startsWith("--quality=")) {
+            bool ok;
+            const int quality = arg.section('=', 1).toInt(&ok);
+            if (!ok || quality < 1 || quality > 100) {
+                printError(QString("invalid quality '%1'")
+                           .arg(arg.section('=', 1)));
+                exit(1);
+            }
+            options["quality"] = quality;
+            args.takeFirst();
+            continue;
+        } else if (arg.startsWith("--name=")) {
+            if (arg.section('=', 1).trimmed().isEmpty()) {
+                printError("empty file name template");
+                exit(1);
+            }
+            options["name"] = arg.section('=', 1);
+            args.takeFirst();
+            continue;
+        } else if (arg.startsWith("--library=")) {
+            const QString path(arg.section('=', 1));
+            if (path.isEmpty()) {
+                printError("empty library path");
+                exit(1);
+            }
+            QStringList libraries(options["libraries"].toStringList());
+            libraries << (QFileInfo(path).isDir()
+                          ? libraryFilePath(path)
+                          : QFileInfo(path).absoluteFilePath());
+            options["libraries"] = libraries;
+            args.takeFirst();
+            continue;
+        } else if (arg.startsWith("--io-order=")) {
+            bool ok;
+            const IoOrder order = ioOrderFromString(arg.section('=', 1), &ok);
+            if (!ok) {
+                printError(QString("invalid I/O order '%1'")
+                           .arg(arg.section('=', 1)));
+                exit(1);
+            }
+            options["ioOrder"] = int(order);
+            args.takeFirst();
+            continue;
+        } else if (arg.startsWith("--read-mode=")) {
+            bool ok;
+            const ReadMode mode = readModeFromString(arg.section('=', 1),
+                                                     &ok);
+            if (!ok) {
+                printError(QString("invalid read mode '%1'")
+                           .arg(arg.section('=', 1)));
+                exit(1);
+            }
+            options["readMode"] = int(mode);
+            args.takeFirst();
+            continue;
+        } else if (arg == "--startup-benchmark") {
+            options["startupBenchmark"] = true;
+            args.takeFirst();
+            continue;
+        } else if (arg == "--import-benchmark") {
+            options["importBenchmark"] = true;
+            args.takeFirst();
+            continue;
         } else if (arg == "--" || !arg.startsWith("-")) {
             // Option parsing stops, positional parameter parsing
             // starts.
@@ -93,20 +253,246 @@ static QHash<QString, QVariant> parseArgs(QStringList args)
     }
 
     options["paths"] = args;
+    if (!options.contains("libraries"))
+        options["libraries"] = QStringList(libraryFilePath(QDir::homePath()));
 
     return options;
 }
 
-static void prepareDatabase()
+// Command line queries, exports and benchmarks do not need a display. The
+// check stops at the first parameter like parseArgs() does, so an option
+// found here is also found there.
+static bool isHeadless(const int argc, char* argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        const QString arg(QString::fromLocal8Bit(argv[i]));
+
+        if (arg == "--" || !arg.startsWith("-"))
+            break;
+        if (arg.startsWith("--find-similar=") || arg.startsWith("--export=")
+            || arg == "--import-benchmark" || arg == "--help"
+            || arg == "-h" || arg == "--version")
+            return true;
+    }
+
+    return false;
+}
+
+static void execSchemaStatement(const QString& statement,
+                                const QString& description)
+{
+    QTextStream cerr(stderr);
+    QSqlQuery query;
+
+    if (!query.exec(statement)) {
+        cerr << "error: failed to " << description << ":"
+             << query.lastError().databaseText() << endl;
+        exit(1);
+    }
+}
+
+// Julian day number of a timestamp column, timestamps which cannot be
+// parsed count as the epoch like images without EXIF timestamps do.
+#define TIMELINE_DAY(column)                                            \
+    "COALESCE(CAST(julianday(substr(" column ", 1, 10)) + 0.5 AS INTEGER)," \
+    " 2440588)"
+
+// Each step upgrades the schema from version i to i + 1. Steps are only
+// ever appended, existing databases are brought up to date by running the
+// steps they have not seen yet.
+static void migrateDatabase(const int version)
+{
+    switch (version) {
+    case 0:
+        execSchemaStatement("CREATE TABLE Image ("
+                            "  id INTEGER PRIMARY KEY,"
+                            "  file_path TEXT NOT NULL,"
+                            "  file_size INTEGER NOT NULL,"
+                            "  mtime TEXT NOT NULL,"
+                            "  pixel_width INTEGER NOT NULL,"
+                            "  pixel_height INTEGER NOT NULL,"
+                            "  exif_datetime TEXT NOT NULL,"
+                            "  exif_orientation INTEGER NOT NULL,"
+                            "  thumbnail_file_path TEXT NOT NULL,"
+                            "  thumbnail_pixel_width INTEGER NOT NULL,"
+                            "  thumbnail_pixel_height INTEGER NOT NULL,"
+                            "  UNIQUE(file_path));",
+                            "create Image table");
+        execSchemaStatement("CREATE TABLE Tagging ("
+                            "  id INTEGER PRIMARY KEY,"
+                            "  file_path TEXT NOT NULL,"
+                            "  tag TEXT NOT NULL,"
+                            "  UNIQUE(file_path, tag));",
+                            "create Tagging table");
+        break;
+    case 1:
+        execSchemaStatement("ALTER TABLE Image ADD COLUMN phash INTEGER;",
+                            "add phash column to Image table");
+        break;
+    case 2:
+        // FTS5 is preferred, older SQLite builds only have FTS4 which
+        // answers the same prefix queries.
+        if (!QSqlQuery().exec("CREATE VIRTUAL TABLE ImageText USING fts5("
+                              "  path, tags, exif, prefix='1 2 3');")) {
+            execSchemaStatement("CREATE VIRTUAL TABLE ImageText USING fts4("
+                                "  path, tags, exif, prefix=\"1,2,3\");",
+                                "create ImageText table");
+        }
+        execSchemaStatement("INSERT INTO ImageText(rowid, path, tags, exif)"
+                            "  SELECT id, file_path,"
+                            "    COALESCE((SELECT group_concat(tag, ' ')"
+                            "              FROM Tagging"
+                            "              WHERE Tagging.file_path"
+                            "                    = Image.file_path), ''),"
+                            "    exif_datetime"
+                            "  FROM Image;",
+                            "populate ImageText table");
+        break;
+    case 3:
+        // Capture day counts for the timeline, keyed by Julian day number
+        // and kept up to date by triggers on Image.
+        execSchemaStatement("CREATE TABLE Timeline ("
+                            "  day INTEGER PRIMARY KEY,"
+                            "  count INTEGER NOT NULL);",
+                            "create Timeline table");
+        execSchemaStatement("INSERT INTO Timeline(day, count)"
+                            "  SELECT " TIMELINE_DAY("exif_datetime") ","
+                            "    COUNT(*)"
+                            "  FROM Image GROUP BY 1;",
+                            "populate Timeline table");
+        execSchemaStatement("CREATE TRIGGER Image_timeline_insert"
+                            "  AFTER INSERT ON Image BEGIN"
+                            "    INSERT OR IGNORE INTO Timeline(day, count)"
+                            "      VALUES(" TIMELINE_DAY("NEW.exif_datetime")
+                            "             , 0);"
+                            "    UPDATE Timeline SET count = count + 1"
+                            "      WHERE day = "
+                            TIMELINE_DAY("NEW.exif_datetime") ";"
+                            "  END;",
+                            "create Timeline insert trigger");
+        execSchemaStatement("CREATE TRIGGER Image_timeline_delete"
+                            "  AFTER DELETE ON Image BEGIN"
+                            "    UPDATE Timeline SET count = count - 1"
+                            "      WHERE day = "
+                            TIMELINE_DAY("OLD.exif_datetime") ";"
+                            "  END;",
+                            "create Timeline delete trigger");
+        execSchemaStatement("CREATE TRIGGER Image_timeline_update"
+                            "  AFTER UPDATE OF exif_datetime ON Image BEGIN"
+                            "    UPDATE Timeline SET count = count - 1"
+                            "      WHERE day = "
+                            TIMELINE_DAY("OLD.exif_datetime") ";"
+                            "    INSERT OR IGNORE INTO Timeline(day, count)"
+                            "      VALUES(" TIMELINE_DAY("NEW.exif_datetime")
+                            "             , 0);"
+                            "    UPDATE Timeline SET count = count + 1"
+                            "      WHERE day = "
+                            TIMELINE_DAY("NEW.exif_datetime") ";"
+                            "  END;",
+                            "create Timeline update trigger");
+        break;
+    case 4:
+        // Catalog generation, bumped by every change to Image. Catalog
+        // snapshots record the generation they were taken at.
+        execSchemaStatement("CREATE TABLE Generation ("
+                            "  value INTEGER NOT NULL);",
+                            "create Generation table");
+        execSchemaStatement("INSERT INTO Generation(value) VALUES(0);",
+                            "initialize Generation table");
+        execSchemaStatement("CREATE TRIGGER Image_generation_insert"
+                            "  AFTER INSERT ON Image BEGIN"
+                            "    UPDATE Generation SET value = value + 1;"
+                            "  END;",
+                            "create Generation insert trigger");
+        execSchemaStatement("CREATE TRIGGER Image_generation_delete"
+                            "  AFTER DELETE ON Image BEGIN"
+                            "    UPDATE Generation SET value = value + 1;"
+                            "  END;",
+                            "create Generation delete trigger");
+        execSchemaStatement("CREATE TRIGGER Image_generation_update"
+                            "  AFTER UPDATE ON Image BEGIN"
+                            "    UPDATE Generation SET value = value + 1;"
+                            "  END;",
+                            "create Generation update trigger");
+        break;
+    case 5:
+        // Extended EXIF fields. The main window imports the files of
+        // existing rows again to fill them in, see metadataVersion.
+        execSchemaStatement("ALTER TABLE Image ADD COLUMN camera_make TEXT;",
+                            "add camera_make column to Image table");
+        execSchemaStatement("ALTER TABLE Image ADD COLUMN camera_model TEXT;",
+                            "add camera_model column to Image table");
+        execSchemaStatement("ALTER TABLE Image ADD COLUMN lens_model TEXT;",
+                            "add lens_model column to Image table");
+        execSchemaStatement("ALTER TABLE Image ADD COLUMN focal_length REAL;",
+                            "add focal_length column to Image table");
+        execSchemaStatement("ALTER TABLE Image ADD COLUMN iso_speed INTEGER;",
+                            "add iso_speed column to Image table");
+        execSchemaStatement("ALTER TABLE Image ADD COLUMN exposure_time REAL;",
+                            "add exposure_time column to Image table");
+        execSchemaStatement("ALTER TABLE Image ADD COLUMN"
+                            "  metadata_version INTEGER NOT NULL DEFAULT 0;",
+                            "add metadata_version column to Image table");
+        execSchemaStatement("CREATE INDEX Image_camera"
+                            "  ON Image(camera_make, camera_model);",
+                            "create camera index");
+        execSchemaStatement("CREATE INDEX Image_lens_model"
+                            "  ON Image(lens_model);",
+                            "create lens index");
+        execSchemaStatement("CREATE INDEX Image_focal_length"
+                            "  ON Image(focal_length);",
+                            "create focal length index");
+        execSchemaStatement("CREATE INDEX Image_iso_speed"
+                            "  ON Image(iso_speed);",
+                            "create ISO speed index");
+        execSchemaStatement("CREATE INDEX Image_exposure_time"
+                            "  ON Image(exposure_time);",
+                            "create exposure time index");
+        break;
+    case 6:
+        // GPS coordinates in degrees. ImageLocation holds them as points
+        // in an R*Tree for box queries; the tree keeps 32-bit floats, so
+        // exact distances come from the Image columns. SQLite builds
+        // without the R*Tree module get a plain table with the same
+        // columns, which answers the same queries less efficiently.
+        execSchemaStatement("ALTER TABLE Image ADD COLUMN latitude REAL;",
+                            "add latitude column to Image table");
+        execSchemaStatement("ALTER TABLE Image ADD COLUMN longitude REAL;",
+                            "add longitude column to Image table");
+        if (!QSqlQuery().exec("CREATE VIRTUAL TABLE ImageLocation USING"
+                              "  rtree(id, min_latitude, max_latitude,"
+                              "        min_longitude, max_longitude);")) {
+            execSchemaStatement("CREATE TABLE ImageLocation ("
+                                "  id INTEGER PRIMARY KEY,"
+                                "  min_latitude REAL NOT NULL,"
+                                "  max_latitude REAL NOT NULL,"
+                                "  min_longitude REAL NOT NULL,"
+                                "  max_longitude REAL NOT NULL);",
+                                "create ImageLocation table");
+            execSchemaStatement("CREATE INDEX ImageLocation_latitude"
+                                "  ON ImageLocation(min_latitude);",
+                                "create ImageLocation index");
+        }
+        execSchemaStatement("CREATE TRIGGER Image_location_delete"
+                            "  AFTER DELETE ON Image BEGIN"
+                            "    DELETE FROM ImageLocation WHERE id = OLD.id;"
+                            "  END;",
+                            "create ImageLocation delete trigger");
+        break;
+    }
+}
+
+static const int schemaVersion = 7;
+
+// Opens the library database through the default connection, creating and
+// migrating it as needed.
+static void prepareLibrary(QSqlDatabase db, const QString& filePath)
 {
     QTextStream cerr(stdout);
 
-    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
-    QDir::home().mkdir(".sqim");
-    db.setDatabaseName(QString("%1/%2/%3")
-                       .arg(QDir::homePath())
-                       .arg(".sqim")
-                       .arg("db.sqlite3"));
+    db.close();
+    QFileInfo(filePath).dir().mkpath(".");
+    db.setDatabaseName(filePath);
 
     if (!db.open()) {
         // If the database cannot be opened, there's nothing to be done here.
@@ -115,11 +501,38 @@ static void prepareDatabase()
         exit(1);
     }
 
-    if (!db.tables().isEmpty()) {
-        // Assume database is valid if it has tables. TODO: implement robust
-        // database validation check.
+    QSqlQuery query;
+    if (!query.exec("PRAGMA user_version;") || !query.next()) {
+        cerr << "error: failed to query the database schema version:"
+             << query.lastError().databaseText() << endl;
+        exit(1);
+    }
+    int version = query.value(0).toInt();
+    query.finish();
+
+    // Databases created before the schema was versioned have tables but
+    // no version, they match the first version of the schema.
+    if (version == 0 && !db.tables().isEmpty())
+        version = 1;
+
+    if (version > schemaVersion) {
+        cerr << "error: database schema version " << version
+             << " is newer than the supported version "
+             << schemaVersion << endl;
+        exit(1);
+    }
+
+    if (version == schemaVersion)
         return;
+
+    // Write-ahead logging lets the catalog service thread read while an
+    // import is writing. The mode is stored in the database, so it is set
+    // only when the database is created or migrated.
+    if (!query.exec("PRAGMA journal_mode = WAL;")) {
+        cerr << "warning: failed to enable write-ahead logging:"
+             << query.lastError().databaseText() << endl;
     }
+    query.finish();
 
     if (!db.transaction()) {
         cerr << "error: failed to begin initialization transaction:"
@@ -127,61 +540,216 @@ static void prepareDatabase()
         exit(1);
     }
 
-    QSqlQuery query;
+    for (; version < schemaVersion; ++version)
+        migrateDatabase(version);
 
-    if (!query.exec("CREATE TABLE Image ("
-                    "  id INTEGER PRIMARY KEY,"
-                    "  file_path TEXT NOT NULL,"
-                    "  file_size INTEGER NOT NULL,"
-                    "  mtime TEXT NOT NULL,"
-                    "  pixel_width INTEGER NOT NULL,"
-                    "  pixel_height INTEGER NOT NULL,"
-                    "  exif_datetime TEXT NOT NULL,"
-                    "  exif_orientation INTEGER NOT NULL,"
-                    "  thumbnail_file_path TEXT NOT NULL,"
-                    "  thumbnail_pixel_width INTEGER NOT NULL,"
-                    "  thumbnail_pixel_height INTEGER NOT NULL,"
-                    "  UNIQUE(file_path));")) {
-        cerr << "error: failed to create Image table:"
-             << query.lastError().databaseText() << endl;
+    execSchemaStatement(QString("PRAGMA user_version = %1;")
+                        .arg(schemaVersion),
+                        "update the database schema version");
+
+    if (!db.commit()) {
+        cerr << "error: failed to commit the initial transaction:"
+             << db.lastError().databaseText() << endl;
         exit(1);
     }
+}
 
-    if (!query.exec("CREATE TABLE Tagging ("
-                    "  id INTEGER PRIMARY KEY,"
-                    "  file_path TEXT NOT NULL,"
-                    "  tag TEXT NOT NULL,"
-                    "  UNIQUE(file_path, tag));")) {
-        cerr << "error: failed to create Tagging table:"
-             << query.lastError().databaseText() << endl;
+// Every library is brought up to date, the first one is left open as the
+// main database with the others attached to it.
+static void prepareDatabase(const QStringList& libraries)
+{
+    QTextStream cerr(stdout);
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE");
+
+    setLibraries(libraries);
+    for (int i = libraries.size() - 1; i >= 0; --i)
+        prepareLibrary(db, libraries[i]);
+
+    if (!attachLibraries(db)) {
+        cerr << "error: failed to open the libraries" << endl;
         exit(1);
     }
+}
 
-    if (!db.commit()) {
-        cerr << "error: failed to commit the initial transaction:"
-             << db.lastError().databaseText() << endl;
-        exit(1);
+static int findSimilar(const QString& filePath, const int radius)
+{
+    QTextStream cout(stdout);
+    QTextStream cerr(stderr);
+
+    QSqlQuery query;
+    query.prepare("SELECT id FROM Image WHERE file_path = ?");
+    query.addBindValue(QFileInfo(filePath).canonicalFilePath());
+    if (!query.exec() || !query.next()) {
+        cerr << "error: " << filePath << " is not in the catalog" << endl;
+        return 1;
+    }
+    const qint64 id = query.value(0).toLongLong();
+
+    SimilarityIndex index;
+    if (!index.load())
+        return 1;
+
+    if (!index.contains(id)) {
+        cerr << "error: " << filePath << " does not have a thumbnail" << endl;
+        return 1;
+    }
+
+    const quint64 hash = index.hash(id);
+    const QList<qint64> ids = index.find(hash, radius);
+
+    query.prepare("SELECT file_path, phash FROM Image WHERE id = ?");
+    foreach (qint64 similarId, ids) {
+        if (similarId == id)
+            continue;
+        query.bindValue(0, similarId);
+        if (!query.exec() || !query.next())
+            continue;
+        cout << hammingDistance(hash, quint64(query.value(1).toLongLong()))
+             << "\t" << query.value(0).toString() << endl;
+    }
+
+    return 0;
+}
+
+static int exportImages(const QHash<QString, QVariant>& options)
+{
+    QTextStream cout(stdout);
+    QTextStream cerr(stderr);
+
+    TagIndex tagIndex;
+    if (!tagIndex.load()) {
+        cerr << "error: failed to load tags" << endl;
+        return 1;
     }
+
+    Bitmap ids(tagIndex.allImages());
+    if (options.contains("tags")) {
+        QString errorString;
+        if (!tagIndex.evaluate(options["tags"].toString(), &ids,
+                               &errorString)) {
+            cerr << "error: invalid tag query: " << errorString << endl;
+            return 1;
+        }
+    }
+
+    // Options not given default to the settings of the last export made
+    // from the window; they are not saved.
+    Exporter exporter;
+    exporter.loadSettings();
+    exporter.setTargetDirectory(options["export"].toString());
+    if (options.contains("size"))
+        exporter.setMaximumSize(options["size"].toInt());
+    if (options.contains("quality"))
+        exporter.setQuality(options["quality"].toInt());
+    if (options.contains("name"))
+        exporter.setFileNameTemplate(options["name"].toString());
+
+    QEventLoop loop;
+    QObject::connect(&exporter, SIGNAL(finished()), &loop, SLOT(quit()));
+    QList<qint64> exportIds;
+    foreach (Bitmap::Range range, ids.ranges()) {
+        for (qint64 id = range.first; id <= range.second; ++id)
+            exportIds.append(id);
+    }
+    exporter.start(exportIds);
+    loop.exec();
+
+    const int failedCount = exporter.failedCount();
+    cout << "exported " << exporter.imageCount() - failedCount
+         << " images to " << exporter.targetDirectory() << endl;
+    if (failedCount) {
+        cerr << "error: failed to export " << failedCount << " images"
+             << endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+static int importBenchmark(const QStringList& paths, const bool recursive,
+                           const IoOrder ioOrder, const ReadMode readMode)
+{
+    ImportBenchmark benchmark(paths, recursive, ioOrder, readMode);
+    QObject::connect(&benchmark, SIGNAL(finished(int)),
+                     QCoreApplication::instance(), SLOT(exit(int)));
+    QTimer::singleShot(0, &benchmark, SLOT(start()));
+
+    return QCoreApplication::exec();
 }
 
 int main(int argc, char *argv[])
 {
-    QApplication app(argc, argv);
-    app.setOrganizationDomain("tjjr.fi");
-    app.setApplicationName("sqim");
+    startStartupClock();
+
+    // The application is created before the arguments are parsed, so that
+    // QApplication takes its own options, such as -style, out of them.
+    QScopedPointer<QCoreApplication> app(
+        isHeadless(argc, argv)
+        ? new QCoreApplication(argc, argv)
+        : new QApplication(argc, argv));
+    app->setOrganizationDomain("tjjr.fi");
+    app->setApplicationName("sqim");
+    markStartupMilestone("application created");
+
+    QHash<QString, QVariant> options =
+        parseArgs(QCoreApplication::arguments());
+
+    if (options["libraries"].toStringList().size() > 1
+        && !options["paths"].toStringList().isEmpty()) {
+        printError("images are imported into one library at a time");
+        return 1;
+    }
 
-    QFile styleSheetFile(":sqim.qss");
-    styleSheetFile.open(QFile::ReadOnly);
-    app.setStyleSheet(styleSheetFile.readAll());
+    if (options.contains("findSimilar")) {
+        prepareDatabase(options["libraries"].toStringList());
+        return findSimilar(options["findSimilar"].toString(),
+                           options["radius"].toInt());
+    }
 
-    QHash<QString, QVariant> options = parseArgs(app.arguments());
+    if (options.contains("export")) {
+        if (!options["paths"].toStringList().isEmpty()) {
+            printError("--export does not take DIR or FILE parameters");
+            return 1;
+        }
+        prepareDatabase(options["libraries"].toStringList());
+        return exportImages(options);
+    }
 
-    prepareDatabase();
+    if (options.contains("importBenchmark")) {
+        return importBenchmark(options["paths"].toStringList(),
+                               options["recursive"].toBool(),
+                               IoOrder(options.value("ioOrder",
+                                                     PathIoOrder).toInt()),
+                               ReadMode(options.value(
+                                            "readMode",
+                                            AsyncReadMode).toInt()));
+    }
+
+    // Room for a few screenfuls of the larger thumbnail levels.
+    QPixmapCache::setCacheLimit(64 * 1024);
+
+    prepareDatabase(options["libraries"].toStringList());
+    markStartupMilestone("database ready");
 
     MainWindow mainWindow;
+    markStartupMilestone("window created");
+    mainWindow.show();
+    markStartupMilestone("window shown");
+
+    if (options.contains("ioOrder"))
+        mainWindow.setImportIoOrder(IoOrder(options["ioOrder"].toInt()));
+    if (options.contains("readMode"))
+        mainWindow.setImportReadMode(ReadMode(options["readMode"].toInt()));
     mainWindow.importPaths(options["paths"].toStringList(),
                            options["recursive"].toBool());
-    mainWindow.show();
 
-    return app.exec();
+    if (!options.contains("startupBenchmark"))
+        return app->exec();
+
+    QObject::connect(&mainWindow, SIGNAL(startupFinished()),
+                     app.data(), SLOT(quit()));
+    const int exitCode = app->exec();
+    QTextStream cout(stdout);
+    printStartupMilestones(cout);
+    return mainWindow.isStartupFailed() ? 1 : exitCode;
 }
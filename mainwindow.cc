@@ -15,134 +15,76 @@
 // along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "common.hh"
+#include "exportdialog.hh"
 #include "mainwindow.hh"
 #include "metadata.hh"
 #include "imageitemdelegate.hh"
-
-static QStringList findFiles(QString dir, bool recursive)
+#include "importer.hh"
+#include "library.hh"
+#include "locationsearch.hh"
+#include "similarityindex.hh"
+#include "startup.hh"
+#include "tagcompleter.hh"
+#include "tagdialog.hh"
+#include "textsearch.hh"
+
+// Brings the thumbnails of an already imported image up to date with the
+// configured thumbnail levels and records whether that succeeded.
+static void updateThumbnails(Metadata& metadata)
 {
-    QStringList retval;
-
-    QStringList findArgs;
-    findArgs << dir;
-    if (!recursive) {
-      findArgs << "-mindepth" << "1";
-      findArgs << "-maxdepth" << "1";
-    }
-    findArgs << "-type" << "f" << "-o" << "-type" << "l";
-    QProcess find;
-    find.start("find", findArgs);
-    if (!find.waitForStarted())
-        return retval;
-    if (!find.waitForFinished())
-        return retval;
-
-    QByteArray findOutput = find.readAllStandardOutput();
-    QList<QByteArray> lines = findOutput.split('\n');
-    foreach (QByteArray line, lines) {
-        if (line.isEmpty())
-            continue;
-        QString filePath(line);
-        QFileInfo fileInfo(filePath);
-        retval.append(fileInfo.canonicalFilePath());
-    }
-
-    return retval;
-}
-
-static bool makeThumbnail(const QString& filePath, Metadata& metadata)
-{
-    QFileInfo imageFileInfo(filePath);
-    QFileInfo thumbnailFileInfo(cacheDir(filePath), "thumbnail.png");
-    QSize thumbnailSize(80, 80);
-
-    metadata.insert("thumbnailFilePath", thumbnailFileInfo.absoluteFilePath());
-    metadata.insert("thumbnailImageSize", thumbnailSize);
-
-    if (thumbnailFileInfo.exists()
-        && thumbnailFileInfo.lastModified() >= imageFileInfo.lastModified()) {
-        return true;
-    }
-
-    QImage image(filePath);
-    if (!image.format()) {
-        qWarning() << filePath << " has unknown image format";
-        return false;
-    }
-
-    QImage thumbnail(thumbnailSize, QImage::Format_ARGB32);
-    thumbnail.fill(Qt::transparent);
-
-    QPainter thumbnailPainter(&thumbnail);
-    QImage smallImage(image.scaled(80, 80, Qt::KeepAspectRatio));
-    thumbnailPainter.drawImage(QPoint((80 - smallImage.width()) / 2,
-                                      (80 - smallImage.height()) / 2),
-                               smallImage);
-    if (thumbnail.isNull()) {
-        qWarning() << "failed to create a thumbnail image from "
-                   << filePath;
-        return false;
-    }
-
-    if (!thumbnail
-        .transformed(exifTransform(metadata))
-        .save(thumbnailFileInfo.filePath())) {
-        qWarning() << "failed to save the thumbnail image to "
-                   << thumbnailFileInfo.filePath();
-        return false;
-    }
-
-    return true;
-}
-
-static Metadata import(const QString& filePath)
-{
-    makeCacheDir(filePath);
-
-    Metadata metadata = getMetadata(filePath);
-    if (metadata.isEmpty()) {
-        qCritical() << "failed to parse metadata";
-        metadata.clear();
-        return metadata;
-    }
-
-    if (!makeThumbnail(filePath, metadata)) {
-        qWarning() << "failed to make a thumbnail";
-        metadata.clear();
-        return metadata;
-    }
-
-    return metadata;
+    metadata.insert("isThumbnailed", makeThumbnails(metadata));
 }
 
 MainWindow::MainWindow(QWidget *const parent)
     :QMainWindow(parent)
+    ,m_catalogService(new CatalogService(
+                          QSqlDatabase::database().databaseName()))
     ,m_importCount()
-    ,m_importer(new QFutureWatcher<Metadata>(this))
+    ,m_importResultCount(0)
+    ,m_importedImages()
+    ,m_importer(new Importer(this))
     ,m_cancelImportButton(new QPushButton(this))
     ,m_importProgressBar(new QProgressBar(this))
+    ,m_exporter(new Exporter(this))
+    ,m_cancelExportButton(new QPushButton(this))
+    ,m_exportProgressBar(new QProgressBar(this))
+    ,m_thumbnailer(new QFutureWatcher<void>(this))
+    ,m_thumbnailSizeSlider(new QSlider(Qt::Horizontal, this))
 
     ,m_imageListView(new ImageListView(this))
     ,m_imageView(new ImageView(this))
-    ,m_metadataWidget(new MetadataWidget(this))
+    ,m_metadataWidget(new MetadataWidget(m_catalogService, &m_tagIndex,
+                                         this))
+    ,m_facetWidget(new FacetWidget(&m_facetIndex, &m_tagIndex, this))
 
     ,m_metadataDockWidget(new QDockWidget(this))
+    ,m_facetDockWidget(new QDockWidget(this))
 
-    ,m_tagModel(new QSqlQueryModel(this))
-    ,m_imageModel(new QSqlTableModel(this))
+    ,m_bulkTagger(new BulkTagger(this))
+    ,m_batchRotator(new BatchRotator(this))
+    ,m_snapshot()
+    ,m_imageModel(new ImageModel(this))
+
+    ,m_sortKey(SortKeys::CaptureTimeKey)
+    ,m_sortOrder(Qt::AscendingOrder)
+    ,m_timelineWidget(new TimelineWidget(&m_timeline, this))
 
     ,m_sortActionGroup(new QActionGroup(this))
+    ,m_sortKeyActionGroup(new QActionGroup(this))
     ,m_viewModeActionGroup(new QActionGroup(this))
 
     ,m_aboutAction(new QAction(this))
     ,m_editAction(new QAction(this))
+    ,m_exportAction(new QAction(this))
     ,m_importDirAction(new QAction(this))
     ,m_quitAction(new QAction(this))
-    ,m_sortAscDateAction(new QAction(m_sortActionGroup))
-    ,m_sortDescDateAction(new QAction(m_sortActionGroup))
+    ,m_sortAscAction(new QAction(m_sortActionGroup))
+    ,m_sortDescAction(new QAction(m_sortActionGroup))
     ,m_tagAction(new QAction(this))
     ,m_rotateLeftAction(new QAction(this))
     ,m_rotateRightAction(new QAction(this))
+    ,m_rotateSelectedLeftAction(new QAction(this))
+    ,m_rotateSelectedRightAction(new QAction(this))
     ,m_zoomInAction(new QAction(this))
     ,m_zoomOutAction(new QAction(this))
     ,m_zoomToFitAction(new QAction(this))
@@ -150,8 +92,24 @@ MainWindow::MainWindow(QWidget *const parent)
     ,m_singleViewModeAction(new QAction(m_viewModeActionGroup))
     ,m_listViewModeAction(new QAction(m_viewModeActionGroup))
 
-    ,m_toolBar(new QToolBar(this))
+    ,m_findSimilarAction(new QAction(this))
+    ,m_findNearbyAction(new QAction(this))
+    ,m_findInAreaAction(new QAction(this))
+    ,m_showAllImagesAction(new QAction(this))
 
+    ,m_toolBar(new QToolBar(this))
+    ,m_tagFilterEdit(new QLineEdit(this))
+    ,m_searchEdit(new QLineEdit(this))
+    ,m_searchTimer(new QTimer(this))
+
+    ,m_pendingImports()
+    ,m_restoredImageId(-1)
+    ,m_isWindowPainted(false)
+    ,m_isGridPainted(false)
+    ,m_isCatalogLoaded(false)
+    ,m_isImporting(false)
+    ,m_isStartupFinished(false)
+    ,m_isStartupFailed(false)
 {
     setupActions();
     setupToolBars();
@@ -160,13 +118,64 @@ MainWindow::MainWindow(QWidget *const parent)
     setupStatusBar();
     setupMenus();
 
-    loadTags();
     loadSettings();
-
     connectSignals();
 
-    m_sortAscDateAction->trigger();
-    m_imageListView->setCurrentIndex(m_imageModel->index(0, 8));
+    // The catalog is loaded once the window is up, see loadCatalog().
+    m_imageListView->viewport()->installEventFilter(this);
+    QTimer::singleShot(0, this, SLOT(loadCatalog()));
+}
+
+// Loads the catalog once the window is up. The grid is filled from the
+// catalog snapshot if it is current, otherwise as soon as the sort keys
+// arrive from the catalog service. The in-memory indexes are loaded by the
+// catalog service too, see indexesReady().
+void MainWindow::loadCatalog()
+{
+    if (openSnapshot()) {
+        m_sortKeys.load(m_snapshot);
+        markStartupMilestone("sort keys loaded from snapshot");
+        sortImages();
+    } else {
+        m_catalogService->requestSortKeys();
+        m_catalogService->requestSnapshot();
+    }
+    m_catalogService->requestIndexes();
+}
+
+bool MainWindow::eventFilter(QObject* const watched, QEvent* const event)
+{
+    if (watched == m_imageListView->viewport()
+        && event->type() == QEvent::Paint && !m_isGridPainted) {
+        if (!m_isWindowPainted) {
+            m_isWindowPainted = true;
+            markStartupMilestone("first paint");
+        }
+        if (m_sortKeys.isLoaded()) {
+            m_isGridPainted = true;
+            markStartupMilestone("first grid paint");
+            m_imageListView->viewport()->removeEventFilter(this);
+            // The milestone is checked once the paint has been done.
+            QTimer::singleShot(0, this, SLOT(checkStartupFinished()));
+        }
+    }
+
+    return QMainWindow::eventFilter(watched, event);
+}
+
+bool MainWindow::isStartupFailed() const
+{
+    return m_isStartupFailed;
+}
+
+void MainWindow::checkStartupFinished()
+{
+    if (m_isStartupFinished || !m_isGridPainted || !m_isCatalogLoaded)
+        return;
+
+    m_isStartupFinished = true;
+    markStartupMilestone("startup finished");
+    emit startupFinished();
 }
 
 void MainWindow::cancelImport()
@@ -180,7 +189,106 @@ void MainWindow::cancelImport()
 MainWindow::~MainWindow()
 {
     m_importer->cancel();
+    m_exporter->cancel();
+    m_thumbnailer->cancel();
     m_importer->waitForFinished();
+    m_exporter->waitForFinished();
+    m_thumbnailer->waitForFinished();
+    delete m_catalogService;
+}
+
+static QString thumbnailLevelsToString(const QList<int>& levels)
+{
+    QStringList strings;
+    foreach (int level, levels) {
+        strings << QString::number(level);
+    }
+    return strings.join(",");
+}
+
+// Thumbnail levels are generated per library, the levels generated last
+// are recorded under a key of the library database. The default library
+// keeps the key every library shared before.
+static QString generatedLevelsKey()
+{
+    const QString databaseName(QSqlDatabase::database().databaseName());
+
+    if (databaseName == libraryFilePath(QDir::homePath()))
+        return "thumbnails/generatedLevels";
+
+    return "thumbnails/generatedLevels/"
+        + QCryptographicHash::hash(databaseName.toUtf8(),
+                                   QCryptographicHash::Md5).toHex();
+}
+
+// Generates missing thumbnail levels in the background after the
+// configured levels have changed.
+void MainWindow::regenerateThumbnails()
+{
+    // The thumbnails of a federated catalog are regenerated when its
+    // libraries are opened on their own.
+    if (isFederated())
+        return;
+
+    QSettings settings;
+    const QString levels(thumbnailLevelsToString(thumbnailLevels()));
+
+    if (settings.value(generatedLevelsKey()).toString() == levels)
+        return;
+
+    m_catalogService->requestThumbnailJobs();
+}
+
+void MainWindow::thumbnailJobsFound(const QList<Metadata>& jobs)
+{
+    m_thumbnailJobs = jobs;
+    statusBar()->showMessage("Regenerating thumbnails...");
+    m_thumbnailer->setFuture(QtConcurrent::map(m_thumbnailJobs,
+                                               updateThumbnails));
+}
+
+void MainWindow::thumbnailsRegenerated()
+{
+    if (m_thumbnailer->isCanceled()) {
+        m_thumbnailJobs.clear();
+        return;
+    }
+
+    // The catalog service handles requests in order, so the snapshot is
+    // written after the updates.
+    m_catalogService->updateThumbnails(m_thumbnailJobs);
+    foreach (const Metadata& metadata, m_thumbnailJobs) {
+        if (metadata.value("isThumbnailed").toBool()
+            && metadata.contains("perceptualHash"))
+            m_similarityIndex.insert(
+                metadata.value("id").toLongLong(),
+                quint64(metadata.value("perceptualHash").toLongLong()));
+    }
+    m_thumbnailJobs.clear();
+
+    // Thumbnail paths changed, the snapshot has the old ones.
+    m_imageModel->setSnapshot(0);
+    m_snapshot.close();
+    m_catalogService->requestSnapshot();
+}
+
+void MainWindow::thumbnailsUpdated(const bool isSuccessful)
+{
+    if (!isSuccessful) {
+        statusBar()->showMessage("Thumbnail regeneration failed", 5000);
+        return;
+    }
+
+    QSettings settings;
+    settings.setValue(generatedLevelsKey(),
+                      thumbnailLevelsToString(thumbnailLevels()));
+    statusBar()->showMessage("Thumbnails regenerated", 5000);
+    sortImages();
+}
+
+void MainWindow::setThumbnailSize(const int size)
+{
+    m_imageListView->setIconSize(QSize(size, size));
 }
 
 void MainWindow::about()
@@ -206,8 +314,7 @@ void MainWindow::importDir(QString dir, bool recursive)
     if (dir.isEmpty())
         return;
 
-    const QStringList filePaths(findFiles(dir, recursive));
-    importFiles(filePaths);
+    importPaths(QStringList(dir), recursive);
 }
 
 void MainWindow::importDir(QString dir)
@@ -226,12 +333,37 @@ void MainWindow::importDir()
 
 void MainWindow::importFiles(const QStringList& filePaths)
 {
+    importPaths(filePaths, false);
+}
+
+void MainWindow::importPaths(const QStringList& paths, bool recursive)
+{
+    if (paths.isEmpty())
+        return;
+
+    // Imports update the in-memory indexes, they wait for the indexes to
+    // be loaded, and for the running import to finish.
+    if (!m_isCatalogLoaded || m_isImporting) {
+        if (!m_pendingImports.isEmpty()
+            && m_pendingImports.last().second == recursive)
+            m_pendingImports.last().first += paths;
+        else
+            m_pendingImports.enqueue(qMakePair(paths, recursive));
+        return;
+    }
+
+    m_isImporting = true;
     m_importDirAction->setEnabled(false);
     m_importCount = 0;
+    m_importResultCount = 0;
+    m_importedImages.clear();
     QSqlDatabase::database().transaction();
-    m_importer->setFuture(QtConcurrent::mapped(filePaths, import));
+    m_importer->setCatalog(QSqlDatabase::database().databaseName());
+    m_importer->start(paths, recursive);
+    // Directories are walked while importing, the number of files is
+    // known only at the end.
     m_importProgressBar->reset();
-    m_importProgressBar->setRange(0, filePaths.size());
+    m_importProgressBar->setRange(0, 0);
     statusBar()->addPermanentWidget(m_importProgressBar);
     m_importProgressBar->show();
     statusBar()->addPermanentWidget(m_cancelImportButton);
@@ -239,59 +371,221 @@ void MainWindow::importFiles(const QStringList& filePaths)
     statusBar()->showMessage(QString("Importing images..."));
 }
 
-void MainWindow::importPaths(const QStringList& paths, bool recursive)
+void MainWindow::setImportIoOrder(const IoOrder order)
 {
-    QStringList filePaths;
+    m_importer->setIoOrder(order);
+}
 
-    foreach (QString path, paths) {
-        QFileInfo fileInfo(path);
-        if (fileInfo.isDir()) {
-            filePaths.append(findFiles(path, recursive));
-        } else {
-            filePaths.append(path);
-        }
+void MainWindow::setImportReadMode(const ReadMode mode)
+{
+    m_importer->setReadMode(mode);
+}
+
+void MainWindow::importResultsAvailable()
+{
+    Metadata metadata;
+
+    while (m_importer->takeResult(metadata)) {
+        ++m_importResultCount;
+        writeImported(metadata);
     }
-    if (!filePaths.isEmpty())
-        importFiles(filePaths);
+    // The bar stays busy until the total is known, the probe pass is
+    // followed by a full pass over the same files.
+    if (m_importer->isWalkFinished()) {
+        m_importProgressBar->setRange(0, m_importer->fileCount());
+        m_importProgressBar->setValue(m_importResultCount);
+    }
+    m_importProgressBar->setToolTip(m_importer->queueStatus());
+    // Thumbnails of probed images appear as the full pass makes them.
+    m_imageListView->viewport()->update();
 }
 
-void MainWindow::importReadyAt(const int i)
+static const int importCommitInterval = 1000;
+// SQLITE_CONSTRAINT, the file path is unique.
+static const int sqliteConstraintError = 19;
+
+void MainWindow::writeImported(const Metadata& metadata)
 {
-    m_importProgressBar->setValue(m_importProgressBar->value() + 1);
-    Metadata metadata = m_importer->resultAt(i);
     if (metadata.isEmpty())
         return;
 
-    QString filePath = metadata.value("filePath").toString();
+    // Catalogued images come with their id, images inserted by this import
+    // are not visible to the importer until committed.
+    const QString filePath(metadata.value("filePath").toString());
+    if (metadata.contains("id")) {
+        updateImported(metadata.value("id").toLongLong(),
+                       metadata.value("catalogTimestamp").toDateTime().date(),
+                       metadata);
+        return;
+    }
+    if (m_importedImages.contains(filePath)) {
+        const QPair<qint64, QDate> image(m_importedImages.take(filePath));
+        updateImported(image.first, image.second, metadata);
+        return;
+    }
 
-    QSqlRecord record(m_imageModel->record());
-    record.setValue(1, metadata.value("filePath"));
-    record.setValue(2, metadata.value("fileSize"));
-    record.setValue(3, metadata.value("modificationTime"));
+    QSqlQuery query;
+    query.prepare("INSERT INTO Image(file_path, file_size, mtime,"
+                  " pixel_width, pixel_height, exif_datetime,"
+                  " exif_orientation, thumbnail_file_path,"
+                  " thumbnail_pixel_width, thumbnail_pixel_height, phash,"
+                  " camera_make, camera_model, lens_model, focal_length,"
+                  " iso_speed, exposure_time, latitude, longitude,"
+                  " metadata_version)"
+                  " VALUES(?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?,"
+                  "        ?, ?, ?, ?, ?, ?, ?, ?, ?)");
+    query.addBindValue(metadata.value("filePath"));
+    query.addBindValue(metadata.value("fileSize"));
+    query.addBindValue(metadata.value("modificationTime"));
     QSize imageSize = metadata.value("imageSize").toSize();
-    record.setValue(4, imageSize.width());
-    record.setValue(5, imageSize.height());
-    record.setValue(6, metadata.value("timestamp"));
-    record.setValue(7, metadata.value("orientation"));
-    record.setValue(8, metadata.value("thumbnailFilePath"));
+    query.addBindValue(imageSize.width());
+    query.addBindValue(imageSize.height());
+    query.addBindValue(metadata.value("timestamp"));
+    query.addBindValue(metadata.value("orientation"));
+    query.addBindValue(metadata.value("thumbnailFilePath"));
     QSize thumbnailSize = metadata.value("thumbnailImageSize").toSize();
-    record.setValue(9, thumbnailSize.width());
-    record.setValue(10, thumbnailSize.height());
-    m_imageModel->insertRecord(-1, record);
-    if (m_imageModel->submitAll())
-        m_importCount.fetchAndAddOrdered(1);
+    query.addBindValue(thumbnailSize.width());
+    query.addBindValue(thumbnailSize.height());
+    query.addBindValue(metadata.value("perceptualHash"));
+    query.addBindValue(metadata.value("cameraMake"));
+    query.addBindValue(metadata.value("cameraModel"));
+    query.addBindValue(metadata.value("lensModel"));
+    query.addBindValue(metadata.value("focalLength"));
+    query.addBindValue(metadata.value("isoSpeed"));
+    query.addBindValue(metadata.value("exposureTime"));
+    query.addBindValue(metadata.value("latitude"));
+    query.addBindValue(metadata.value("longitude"));
+    // Probed images are recorded as if an older version had catalogued
+    // them, so that the full pass, or the next import if it is canceled,
+    // fills in what the probe did not parse.
+    query.addBindValue(metadata.value("isProbed").toBool()
+                       ? 0 : metadataVersion);
+    if (!query.exec()) {
+        if (query.lastError().number() != sqliteConstraintError) {
+            qWarning() << "failed to insert image:"
+                       << query.lastError().databaseText();
+            return;
+        }
+        // The importer could not look up the file, it is in the catalog
+        // already.
+        query.prepare("SELECT id, exif_datetime FROM Image"
+                      "  WHERE file_path = ?");
+        query.addBindValue(filePath);
+        if (query.exec() && query.next()) {
+            updateImported(query.value(0).toLongLong(),
+                           query.value(1).toDateTime().date(), metadata);
+        }
+        return;
+    }
+
+    const qint64 id = query.lastInsertId().toLongLong();
+    const QDate date(metadata.value("timestamp").toDateTime().date());
+    m_importedImages.insert(filePath, qMakePair(id, date));
+
+    // Committing now and then keeps the size of the pending transaction
+    // independent of the number of imported files. Committed images are
+    // visible to the importer, which looks them up itself.
+    const int importCount = m_importCount.fetchAndAddOrdered(1) + 1;
+    if (importCount % importCommitInterval == 0) {
+        QSqlDatabase::database().commit();
+        QSqlDatabase::database().transaction();
+        m_importedImages.clear();
+    }
+    updateSearchText(id);
+    if (metadata.contains("latitude"))
+        updateLocation(id);
+    m_imageModel->appendImage(id);
+    m_tagIndex.addImage(id);
+    m_sortKeys.append(id, metadata.value("timestamp").toDateTime(),
+                      metadata.value("modificationTime").toDateTime(),
+                      metadata.value("fileSize").toLongLong(), imageSize);
+    m_timeline.add(metadata.value("timestamp").toDateTime().date());
+    m_facetIndex.setImage(id, metadata.value("cameraMake").toString(),
+                          metadata.value("cameraModel").toString(),
+                          metadata.value("lensModel").toString(),
+                          metadata.value("timestamp").toDateTime());
+
+    if (metadata.contains("perceptualHash"))
+        m_similarityIndex.insert(
+            id, quint64(metadata.value("perceptualHash").toLongLong()));
+}
+
+// Fills in the fields an older metadata version, or a probe, did not
+// extract for an image which is already in the catalog. Importing the file
+// again did not regenerate its thumbnails unless they were stale.
+void MainWindow::updateImported(const qint64 id, const QDate& oldDate,
+                                const Metadata& metadata)
+{
+    QSqlQuery query;
+    query.prepare("UPDATE Image SET exif_datetime = ?,"
+                  "  camera_make = ?, camera_model = ?, lens_model = ?,"
+                  "  focal_length = ?, iso_speed = ?, exposure_time = ?,"
+                  "  latitude = ?, longitude = ?, metadata_version = ?,"
+                  "  phash = COALESCE(?, phash)"
+                  "  WHERE id = ?");
+    query.addBindValue(metadata.value("timestamp"));
+    query.addBindValue(metadata.value("cameraMake"));
+    query.addBindValue(metadata.value("cameraModel"));
+    query.addBindValue(metadata.value("lensModel"));
+    query.addBindValue(metadata.value("focalLength"));
+    query.addBindValue(metadata.value("isoSpeed"));
+    query.addBindValue(metadata.value("exposureTime"));
+    query.addBindValue(metadata.value("latitude"));
+    query.addBindValue(metadata.value("longitude"));
+    query.addBindValue(metadata.value("isProbed").toBool()
+                       ? 0 : metadataVersion);
+    query.addBindValue(metadata.value("perceptualHash"));
+    query.addBindValue(id);
+    if (!query.exec()) {
+        qWarning() << "failed to update image metadata:"
+                   << query.lastError().databaseText();
+        return;
+    }
+
+    updateSearchText(id);
+    updateLocation(id);
+    m_timeline.add(oldDate, -1);
+    m_timeline.add(metadata.value("timestamp").toDateTime().date());
+    m_facetIndex.setImage(id, metadata.value("cameraMake").toString(),
+                          metadata.value("cameraModel").toString(),
+                          metadata.value("lensModel").toString(),
+                          metadata.value("timestamp").toDateTime());
+    if (metadata.contains("perceptualHash"))
+        m_similarityIndex.insert(
+            id, quint64(metadata.value("perceptualHash").toLongLong()));
 }
 
 void MainWindow::importFinished()
 {
+    importResultsAvailable();
     QSqlDatabase::database().commit();
+    m_importedImages.clear();
+    m_isImporting = false;
     QString msg = QString("Imported %1 images").arg(m_importCount);
     statusBar()->removeWidget(m_importProgressBar);
     statusBar()->removeWidget(m_cancelImportButton);
     statusBar()->showMessage(msg, 5000);
     m_importDirAction->setEnabled(true);
-    m_sortAscDateAction->trigger();
-    m_imageListView->setCurrentIndex(m_imageModel->index(0, 8));
+    m_timelineWidget->update();
+    m_facetWidget->reload();
+    if (m_filters.contains("facets"))
+        filterByFacets();
+    // Images imported meanwhile sort last by path until the keys are
+    // reloaded.
+    m_catalogService->requestSortKeys();
+    m_catalogService->requestSnapshot();
+
+    runPendingImport();
+}
+
+// The rest of the pending imports run one by one as each finishes.
+void MainWindow::runPendingImport()
+{
+    if (m_pendingImports.isEmpty())
+        return;
+
+    const QPair<QStringList, bool> pending(m_pendingImports.dequeue());
+    importPaths(pending.first, pending.second);
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -303,86 +597,673 @@ void MainWindow::closeEvent(QCloseEvent *event)
 
 void MainWindow::tagSelectedImages()
 {
-    QStringList tags;
-    for (int i = 0; i < m_tagModel->rowCount(); ++i) {
-        tags << m_tagModel->record(i).value(0).toString();
+    if (m_bulkTagger->isRunning())
+        return;
+
+    const Bitmap ids(m_imageModel->imageIds(
+                         m_imageListView->selectionModel()->selection()));
+    if (ids.isEmpty())
+        return;
+
+    TagDialog dialog(&m_tagIndex, this);
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+    const QString tag(dialog.tag());
+    if (tag.isEmpty())
+        return;
+
+    m_tagAction->setEnabled(false);
+    m_bulkTagger->start(ids, tag);
+    statusBar()->showMessage(QString("Tagging %1 images...")
+                             .arg(ids.count()));
+}
+
+void MainWindow::taggingProgressChanged(const int value, const int maximum)
+{
+    statusBar()->showMessage(QString("Tagging images... %1%")
+                             .arg(100 * qint64(value) / qMax(1, maximum)));
+}
+
+void MainWindow::taggingFinished(const bool isSuccessful)
+{
+    m_tagAction->setEnabled(true);
+
+    if (!isSuccessful) {
+        statusBar()->showMessage("Failed to tag images", 5000);
+        return;
     }
-    QString tag = QInputDialog::getItem(this, "Add tag to selected images",
-                                        "Tag", tags);
 
-    QItemSelectionModel *selectionModel = m_imageListView->selectionModel();
-    QModelIndexList selectedIndexes = selectionModel->selectedIndexes();
+    m_tagIndex.addTag(m_bulkTagger->ids(), m_bulkTagger->tag());
+    m_metadataWidget->updateTags();
+    m_facetWidget->reload();
+    if (m_filters.contains("facets"))
+        filterByFacets();
+    if (m_filters.contains("tags"))
+        filterByTags();
+    if (m_filters.contains("search"))
+        search();
+    statusBar()->showMessage(QString("Tagged %1 images")
+                             .arg(m_bulkTagger->ids().count()), 5000);
+}
+
+void MainWindow::rotateSelectedImagesLeft()
+{
+    rotateSelectedImages(BatchRotator::Counterclockwise);
+}
+
+void MainWindow::rotateSelectedImagesRight()
+{
+    rotateSelectedImages(BatchRotator::Clockwise);
+}
+
+// Rotates the selected images, or the current image if none is selected,
+// by rewriting their orientation. The images themselves are not decoded.
+void MainWindow::rotateSelectedImages(
+    const BatchRotator::Direction direction)
+{
+    if (m_batchRotator->isRunning())
+        return;
 
-    QSqlDatabase db = QSqlDatabase::database();
-    db.transaction();
+    Bitmap ids(m_imageModel->imageIds(
+                   m_imageListView->selectionModel()->selection()));
+    if (ids.isEmpty()) {
+        const QModelIndex currentIndex(m_imageListView->currentIndex());
+        if (!currentIndex.isValid())
+            return;
+        ids.add(quint32(m_imageModel->imageId(currentIndex.row())));
+    }
 
-    foreach (QModelIndex index, selectedIndexes) {
-        QString filePath = index.sibling(index.row(), 1).data().toString();
-        QSqlQuery query;
-        if (!query.prepare("INSERT INTO Tagging(file_path, tag) VALUES(?, ?)"))
+    m_rotateSelectedLeftAction->setEnabled(false);
+    m_rotateSelectedRightAction->setEnabled(false);
+    m_batchRotator->start(ids, direction);
+    statusBar()->showMessage(QString("Rotating %1 images...")
+                             .arg(ids.count()));
+}
+
+void MainWindow::rotatingProgressChanged(const int value, const int maximum)
+{
+    statusBar()->showMessage(QString("Rotating images... %1%")
+                             .arg(100 * qint64(value) / qMax(1, maximum)));
+}
+
+void MainWindow::rotatingFinished(const bool isSuccessful)
+{
+    m_rotateSelectedLeftAction->setEnabled(true);
+    m_rotateSelectedRightAction->setEnabled(true);
+
+    // Files may have been rotated even if the catalog was not updated, so
+    // their pixmaps are dropped either way.
+    const QList<int> levels(thumbnailLevels());
+    int rotatedCount = 0;
+    foreach (const BatchRotator::Rotation& rotation,
+             m_batchRotator->rotations()) {
+        if (!rotation.isRotated)
             continue;
 
-        query.addBindValue(filePath);
-        query.addBindValue(tag);
+        ++rotatedCount;
+        QPixmapCache::remove(rotation.filePath);
+        foreach (int level, levels) {
+            QPixmapCache::remove(thumbnailFilePath(rotation.filePath, level));
+        }
+        if (isSuccessful && rotation.hasHash)
+            m_similarityIndex.insert(rotation.id, rotation.hash);
+    }
+
+    // Rotating changed the catalog generation, the snapshot is written
+    // again and cached rows are read from the database meanwhile.
+    m_imageModel->setSnapshot(0);
+    m_snapshot.close();
+    m_catalogService->requestSortKeys();
+    m_catalogService->requestSnapshot();
+
+    const QModelIndex currentIndex(m_imageListView->currentIndex());
+    m_imageView->setImage(currentIndex);
+    m_metadataWidget->setMetadata(currentIndex);
 
-        query.exec();
+    if (!isSuccessful) {
+        statusBar()->showMessage("Failed to rotate images", 5000);
+        return;
     }
 
-    db.commit();
-    loadTags();
+    if (m_batchRotator->failedCount() > 0)
+        statusBar()->showMessage(QString("Rotated %1 images, %2 failed")
+                                 .arg(rotatedCount)
+                                 .arg(m_batchRotator->failedCount()), 5000);
+    else
+        statusBar()->showMessage(QString("Rotated %1 images")
+                                 .arg(rotatedCount), 5000);
 }
 
-void MainWindow::loadTags()
+void MainWindow::tagRemoved(const qint64 id, const QString& tag)
 {
-    QSqlQuery query;
-    query.exec("SELECT DISTINCT(tag) FROM Tagging ORDER BY tag;");
-    m_tagModel->setQuery(query);
+    m_tagIndex.removeTag(id, tag);
+    m_metadataWidget->updateTags();
+    m_facetWidget->reload();
+    if (m_filters.contains("facets"))
+        filterByFacets();
+    if (m_filters.contains("tags"))
+        filterByTags();
+    if (m_filters.contains("search"))
+        search();
 }
 
-void MainWindow::sortAscDate()
+void MainWindow::search()
 {
-    m_imageModel->sort(6, Qt::AscendingOrder);
+    if (m_searchEdit->text().trimmed().isEmpty()) {
+        m_filters.remove("search");
+        applyFilters();
+        return;
+    }
+
+    m_catalogService->requestSearch(m_searchEdit->text());
 }
 
-void MainWindow::sortDescDate()
+void MainWindow::searchFinished(const QString& text, const Bitmap& imageIds,
+                                const bool isSuccessful)
 {
-    m_imageModel->sort(6, Qt::DescendingOrder);
+    // The text has been edited again while the search was running.
+    if (text != m_searchEdit->text())
+        return;
+
+    if (!isSuccessful) {
+        statusBar()->showMessage("Search failed", 5000);
+        return;
+    }
+
+    m_filters.insert("search", imageIds);
+    applyFilters();
 }
 
-void MainWindow::editSelectedImages()
+void MainWindow::filterByFacets()
+{
+    if (m_facetWidget->isFiltered())
+        m_filters.insert("facets", m_facetWidget->filter());
+    else
+        m_filters.remove("facets");
+    applyFilters();
+}
+
+void MainWindow::filterByTags()
 {
-    QModelIndex currentIndex = m_imageListView->currentIndex();
-    QItemSelectionModel *selectionModel = m_imageListView->selectionModel();
-    QModelIndexList selectedIndexes = selectionModel->selectedIndexes();
-    QStringList filePaths;
+    const QString query(m_tagFilterEdit->text().trimmed());
+
+    if (query.isEmpty()) {
+        m_filters.remove("tags");
+        applyFilters();
+        return;
+    }
+
+    Bitmap filter;
+    QString errorString;
+    if (!m_tagIndex.evaluate(query, &filter, &errorString)) {
+        statusBar()->showMessage(QString("Invalid tag query: %1")
+                                 .arg(errorString), 5000);
+        return;
+    }
 
-    foreach (QModelIndex index, selectedIndexes) {
-        QString filePath = index.sibling(index.row(), 1).data().toString();
-        filePaths.append(filePath);
+    m_filters.insert("tags", filter);
+    applyFilters();
+    statusBar()->showMessage(QString("%1 images match the tag query")
+                             .arg(filter.count()), 5000);
+}
+
+// Shows only the images passing every active filter. The current image
+// stays current if it passes, otherwise the first image becomes current.
+// Facet counts are given within the images the other filters pass.
+void MainWindow::applyFilters()
+{
+    const qint64 currentId = m_imageModel->imageId(
+        m_imageListView->currentIndex().row());
+
+    Bitmap filter;
+    bool isFiltered = false;
+    QMap<QString, Bitmap>::const_iterator i = m_filters.constBegin();
+    for (; i != m_filters.constEnd(); ++i) {
+        if (i.key() == "facets")
+            continue;
+        if (isFiltered)
+            filter &= i.value();
+        else
+            filter = i.value();
+        isFiltered = true;
+    }
+    m_facetWidget->setScope(isFiltered ? &filter : 0);
+
+    if (m_filters.contains("facets")) {
+        if (isFiltered)
+            filter &= m_filters.value("facets");
+        else
+            filter = m_filters.value("facets");
+        isFiltered = true;
     }
 
+    if (isFiltered)
+        m_imageModel->setFilter(filter);
+    else
+        m_imageModel->clearFilter();
+    m_showAllImagesAction->setEnabled(!m_filters.isEmpty());
+
+    const int row = qMax(0, m_imageModel->row(currentId));
+    m_imageListView->setCurrentIndex(m_imageModel->index(row, 8));
+}
+
+void MainWindow::findSimilarImages()
+{
+    const QModelIndex currentIndex = m_imageListView->currentIndex();
+    if (!currentIndex.isValid())
+        return;
+
+    const qint64 id = m_imageModel->imageId(currentIndex.row());
+    if (!m_similarityIndex.contains(id)) {
+        statusBar()->showMessage("The image does not have a thumbnail", 5000);
+        return;
+    }
+
+    QSettings settings;
+    const int radius = settings.value("similarity/radius", 10).toInt();
+    const QList<qint64> ids = m_similarityIndex.find(
+        m_similarityIndex.hash(id), radius);
+
+    Bitmap filter;
+    foreach (qint64 similarId, ids) {
+        filter.add(quint32(similarId));
+    }
+    m_filters.insert("similar", filter);
+    applyFilters();
+    statusBar()->showMessage(QString("Found %1 similar images")
+                             .arg(ids.size() - 1), 5000);
+}
+
+void MainWindow::findNearbyImages()
+{
+    const QModelIndex currentIndex = m_imageListView->currentIndex();
+    if (!currentIndex.isValid())
+        return;
+
+    QSettings settings;
+    const double radius = settings.value("location/radius", 5000).toDouble();
+    m_catalogService->requestNearbyImages(
+        m_imageModel->imageId(currentIndex.row()), radius);
+}
+
+void MainWindow::nearbyImagesFound(const Bitmap& imageIds,
+                                   const double radius)
+{
+    m_filters.insert("location", imageIds);
+    applyFilters();
+    statusBar()->showMessage(QString("Found %1 images within %2 km")
+                             .arg(imageIds.count() - 1)
+                             .arg(radius / 1000.0), 5000);
+}
+
+// The area is given as the latitudes and longitudes of its south-west and
+// north-east corners in degrees.
+void MainWindow::findImagesInArea()
+{
+    bool isAccepted;
+    const QString text(QInputDialog::getText(
+                           this, "Find images in area",
+                           "South, west, north, east", QLineEdit::Normal,
+                           QString(), &isAccepted));
+    if (!isAccepted)
+        return;
+
+    const QStringList fields(text.split(',', QString::SkipEmptyParts));
+    double bounds[4];
+    bool isValid = fields.size() == 4;
+    for (int i = 0; isValid && i < 4; ++i)
+        bounds[i] = fields[i].trimmed().toDouble(&isValid);
+    if (!isValid || bounds[0] > bounds[2]) {
+        statusBar()->showMessage("Invalid area", 5000);
+        return;
+    }
+
+    m_catalogService->requestImagesInBox(bounds[0], bounds[1], bounds[2],
+                                         bounds[3]);
+}
+
+void MainWindow::imagesInBoxFound(const Bitmap& imageIds)
+{
+    m_filters.insert("location", imageIds);
+    applyFilters();
+    statusBar()->showMessage(QString("Found %1 images in the area")
+                             .arg(imageIds.count()), 5000);
+}
+
+void MainWindow::locationSearchFailed(const QString& message)
+{
+    statusBar()->showMessage(message, 5000);
+}
+
+void MainWindow::showAllImages()
+{
+    m_filters.clear();
+    m_facetWidget->clearFilter();
+    m_tagFilterEdit->clear();
+    m_searchEdit->clear();
+    m_searchTimer->stop();
+    applyFilters();
+}
+
+// The timeline answers directly when the grid shows the whole catalog in
+// capture time order, otherwise the model is binary searched.
+void MainWindow::jumpToDate(const QDate& date)
+{
+    if (m_imageModel->sortColumn() != 6 || m_imageModel->rowCount() == 0)
+        return;
+
+    int row;
+    if (m_imageModel->isFiltered()
+        || m_timeline.total() != m_imageModel->rowCount()) {
+        row = m_imageModel->rowForDate(date);
+    } else if (m_imageModel->sortOrder() == Qt::AscendingOrder) {
+        row = m_timeline.countBefore(date);
+    } else {
+        row = m_timeline.total() - m_timeline.countBefore(date.addDays(1));
+    }
+    row = qMin(row, m_imageModel->rowCount() - 1);
+
+    const QModelIndex index(m_imageModel->index(row, 8));
+    m_imageListView->setCurrentIndex(index);
+    m_imageListView->scrollTo(index, QAbstractItemView::PositionAtTop);
+}
+
+void MainWindow::sortAscending()
+{
+    m_sortOrder = Qt::AscendingOrder;
+    sortImages();
+}
+
+void MainWindow::sortDescending()
+{
+    m_sortOrder = Qt::DescendingOrder;
+    sortImages();
+}
+
+void MainWindow::sortByKey(QAction* const action)
+{
+    m_sortKey = SortKeys::Key(action->data().toInt());
+    sortImages();
+}
+
+void MainWindow::sortKeysReady(const SortKeys& sortKeys)
+{
+    if (!m_sortKeys.isLoaded())
+        markStartupMilestone("sort keys loaded");
+
+    m_sortKeys = sortKeys;
+    sortImages();
+}
+
+// Without sort keys there is no grid to paint, startup finishes with the
+// grid empty.
+void MainWindow::sortKeysFailed()
+{
+    statusBar()->showMessage("Failed to load the catalog", 5000);
+    if (m_isGridPainted || m_sortKeys.isLoaded())
+        return;
+
+    m_isGridPainted = true;
+    m_isStartupFailed = true;
+    markStartupMilestone("sort keys failed");
+    m_imageListView->viewport()->removeEventFilter(this);
+    checkStartupFinished();
+}
+
+// Actions which update the indexes stay disabled until the indexes have
+// arrived, otherwise the updates would be overwritten.
+void MainWindow::indexesReady(const TagIndex& tagIndex,
+                              const FacetIndex& facetIndex,
+                              const Timeline& timeline,
+                              const SimilarityIndex& similarityIndex)
+{
+    m_tagIndex = tagIndex;
+    m_facetIndex = facetIndex;
+    m_facetWidget->reload();
+    m_timeline = timeline;
+    m_timelineWidget->update();
+    m_similarityIndex = similarityIndex;
+
+    regenerateThumbnails();
+    m_isCatalogLoaded = true;
+    markStartupMilestone("catalog indexes loaded");
+
+    if (!isFederated()) {
+        m_importDirAction->setEnabled(true);
+        m_tagAction->setEnabled(true);
+        m_rotateSelectedLeftAction->setEnabled(true);
+        m_rotateSelectedRightAction->setEnabled(true);
+    }
+    runPendingImport();
+    // Rows an older metadata version catalogued are filled in by
+    // importing their files again.
+    if (!isFederated())
+        m_catalogService->requestOutdatedImages();
+
+    checkStartupFinished();
+}
+
+void MainWindow::snapshotWritten()
+{
+    openSnapshot();
+}
+
+void MainWindow::outdatedImagesFound(const QStringList& filePaths)
+{
+    importPaths(filePaths, false);
+}
+
+// Maps the catalog snapshot for the image model if the snapshot is of the
+// current catalog generation.
+bool MainWindow::openSnapshot()
+{
+    const QSqlDatabase db(QSqlDatabase::database());
+
+    m_imageModel->setSnapshot(0);
+    if (!m_snapshot.open(CatalogSnapshot::filePath(db.databaseName()),
+                         CatalogSnapshot::generation(db)))
+        return false;
+    m_imageModel->setSnapshot(&m_snapshot);
+
+    return true;
+}
+
+// Sorts the grid in memory by the chosen key, ties broken by capture time
+// and then by path. The current image stays current if it is still there,
+// otherwise the first image becomes current.
+void MainWindow::sortImages()
+{
+    if (!m_sortKeys.isLoaded())
+        return;
+
+    QList<SortKeys::Criterion> criteria;
+    criteria << SortKeys::Criterion(m_sortKey, m_sortOrder);
+    if (m_sortKey != SortKeys::CaptureTimeKey)
+        criteria << SortKeys::Criterion(SortKeys::CaptureTimeKey);
+    if (m_sortKey != SortKeys::PathKey)
+        criteria << SortKeys::Criterion(SortKeys::PathKey);
+
+    // The first sort restores the image which was current when the
+    // application was last closed, so only the rows around it are fetched.
+    const QModelIndex currentIndex(m_imageListView->currentIndex());
+    const qint64 currentId = currentIndex.isValid()
+        ? m_imageModel->imageId(currentIndex.row()) : m_restoredImageId;
+
+    m_imageModel->setSortedIds(SortKeys::column(m_sortKey), m_sortOrder,
+                               m_sortKeys.sorted(criteria));
+
+    const int row = qMax(0, m_imageModel->row(currentId));
+    const QModelIndex index(m_imageModel->index(row, 8));
+    m_imageListView->setCurrentIndex(index);
+    m_imageListView->scrollTo(index, currentIndex.isValid()
+                              ? QAbstractItemView::EnsureVisible
+                              : QAbstractItemView::PositionAtCenter);
+}
+
+void MainWindow::editSelectedImages()
+{
+    m_catalogService->requestFilePaths(
+        m_imageModel->imageIds(
+            m_imageListView->selectionModel()->selection()));
+}
+
+void MainWindow::startEditor(const QStringList& filePaths)
+{
     if (QProcess::startDetached("gimp", filePaths))
         statusBar()->showMessage("Started an external editor...", 5000);
     else
         statusBar()->showMessage("Failed to start an external editor...", 5000);
 }
 
+// Exports the selected images, or every image shown if none is selected,
+// so that the images found by a tag query or a search can be exported at
+// once.
+void MainWindow::exportImages()
+{
+    if (m_exporter->isRunning())
+        return;
+
+    // Images are numbered in the order they are shown in.
+    const QItemSelection selection(
+        m_imageListView->selectionModel()->selection());
+    const QList<qint64> ids(m_imageModel->orderedImageIds(selection));
+    if (ids.isEmpty())
+        return;
+
+    ExportDialog dialog(m_exporter, ids.size(), this);
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+
+    m_exportAction->setEnabled(false);
+    m_exporter->start(ids);
+    m_exportProgressBar->reset();
+    m_exportProgressBar->setRange(0, m_exporter->imageCount());
+    statusBar()->addPermanentWidget(m_exportProgressBar);
+    m_exportProgressBar->show();
+    statusBar()->addPermanentWidget(m_cancelExportButton);
+    m_cancelExportButton->show();
+    statusBar()->showMessage(QString("Exporting %1 images...")
+                             .arg(m_exporter->imageCount()));
+}
+
+void MainWindow::exportProgressChanged(const int value, const int maximum)
+{
+    m_exportProgressBar->setMaximum(maximum);
+    m_exportProgressBar->setValue(value);
+}
+
+void MainWindow::exportFinished()
+{
+    statusBar()->removeWidget(m_exportProgressBar);
+    statusBar()->removeWidget(m_cancelExportButton);
+    m_exportAction->setEnabled(true);
+
+    if (m_exporter->isCanceled()) {
+        statusBar()->showMessage("Export canceled", 5000);
+        return;
+    }
+
+    const int failedCount = m_exporter->failedCount();
+    QString message(QString("Exported %1 images to %2")
+                    .arg(m_exporter->imageCount() - failedCount)
+                    .arg(m_exporter->targetDirectory()));
+    if (failedCount)
+        message += QString(", %1 failed").arg(failedCount);
+    statusBar()->showMessage(message, 5000);
+}
+
+void MainWindow::cancelExport()
+{
+    statusBar()->removeWidget(m_exportProgressBar);
+    statusBar()->removeWidget(m_cancelExportButton);
+    statusBar()->showMessage("Canceling export...");
+    m_exporter->cancel();
+}
 
 void MainWindow::connectSignals()
 {
-    connect(m_sortAscDateAction, SIGNAL(triggered(bool)),
-            SLOT(sortAscDate()));
-    connect(m_sortDescDateAction, SIGNAL(triggered(bool)),
-            SLOT(sortDescDate()));
+    connect(m_sortAscAction, SIGNAL(triggered(bool)),
+            SLOT(sortAscending()));
+    connect(m_sortDescAction, SIGNAL(triggered(bool)),
+            SLOT(sortDescending()));
     connect(m_editAction, SIGNAL(triggered(bool)),
             SLOT(editSelectedImages()));
+    connect(m_exportAction, SIGNAL(triggered(bool)),
+            SLOT(exportImages()));
+    connect(m_exporter, SIGNAL(progressChanged(int, int)),
+            SLOT(exportProgressChanged(int, int)));
+    connect(m_exporter, SIGNAL(finished()),
+            SLOT(exportFinished()));
+    connect(m_cancelExportButton, SIGNAL(clicked()),
+            SLOT(cancelExport()));
     connect(m_tagAction, SIGNAL(triggered(bool)),
             SLOT(tagSelectedImages()));
+    connect(m_bulkTagger, SIGNAL(progressChanged(int, int)),
+            SLOT(taggingProgressChanged(int, int)));
+    connect(m_bulkTagger, SIGNAL(finished(bool)),
+            SLOT(taggingFinished(bool)));
+    connect(m_batchRotator, SIGNAL(progressChanged(int, int)),
+            SLOT(rotatingProgressChanged(int, int)));
+    connect(m_batchRotator, SIGNAL(finished(bool)),
+            SLOT(rotatingFinished(bool)));
+    connect(m_catalogService, SIGNAL(sortKeysReady(const SortKeys&)),
+            SLOT(sortKeysReady(const SortKeys&)));
+    connect(m_catalogService, SIGNAL(sortKeysFailed()),
+            SLOT(sortKeysFailed()));
+    connect(m_catalogService,
+            SIGNAL(indexesReady(const TagIndex&, const FacetIndex&,
+                                const Timeline&, const SimilarityIndex&)),
+            SLOT(indexesReady(const TagIndex&, const FacetIndex&,
+                              const Timeline&, const SimilarityIndex&)));
+    connect(m_catalogService, SIGNAL(snapshotWritten()),
+            SLOT(snapshotWritten()));
+    connect(m_catalogService,
+            SIGNAL(outdatedImagesFound(const QStringList&)),
+            SLOT(outdatedImagesFound(const QStringList&)));
+    connect(m_catalogService,
+            SIGNAL(nearbyImagesFound(const Bitmap&, double)),
+            SLOT(nearbyImagesFound(const Bitmap&, double)));
+    connect(m_catalogService, SIGNAL(imagesInBoxFound(const Bitmap&)),
+            SLOT(imagesInBoxFound(const Bitmap&)));
+    connect(m_catalogService, SIGNAL(locationSearchFailed(const QString&)),
+            SLOT(locationSearchFailed(const QString&)));
+    connect(m_catalogService, SIGNAL(filePathsFound(const QStringList&)),
+            SLOT(startEditor(const QStringList&)));
+    connect(m_catalogService,
+            SIGNAL(searchFinished(const QString&, const Bitmap&, bool)),
+            SLOT(searchFinished(const QString&, const Bitmap&, bool)));
+    connect(m_catalogService,
+            SIGNAL(thumbnailJobsFound(const QList<Metadata>&)),
+            SLOT(thumbnailJobsFound(const QList<Metadata>&)));
+    connect(m_catalogService, SIGNAL(thumbnailsUpdated(bool)),
+            SLOT(thumbnailsUpdated(bool)));
+    connect(m_sortKeyActionGroup, SIGNAL(triggered(QAction*)),
+            SLOT(sortByKey(QAction*)));
+    connect(m_findSimilarAction, SIGNAL(triggered(bool)),
+            SLOT(findSimilarImages()));
+    connect(m_findNearbyAction, SIGNAL(triggered(bool)),
+            SLOT(findNearbyImages()));
+    connect(m_findInAreaAction, SIGNAL(triggered(bool)),
+            SLOT(findImagesInArea()));
+    connect(m_showAllImagesAction, SIGNAL(triggered(bool)),
+            SLOT(showAllImages()));
+    connect(m_tagFilterEdit, SIGNAL(returnPressed()),
+            SLOT(filterByTags()));
+    connect(m_facetWidget, SIGNAL(filterChanged()),
+            SLOT(filterByFacets()));
+    m_searchTimer->connect(m_searchEdit, SIGNAL(textChanged(const QString&)),
+                           SLOT(start()));
+    connect(m_searchTimer, SIGNAL(timeout()),
+            SLOT(search()));
+    connect(m_timelineWidget, SIGNAL(dateActivated(const QDate&)),
+            SLOT(jumpToDate(const QDate&)));
+    connect(m_metadataWidget, SIGNAL(tagRemoved(qint64, const QString&)),
+            SLOT(tagRemoved(qint64, const QString&)));
 
     connect(m_importer, SIGNAL(finished()),
             SLOT(importFinished()));
-    connect(m_importer, SIGNAL(resultReadyAt(int)),
-            SLOT(importReadyAt(int)));
+    connect(m_importer, SIGNAL(resultsAvailable()),
+            SLOT(importResultsAvailable()));
     connect(m_importDirAction, SIGNAL(triggered(bool)),
             SLOT(importDir()));
     connect(m_quitAction, SIGNAL(triggered(bool)),
@@ -402,6 +1283,10 @@ void MainWindow::connectSignals()
     connect(m_aboutAction, SIGNAL(triggered(bool)), SLOT(about()));
     connect(m_cancelImportButton, SIGNAL(clicked()),
             SLOT(cancelImport()));
+    connect(m_thumbnailer, SIGNAL(finished()),
+            SLOT(thumbnailsRegenerated()));
+    connect(m_thumbnailSizeSlider, SIGNAL(valueChanged(int)),
+            SLOT(setThumbnailSize(int)));
 
     m_imageView->connect(m_zoomInAction, SIGNAL(triggered(bool)),
                          SLOT(zoomIn()));
@@ -415,6 +1300,10 @@ void MainWindow::connectSignals()
                          SLOT(rotateLeft()));
     m_imageView->connect(m_rotateRightAction, SIGNAL(triggered(bool)),
                          SLOT(rotateRight()));
+    connect(m_rotateSelectedLeftAction, SIGNAL(triggered(bool)),
+            SLOT(rotateSelectedImagesLeft()));
+    connect(m_rotateSelectedRightAction, SIGNAL(triggered(bool)),
+            SLOT(rotateSelectedImagesRight()));
 
     connect(m_singleViewModeAction, SIGNAL(triggered(bool)),
             SLOT(singleViewMode()));
@@ -428,6 +1317,10 @@ void MainWindow::setupDockWidgets()
 
     m_metadataDockWidget->setWidget(m_metadataWidget);
     addDockWidget(Qt::BottomDockWidgetArea, m_metadataDockWidget);
+
+    m_facetDockWidget->setWindowTitle("Facets");
+    m_facetDockWidget->setWidget(m_facetWidget);
+    addDockWidget(Qt::LeftDockWidgetArea, m_facetDockWidget);
 }
 
 void MainWindow::setupMenus()
@@ -436,14 +1329,30 @@ void MainWindow::setupMenus()
 
     QMenu *fileMenu = menuBar()->addMenu("&File");
     fileMenu->addAction(m_importDirAction);
+    fileMenu->addAction(m_exportAction);
     fileMenu->addAction(m_quitAction);
     fileMenu->addSeparator();
 
     QMenu *viewMenu = menuBar()->addMenu("&View");
     viewMenu->addAction(m_metadataDockWidget->toggleViewAction());
+    viewMenu->addAction(m_facetDockWidget->toggleViewAction());
     viewMenu->addAction(m_toolBar->toggleViewAction());
     viewMenu->addAction(m_singleViewModeAction);
     viewMenu->addAction(m_listViewModeAction);
+    QMenu *sortMenu = viewMenu->addMenu("&Sort by");
+    sortMenu->addActions(m_sortKeyActionGroup->actions());
+    sortMenu->addSeparator();
+    sortMenu->addAction(m_sortAscAction);
+    sortMenu->addAction(m_sortDescAction);
+    viewMenu->addSeparator();
+    viewMenu->addAction(m_findSimilarAction);
+    viewMenu->addAction(m_findNearbyAction);
+    viewMenu->addAction(m_findInAreaAction);
+    viewMenu->addAction(m_showAllImagesAction);
+
+    QMenu *imageMenu = menuBar()->addMenu("&Image");
+    imageMenu->addAction(m_rotateSelectedLeftAction);
+    imageMenu->addAction(m_rotateSelectedRightAction);
 
     QMenu *helpMenu = menuBar()->addMenu("&Help");
     helpMenu->addAction(m_aboutAction);
@@ -458,6 +1367,28 @@ void MainWindow::loadSettings()
     uint area = settings.value("metadataDockWidget/area",
                                Qt::BottomDockWidgetArea).toUInt();
     addDockWidget(static_cast<Qt::DockWidgetArea>(area), m_metadataDockWidget);
+    m_facetDockWidget->setVisible(
+        settings.value("facetDockWidget/visible", true).toBool());
+
+    m_thumbnailSizeSlider->setValue(
+        settings.value("imageListView/thumbnailSize", 80).toInt());
+    setThumbnailSize(m_thumbnailSizeSlider->value());
+
+    m_sortKey = SortKeys::Key(qBound(
+        0, settings.value("imageListView/sortKey", 0).toInt(),
+        SortKeys::KeyCount - 1));
+    m_sortOrder = Qt::SortOrder(
+        settings.value("imageListView/sortOrder",
+                       Qt::AscendingOrder).toInt());
+    m_sortKeyActionGroup->actions()[m_sortKey]->setChecked(true);
+    m_restoredImageId = settings.value("imageListView/currentImage",
+                                       -1).toLongLong();
+    if (m_sortOrder == Qt::AscendingOrder)
+        m_sortAscAction->setChecked(true);
+    else
+        m_sortDescAction->setChecked(true);
+
+    m_exporter->loadSettings();
 }
 
 void MainWindow::saveSettings()
@@ -468,6 +1399,15 @@ void MainWindow::saveSettings()
                       m_metadataDockWidget->isVisible());
     settings.setValue("metadataDockWidget/area",
                       static_cast<uint>(dockWidgetArea(m_metadataDockWidget)));
+    settings.setValue("facetDockWidget/visible",
+                      m_facetDockWidget->isVisible());
+    settings.setValue("imageListView/thumbnailSize",
+                      m_thumbnailSizeSlider->value());
+    settings.setValue("imageListView/sortKey", int(m_sortKey));
+    settings.setValue("imageListView/sortOrder", int(m_sortOrder));
+    settings.setValue("imageListView/currentImage",
+                      m_imageModel->imageId(
+                          m_imageListView->currentIndex().row()));
 }
 
 void MainWindow::setupToolBars()
@@ -475,8 +1415,8 @@ void MainWindow::setupToolBars()
     m_toolBar->setWindowTitle("Tool bar");
     addToolBar(m_toolBar);
     m_toolBar->addAction(m_editAction);
-    m_toolBar->addAction(m_sortAscDateAction);
-    m_toolBar->addAction(m_sortDescDateAction);
+    m_toolBar->addAction(m_sortAscAction);
+    m_toolBar->addAction(m_sortDescAction);
     m_toolBar->addAction(m_tagAction);
     m_toolBar->addAction(m_zoomInAction);
     m_toolBar->addAction(m_zoomOutAction);
@@ -486,13 +1426,28 @@ void MainWindow::setupToolBars()
     m_toolBar->addAction(m_rotateRightAction);
     m_toolBar->addAction(m_singleViewModeAction);
     m_toolBar->addAction(m_listViewModeAction);
+    m_toolBar->addSeparator();
+    m_tagFilterEdit->setPlaceholderText(
+        "Filter by tags, e.g. family AND NOT blurry");
+    m_tagFilterEdit->setMaximumWidth(300);
+    new TagCompleter(&m_tagIndex, m_tagFilterEdit);
+    m_toolBar->addWidget(m_tagFilterEdit);
+    m_searchEdit->setPlaceholderText(
+        "Search paths, tags, dates and cameras");
+    m_searchEdit->setMaximumWidth(300);
+    m_toolBar->addWidget(m_searchEdit);
+
+    // Searching waits for a short pause in typing, so that fast typists
+    // do not queue up a search for every key press.
+    m_searchTimer->setSingleShot(true);
+    m_searchTimer->setInterval(100);
 }
 
 void MainWindow::setupCentralWidget()
 {
-    m_imageModel->setTable("Image");
-    m_imageModel->setEditStrategy(QSqlTableModel::OnManualSubmit);
-    m_imageModel->select();
+    QPalette palette(m_imageListView->palette());
+    palette.setColor(QPalette::Base, QColor("grey"));
+    m_imageListView->setPalette(palette);
     m_imageListView->setSpacing(10);
     m_imageListView->setObjectName("ImageListView");
     m_imageListView->setItemDelegate(new ImageItemDelegate(m_imageListView,
@@ -502,13 +1457,17 @@ void MainWindow::setupCentralWidget()
     m_imageListView->setSelectionMode(QListView::ExtendedSelection);
     m_imageListView->setEditTriggers(QAbstractItemView::NoEditTriggers);
     m_imageListView->setResizeMode(QListView::Adjust);
-    m_imageListView->setIconSize(QSize(80, 80));
     m_imageListView->setUniformItemSizes(true);
     m_imageListView->setModel(m_imageModel);
     m_imageListView->setModelColumn(8);
+    m_imageListView->setContextMenuPolicy(Qt::ActionsContextMenu);
+    m_imageListView->addAction(m_findSimilarAction);
+    m_imageListView->addAction(m_findNearbyAction);
+    m_imageListView->addAction(m_showAllImagesAction);
 
     QLayout* layout = new QVBoxLayout();
     layout->addWidget(m_imageView);
+    layout->addWidget(m_timelineWidget);
     layout->addWidget(m_imageListView);
     QWidget* widget = new QWidget(this);
     widget->setLayout(layout);
@@ -525,24 +1484,33 @@ void MainWindow::setupActions()
     m_aboutAction->setText("&About");
     m_editAction->setText("Edit");
     m_importDirAction->setText("&Import from directory...");
+    m_exportAction->setText("&Export...");
     m_quitAction->setText("&Quit");
-    m_sortAscDateAction->setText("&Ascending time order");
-    m_sortDescDateAction->setText("&Descending time order");
+    m_sortAscAction->setText("&Ascending order");
+    m_sortDescAction->setText("&Descending order");
     m_tagAction->setText("Add tag");
     m_rotateLeftAction->setText("Rotate left");
     m_rotateRightAction->setText("Rotate right");
+    m_rotateSelectedLeftAction->setText("Rotate selected images &left");
+    m_rotateSelectedRightAction->setText("Rotate selected images &right");
     m_zoomInAction->setText("&Zoom in");
     m_zoomOutAction->setText("&Zoom out");
     m_zoomToFitAction->setText("&Zoom to fit");
     m_zoomTo100Action->setText("&Zoom to 100%");
     m_singleViewModeAction->setText("Single view");
     m_listViewModeAction->setText("List view");
+    m_findSimilarAction->setText("Find &similar images");
+    m_findNearbyAction->setText("Find &nearby images");
+    m_findInAreaAction->setText("Find images in &area...");
+    m_showAllImagesAction->setText("Show &all images");
 
     m_editAction->setIcon(QIcon(":/icons/run_external.png"));
-    m_sortAscDateAction->setIcon(QIcon(":/icons/sort_asc_date.png"));
-    m_sortDescDateAction->setIcon(QIcon(":/icons/sort_desc_date.png"));
+    m_sortAscAction->setIcon(QIcon(":/icons/sort_asc_date.png"));
+    m_sortDescAction->setIcon(QIcon(":/icons/sort_desc_date.png"));
     m_rotateLeftAction->setIcon(QIcon(":/icons/rotate_left.png"));
     m_rotateRightAction->setIcon(QIcon(":/icons/rotate_right.png"));
+    m_rotateSelectedLeftAction->setIcon(QIcon(":/icons/rotate_left.png"));
+    m_rotateSelectedRightAction->setIcon(QIcon(":/icons/rotate_right.png"));
     m_zoomInAction->setIcon(QIcon(":/icons/zoom_in.png"));
     m_zoomOutAction->setIcon(QIcon(":/icons/zoom_out.png"));
     m_zoomToFitAction->setIcon(QIcon(":/icons/zoom_to_fit.png"));
@@ -550,18 +1518,40 @@ void MainWindow::setupActions()
     m_singleViewModeAction->setIcon(QIcon(":/icons/single_view.png"));
     m_listViewModeAction->setIcon(QIcon(":/icons/list_view.png"));
 
-    m_sortAscDateAction->setCheckable(true);
-    m_sortDescDateAction->setCheckable(true);
+    m_sortAscAction->setCheckable(true);
+    m_sortDescAction->setCheckable(true);
+
+    const char* const sortKeyNames[SortKeys::KeyCount] = {
+        "&Capture time", "&Modification time", "File &size", "&Path",
+        "Pi&xel count"
+    };
+    for (int key = 0; key < SortKeys::KeyCount; ++key) {
+        QAction* action = new QAction(sortKeyNames[key],
+                                      m_sortKeyActionGroup);
+        action->setData(key);
+        action->setCheckable(true);
+    }
 
     m_singleViewModeAction->setCheckable(true);
     m_listViewModeAction->setCheckable(true);
 
+    m_showAllImagesAction->setEnabled(false);
+
+    // Enabled once the catalog indexes are loaded, unless the catalog is
+    // federated and thus read-only, see library.hh.
+    m_importDirAction->setEnabled(false);
+    m_tagAction->setEnabled(false);
+    m_rotateSelectedLeftAction->setEnabled(false);
+    m_rotateSelectedRightAction->setEnabled(false);
+
     m_editAction->setShortcut(
         QKeySequence("Ctrl+Enter"));
     m_metadataDockWidget->toggleViewAction()->setShortcut(
         QKeySequence("Ctrl+M"));
     m_importDirAction->setShortcut(
         QKeySequence("Ctrl+O"));
+    m_exportAction->setShortcut(
+        QKeySequence("Ctrl+E"));
     m_quitAction->setShortcut(
         QKeySequence("Ctrl+Q"));
     m_rotateLeftAction->setShortcut(
@@ -578,6 +1568,8 @@ void MainWindow::setupActions()
         QKeySequence("F9"));
     m_listViewModeAction->setShortcut(
         QKeySequence("F10"));
+    m_findSimilarAction->setShortcut(
+        QKeySequence("Ctrl+F"));
 }
 
 void MainWindow::setupStatusBar()
@@ -585,14 +1577,26 @@ void MainWindow::setupStatusBar()
     m_cancelImportButton->setText("Cancel import");
     m_cancelImportButton->hide();
     m_importProgressBar->hide();
+    m_cancelExportButton->setText("Cancel export");
+    m_cancelExportButton->hide();
+    m_exportProgressBar->hide();
+
+    // The slider zooms the grid, the delegate picks the nearest stored
+    // thumbnail level for the chosen size.
+    const QList<int> levels(thumbnailLevels());
+    m_thumbnailSizeSlider->setRange(qMin(48, levels.first()), levels.last());
+    m_thumbnailSizeSlider->setMaximumWidth(150);
+    m_thumbnailSizeSlider->setToolTip("Thumbnail size");
 
     setStatusBar(new QStatusBar());
+    statusBar()->addPermanentWidget(m_thumbnailSizeSlider);
 }
 
 void MainWindow::singleViewMode()
 {
     m_imageListView->clearFocus();
     m_imageListView->hide();
+    m_timelineWidget->hide();
     m_imageView->show();
     m_imageView->setFocus(Qt::OtherFocusReason);
 }
@@ -601,6 +1605,7 @@ void MainWindow::listViewMode()
 {
     m_imageView->clearFocus();
     m_imageView->hide();
+    m_timelineWidget->show();
     m_imageListView->show();
     m_imageListView->setFocus(Qt::OtherFocusReason);
 }
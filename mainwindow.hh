@@ -20,9 +20,23 @@
 #include <QtSql>
 #include <QtGui>
 
+#include "batchrotator.hh"
+#include "bulktagger.hh"
+#include "catalogservice.hh"
+#include "catalogsnapshot.hh"
+#include "exporter.hh"
+#include "facetindex.hh"
+#include "facetwidget.hh"
+#include "imagemodel.hh"
+#include "importer.hh"
 #include "imageview.hh"
 #include "metadatawidget.hh"
 #include "imagelistview.hh"
+#include "similarityindex.hh"
+#include "sortkeys.hh"
+#include "tagindex.hh"
+#include "timeline.hh"
+#include "timelinewidget.hh"
 
 class MainWindow : public QMainWindow
 {
@@ -34,26 +48,75 @@ public:
     void importDir(QString dir, bool recursive);
     void importFiles(const QStringList& filePaths);
     void importPaths(const QStringList& paths, bool recursive);
+    void setImportIoOrder(IoOrder order);
+    void setImportReadMode(ReadMode mode);
+    // Whether startup finished without the grid, see startupFinished().
+    bool isStartupFailed() const;
     ~MainWindow();
 
 public slots:
-    void sortAscDate();
-    void sortDescDate();
+    void sortAscending();
+    void sortDescending();
     void editSelectedImages();
+    void exportImages();
     void tagSelectedImages();
-    void loadTags();
+    void rotateSelectedImagesLeft();
+    void rotateSelectedImagesRight();
+    void findSimilarImages();
+    void findNearbyImages();
+    void findImagesInArea();
+    void filterByTags();
+    void filterByFacets();
+    void search();
+    void jumpToDate(const QDate& date);
+    void showAllImages();
+
+signals:
+    // Emitted once the window has painted the grid and the in-memory
+    // indexes of the catalog have been loaded, or once the grid has
+    // failed to load.
+    void startupFinished();
 
 protected:
     virtual void closeEvent(QCloseEvent *event);
+    virtual bool eventFilter(QObject* watched, QEvent* event);
 
 private slots:
+    void loadCatalog();
+    void checkStartupFinished();
     void importDir();
-    void importReadyAt(int i);
+    void importResultsAvailable();
     void importFinished();
     void about();
     void cancelImport();
+    void exportProgressChanged(int value, int maximum);
+    void exportFinished();
+    void cancelExport();
+    void thumbnailJobsFound(const QList<Metadata>& jobs);
+    void thumbnailsRegenerated();
+    void thumbnailsUpdated(bool isSuccessful);
+    void setThumbnailSize(int size);
     void singleViewMode();
     void listViewMode();
+    void tagRemoved(qint64 id, const QString& tag);
+    void taggingProgressChanged(int value, int maximum);
+    void taggingFinished(bool isSuccessful);
+    void rotatingProgressChanged(int value, int maximum);
+    void rotatingFinished(bool isSuccessful);
+    void sortKeysReady(const SortKeys& sortKeys);
+    void sortKeysFailed();
+    void indexesReady(const TagIndex& tagIndex, const FacetIndex& facetIndex,
+                      const Timeline& timeline,
+                      const SimilarityIndex& similarityIndex);
+    void snapshotWritten();
+    void outdatedImagesFound(const QStringList& filePaths);
+    void nearbyImagesFound(const Bitmap& imageIds, double radius);
+    void imagesInBoxFound(const Bitmap& imageIds);
+    void locationSearchFailed(const QString& message);
+    void startEditor(const QStringList& filePaths);
+    void searchFinished(const QString& text, const Bitmap& imageIds,
+                        bool isSuccessful);
+    void sortByKey(QAction* action);
 
 private:
     void connectSignals();
@@ -65,42 +128,101 @@ private:
     void setupMenus();
     void setupStatusBar();
     void setupToolBars();
+    void applyFilters();
+    void writeImported(const Metadata& metadata);
+    void updateImported(qint64 id, const QDate& oldDate,
+                        const Metadata& metadata);
+    void runPendingImport();
+    void regenerateThumbnails();
+    void sortImages();
+    bool openSnapshot();
+    void rotateSelectedImages(BatchRotator::Direction direction);
+
+    CatalogService* m_catalogService;
 
     QAtomicInt m_importCount;
-    QFutureWatcher<Metadata>* m_importer;
+    int m_importResultCount;
+    // Ids and capture dates of the images the running import inserted
+    // since the last commit, by path. The importer cannot look them up.
+    QHash<QString, QPair<qint64, QDate> > m_importedImages;
+    Importer* m_importer;
     QPushButton* m_cancelImportButton;
     QProgressBar* m_importProgressBar;
 
+    Exporter* m_exporter;
+    QPushButton* m_cancelExportButton;
+    QProgressBar* m_exportProgressBar;
+
+    QFutureWatcher<void>* m_thumbnailer;
+    QList<Metadata> m_thumbnailJobs;
+    QSlider* m_thumbnailSizeSlider;
+
     ImageListView* m_imageListView;
     ImageView* m_imageView;
     MetadataWidget* m_metadataWidget;
+    FacetWidget* m_facetWidget;
 
     QDockWidget* m_imageDockWidget;
     QDockWidget* m_metadataDockWidget;
-
-    QSqlQueryModel* m_tagModel;
-    QSqlTableModel* m_imageModel;
+    QDockWidget* m_facetDockWidget;
+
+    BulkTagger* m_bulkTagger;
+    BatchRotator* m_batchRotator;
+    CatalogSnapshot m_snapshot;
+    ImageModel* m_imageModel;
+
+    SimilarityIndex m_similarityIndex;
+    TagIndex m_tagIndex;
+    FacetIndex m_facetIndex;
+    SortKeys m_sortKeys;
+    SortKeys::Key m_sortKey;
+    Qt::SortOrder m_sortOrder;
+    Timeline m_timeline;
+    TimelineWidget* m_timelineWidget;
+    QMap<QString, Bitmap> m_filters;
 
     QActionGroup* m_sortActionGroup;
+    QActionGroup* m_sortKeyActionGroup;
     QActionGroup* m_viewModeActionGroup;
 
     QAction* m_aboutAction;
     QAction* m_editAction;
+    QAction* m_exportAction;
     QAction* m_importDirAction;
     QAction* m_quitAction;
-    QAction* m_sortAscDateAction;
-    QAction* m_sortDescDateAction;
+    QAction* m_sortAscAction;
+    QAction* m_sortDescAction;
     QAction* m_tagAction;
     QAction* m_rotateLeftAction;
     QAction* m_rotateRightAction;
+    QAction* m_rotateSelectedLeftAction;
+    QAction* m_rotateSelectedRightAction;
     QAction* m_zoomInAction;
     QAction* m_zoomOutAction;
     QAction* m_zoomToFitAction;
     QAction* m_zoomTo100Action;
     QAction* m_singleViewModeAction;
     QAction* m_listViewModeAction;
+    QAction* m_findSimilarAction;
+    QAction* m_findNearbyAction;
+    QAction* m_findInAreaAction;
+    QAction* m_showAllImagesAction;
 
     QToolBar* m_toolBar;
+    QLineEdit* m_tagFilterEdit;
+    QLineEdit* m_searchEdit;
+    QTimer* m_searchTimer;
+
+    // Paths waiting to be imported and whether their directories are
+    // walked recursively, in request order.
+    QQueue<QPair<QStringList, bool> > m_pendingImports;
+    qint64 m_restoredImageId;
+    bool m_isWindowPainted;
+    bool m_isGridPainted;
+    bool m_isCatalogLoaded;
+    bool m_isImporting;
+    bool m_isStartupFinished;
+    bool m_isStartupFailed;
 };
 
 #endif // MAINWINDOW_HH
@@ -19,33 +19,144 @@
 #include "common.hh"
 #include "metadata.hh"
 
-static bool fillWithFileInfo(const QString& filePath, Metadata& metadata)
+static bool fillWithFileInfo(const QString& filePath,
+                             const FileStatus& status, Metadata& metadata)
 {
-    QFileInfo fileInfo(filePath);
-
     metadata.insert("filePath", QVariant(filePath));
     metadata.insert("modificationTime",
-                    QVariant(fileInfo.lastModified().toUTC()));
-    metadata.insert("fileSize", QVariant(fileInfo.size()));
+                    QVariant(status.lastModified.toUTC()));
+    metadata.insert("fileSize", QVariant(status.size));
+
+    return true;
+}
+
+// The EXIF datum with the given key, or 0 if the image does not have it.
+static const Exiv2::Exifdatum* findExifDatum(const Exiv2::ExifData& exifData,
+                                             const char* const key)
+{
+    const Exiv2::ExifData::const_iterator i = exifData.findKey(
+        Exiv2::ExifKey(key));
+
+    if (i == exifData.end() || i->count() == 0)
+        return 0;
+
+    return &*i;
+}
+
+static void insertExifString(const Exiv2::ExifData& exifData,
+                             const char* const key, const QString& name,
+                             Metadata& metadata)
+{
+    const Exiv2::Exifdatum* datum = findExifDatum(exifData, key);
+    if (!datum)
+        return;
+
+    const QString value(QString::fromStdString(datum->toString())
+                        .trimmed());
+    if (!value.isEmpty())
+        metadata.insert(name, value);
+}
+
+// Rational values such as the focal length and the exposure time.
+static void insertExifReal(const Exiv2::ExifData& exifData,
+                           const char* const key, const QString& name,
+                           Metadata& metadata)
+{
+    const Exiv2::Exifdatum* datum = findExifDatum(exifData, key);
+    if (!datum)
+        return;
+
+    const double value = datum->toFloat();
+    if (value > 0.0)
+        metadata.insert(name, value);
+}
+
+static void insertExifInteger(const Exiv2::ExifData& exifData,
+                              const char* const key, const QString& name,
+                              Metadata& metadata)
+{
+    const Exiv2::Exifdatum* datum = findExifDatum(exifData, key);
+    if (!datum)
+        return;
+
+    const qlonglong value = qlonglong(datum->toLong());
+    if (value > 0)
+        metadata.insert(name, value);
+}
+
+static QDateTime exifDateTime(const Exiv2::ExifData& exifData,
+                              const char* const key)
+{
+    const Exiv2::Exifdatum* datum = findExifDatum(exifData, key);
+    if (!datum)
+        return QDateTime();
+
+    QString dateTimeString = QString::fromStdString(datum->toString());
+    dateTimeString.truncate(19);
+    QDateTime dateTime = QDateTime::fromString(dateTimeString,
+                                               "yyyy:MM:dd HH:mm:ss");
+    dateTime.setTimeSpec(Qt::UTC);
+
+    return dateTime;
+}
+
+// Degrees of a GPS coordinate given as degrees, minutes and seconds,
+// negative towards the south or the west.
+static bool exifCoordinate(const Exiv2::ExifData& exifData,
+                           const char* const key, const char* const refKey,
+                           const char negativeRef, double* coordinate)
+{
+    const Exiv2::Exifdatum* datum = findExifDatum(exifData, key);
+    const Exiv2::Exifdatum* ref = findExifDatum(exifData, refKey);
+    if (!datum || !ref || datum->count() != 3)
+        return false;
+
+    double degrees = 0.0;
+    for (long i = 0; i < 3; ++i) {
+        const Exiv2::Rational part = datum->toRational(i);
+        if (part.second == 0)
+            return false;
+        degrees += double(part.first) / part.second / qPow(60.0, i);
+    }
+
+    const std::string direction = ref->toString();
+    if (!direction.empty() && direction[0] == negativeRef)
+        degrees = -degrees;
+    *coordinate = degrees;
 
     return true;
 }
 
-static bool fillWithImageInfo(const QString& filePath, Metadata& metadata)
+// A probe parses a prefix of the file quietly and fails unless the prefix
+// had the dimensions and the EXIF timestamp; the orientation is in the
+// first EXIF directory, next to the timestamp.
+static bool fillWithImageInfo(const QString& filePath,
+                              const QByteArray& data, const bool isProbe,
+                              Metadata& metadata)
 {
     static QMutex mutex;
     QMutexLocker locker(&mutex);
     try {
-        Exiv2::Image::AutoPtr image = Exiv2::ImageFactory::open(
-            filePath.toStdString());
+        // Exiv2 parses data in memory in place, without copying it.
+        Exiv2::Image::AutoPtr image;
+        if (data.isNull())
+            image = Exiv2::ImageFactory::open(filePath.toStdString());
+        else
+            image = Exiv2::ImageFactory::open(
+                reinterpret_cast<const Exiv2::byte*>(data.constData()),
+                data.size());
         if (image.get() == 0) {
-            qCritical() << "failed to recognize " << filePath << " as an image";
+            if (!isProbe)
+                qCritical() << "failed to recognize " << filePath
+                            << " as an image";
             return false;
         }
         image->readMetadata();
 
         const int w = image->pixelWidth();
         const int h = image->pixelHeight();
+        if (isProbe && (w <= 0 || h <= 0))
+            return false;
         metadata.insert("imageSize", QVariant(QSize(w, h)));
 
         metadata.insert("timestamp", QDateTime::fromTime_t(0).toUTC());
@@ -53,41 +164,83 @@ static bool fillWithImageInfo(const QString& filePath, Metadata& metadata)
 
         Exiv2::ExifData &exifData = image->exifData();
         if (exifData.empty()) {
+            if (isProbe)
+                return false;
             qWarning() << filePath << " does not have EXIF data";
             return true;
         }
 
-        QString dateTimeString = QString::fromStdString(
-            exifData["Exif.Image.DateTime"]
-            .toString());
-        dateTimeString.truncate(19);
-        QDateTime dateTime = QDateTime::fromString(dateTimeString,
-                                                   "yyyy:MM:dd HH:mm:ss");
-        dateTime.setTimeSpec(Qt::UTC);
+        // DateTimeOriginal is when the picture was taken, DateTime when
+        // the file was last changed, which is often the same but not
+        // after editing.
+        QDateTime dateTime = exifDateTime(exifData,
+                                          "Exif.Photo.DateTimeOriginal");
+        if (!dateTime.isValid())
+            dateTime = exifDateTime(exifData, "Exif.Image.DateTime");
+        if (isProbe && !dateTime.isValid())
+            return false;
         if (dateTime.isValid())
             metadata.insert("timestamp", QVariant(dateTime));
         qlonglong orientation = qlonglong(
             exifData["Exif.Image.Orientation"].toLong());
         metadata.insert("orientation", QVariant(orientation));
+
+        // Fields which are missing are left out, they are null in the
+        // catalog.
+        insertExifString(exifData, "Exif.Image.Make", "cameraMake",
+                         metadata);
+        insertExifString(exifData, "Exif.Image.Model", "cameraModel",
+                         metadata);
+        insertExifString(exifData, "Exif.Photo.LensModel", "lensModel",
+                         metadata);
+        insertExifReal(exifData, "Exif.Photo.FocalLength", "focalLength",
+                       metadata);
+        insertExifInteger(exifData, "Exif.Photo.ISOSpeedRatings",
+                          "isoSpeed", metadata);
+        insertExifReal(exifData, "Exif.Photo.ExposureTime", "exposureTime",
+                       metadata);
+
+        double latitude;
+        double longitude;
+        if (exifCoordinate(exifData, "Exif.GPSInfo.GPSLatitude",
+                           "Exif.GPSInfo.GPSLatitudeRef", 'S', &latitude)
+            && exifCoordinate(exifData, "Exif.GPSInfo.GPSLongitude",
+                              "Exif.GPSInfo.GPSLongitudeRef", 'W',
+                              &longitude)
+            && qAbs(latitude) <= 90.0 && qAbs(longitude) <= 180.0) {
+            metadata.insert("latitude", latitude);
+            metadata.insert("longitude", longitude);
+        }
     } catch (Exiv2::AnyError& e) {
-        qWarning() << "failed to retrieve metadata from "
-                   << filePath << ": " << e.what();
+        if (!isProbe)
+            qWarning() << "failed to retrieve metadata from "
+                       << filePath << ": " << e.what();
         return false;
     }
     return true;
 }
 
 Metadata getMetadata(const QString& filePath)
+{
+    FileStatus status;
+    if (!statFile(filePath, &status))
+        return Metadata();
+
+    return getMetadata(filePath, status);
+}
+
+Metadata getMetadata(const QString& filePath, const FileStatus& status,
+                     const QByteArray& data)
 {
     Metadata metadata;
 
-    if (!fillWithFileInfo(filePath, metadata)) {
+    if (!fillWithFileInfo(filePath, status, metadata)) {
         qCritical() << "failed to get file info from " << filePath;
         metadata.clear();
         return metadata;
     }
 
-    if (!fillWithImageInfo(filePath, metadata)) {
+    if (!fillWithImageInfo(filePath, data, false, metadata)) {
         qCritical() << "failed to get image info from " << filePath;
         metadata.clear();
         return metadata;
@@ -96,6 +249,57 @@ Metadata getMetadata(const QString& filePath)
     return metadata;
 }
 
+Metadata probeMetadata(const QString& filePath, const FileStatus& status,
+                       const QByteArray& prefix)
+{
+    Metadata metadata;
+
+    if (!fillWithFileInfo(filePath, status, metadata)
+        || !fillWithImageInfo(filePath, prefix, true, metadata))
+        metadata.clear();
+
+    return metadata;
+}
+
+// Only the orientation tags are changed, Exiv2 rewrites the file around
+// the new metadata without touching the compressed image data. Exiv2
+// images are independent of each other once the XMP toolkit has been
+// initialized, so files can be written in parallel.
+bool writeOrientation(const QString& filePath, const int orientation)
+{
+    static QMutex mutex;
+    {
+        QMutexLocker locker(&mutex);
+        Exiv2::XmpParser::initialize();
+    }
+
+    try {
+        Exiv2::Image::AutoPtr image = Exiv2::ImageFactory::open(
+            filePath.toStdString());
+        if (image.get() == 0) {
+            qWarning() << "failed to recognize " << filePath
+                       << " as an image";
+            return false;
+        }
+        image->readMetadata();
+
+        image->exifData()["Exif.Image.Orientation"]
+            = static_cast<uint16_t>(orientation);
+        Exiv2::XmpData& xmpData = image->xmpData();
+        if (xmpData.findKey(Exiv2::XmpKey("Xmp.tiff.Orientation"))
+            != xmpData.end())
+            xmpData["Xmp.tiff.Orientation"] = orientation;
+
+        image->writeMetadata();
+    } catch (Exiv2::AnyError& e) {
+        qWarning() << "failed to write orientation to "
+                   << filePath << ": " << e.what();
+        return false;
+    }
+
+    return true;
+}
+
 QTransform exifTransform(const Metadata& metadata)
 {
     if (metadata.contains("orientation"))
@@ -108,14 +312,17 @@ QTransform exifTransform(int orientation)
 {
     static const QTransform transforms[] = {
         QTransform(),
-        QTransform(),
+        QTransform(-1, 0, 0, 1, 0, 0),
         QTransform().rotate(180),
-        QTransform(),
-        QTransform(),
+        QTransform(1, 0, 0, -1, 0, 0),
+        QTransform(0, 1, 1, 0, 0, 0),
         QTransform().rotate(90),
-        QTransform(),
+        QTransform(0, -1, -1, 0, 0, 0),
         QTransform().rotate(-90)
     };
 
+    if (orientation < 1 || orientation > 8)
+        return QTransform();
+
     return transforms[orientation - 1];
 }
@@ -19,9 +19,29 @@
 
 #include <QtGui>
 
+#include "filestatus.hh"
+
 typedef QHash<QString, QVariant> Metadata;
 
+// Version of the metadata getMetadata() extracts, recorded with every
+// catalogued image. Images catalogued by an older version get the fields
+// it did not extract when they are imported again.
+static const int metadataVersion = 2;
+
 Metadata getMetadata(const QString& filePath);
+// Takes the file details from the status and parses the image from the
+// data unless it is null, so that a file which has already been stat'ed
+// and read into memory is not opened again.
+Metadata getMetadata(const QString& filePath, const FileStatus& status,
+                     const QByteArray& data = QByteArray());
+// Parses the metadata from the first bytes of a file, which are enough for
+// most photographs as their EXIF data comes before the image data. The
+// metadata is empty if the prefix did not have the dimensions, timestamp
+// and orientation; the whole file has to be parsed then.
+Metadata probeMetadata(const QString& filePath, const FileStatus& status,
+                       const QByteArray& prefix);
+// Sets the EXIF orientation of the image file in place.
+bool writeOrientation(const QString& filePath, int orientation);
 QTransform exifTransform(const Metadata& metadata);
 QTransform exifTransform(int orientation);
 
@@ -15,16 +15,21 @@
 // along with this program. If not, see <http://www.gnu.org/licenses/>.
 
 #include "common.hh"
+#include "library.hh"
 #include "metadatawidget.hh"
 
-MetadataWidget::MetadataWidget(QWidget *parent)
+MetadataWidget::MetadataWidget(CatalogService* catalogService,
+                               const TagIndex* tagIndex, QWidget *parent)
     :QScrollArea(parent)
+    ,m_catalogService(catalogService)
+    ,m_tagIndex(tagIndex)
+    ,m_imageId(-1)
     ,m_filePathLabel(new QLabel(this))
     ,m_timestampLabel(new QLabel(this))
     ,m_modificationTimeLabel(new QLabel(this))
     ,m_fileSizeLabel(new QLabel(this))
     ,m_imageSizeLabel(new QLabel(this))
-    ,m_tagModel(new QSqlQueryModel(this))
+    ,m_tagModel(new QStringListModel(this))
     ,m_tagView(new QListView(this))
 {
     m_filePathLabel->setTextInteractionFlags(Qt::TextBrowserInteraction);
@@ -37,8 +42,20 @@ MetadataWidget::MetadataWidget(QWidget *parent)
     m_tagView->setFrameShape(QFrame::NoFrame);
     m_tagView->setSelectionMode(QAbstractItemView::NoSelection);
     m_tagView->setFocusPolicy(Qt::NoFocus);
-    connect(m_tagView, SIGNAL(clicked(const QModelIndex&)),
-            SLOT(removeTag(const QModelIndex&)));
+    // The style sheet applies to the tag view only, an application-wide
+    // style sheet would slow down polishing every widget.
+    QFile styleSheetFile(":metadatawidget.qss");
+    styleSheetFile.open(QFile::ReadOnly);
+    m_tagView->setStyleSheet(styleSheetFile.readAll());
+    // Clicking a tag removes it, unless the catalog is federated and
+    // read-only.
+    if (!isFederated()) {
+        connect(m_tagView, SIGNAL(clicked(const QModelIndex&)),
+                SLOT(removeTag(const QModelIndex&)));
+    }
+    connect(m_catalogService,
+            SIGNAL(tagRemoved(qint64, const QString&, bool)),
+            SLOT(catalogTagRemoved(qint64, const QString&, bool)));
 
     QWidget* widget = new QWidget(this);
     QFormLayout *layout = new QFormLayout(widget);
@@ -59,18 +76,13 @@ MetadataWidget::~MetadataWidget()
 
 void MetadataWidget::updateTags()
 {
-    QSqlQuery query;
-    query.prepare("SELECT tag FROM Tagging "
-                  "WHERE Tagging.file_path = ? "
-                  "ORDER BY tag");
-    query.addBindValue(m_filePathLabel->text());
-    query.exec();
-    m_tagModel->setQuery(query);
+    m_tagModel->setStringList(m_tagIndex->tags(m_imageId));
 }
 
 void MetadataWidget::setMetadata(const QModelIndex& index)
 {
     if (!index.isValid()) {
+        m_imageId = -1;
         m_filePathLabel->clear();
         m_timestampLabel->clear();
         m_modificationTimeLabel->clear();
@@ -80,6 +92,7 @@ void MetadataWidget::setMetadata(const QModelIndex& index)
         return;
     }
 
+    m_imageId = index.sibling(index.row(), 0).data().toLongLong();
     m_filePathLabel->setText(
         index.sibling(index.row(), 1).data().toString());
     m_timestampLabel->setText(
@@ -97,12 +110,16 @@ void MetadataWidget::setMetadata(const QModelIndex& index)
 
 void MetadataWidget::removeTag(const QModelIndex &index)
 {
-    QSqlQuery query;
+    m_catalogService->removeTag(m_imageId, m_filePathLabel->text(),
+                                m_tagModel->data(index).toString());
+}
 
-    query.prepare("DELETE FROM Tagging "
-                  "WHERE file_path == ? AND tag == ?");
-    query.addBindValue(m_filePathLabel->text());
-    query.addBindValue(m_tagModel->data(index));
-    query.exec();
-    updateTags();
+void MetadataWidget::catalogTagRemoved(const qint64 imageId,
+                                       const QString& tag,
+                                       const bool isSuccessful)
+{
+    if (isSuccessful)
+        emit tagRemoved(imageId, tag);
+    if (imageId == m_imageId)
+        updateTags();
 }
@@ -20,30 +20,41 @@
 #include <QtGui>
 #include <QtSql>
 
+#include "catalogservice.hh"
 #include "metadata.hh"
+#include "tagindex.hh"
 
 class MetadataWidget : public QScrollArea
 {
     Q_OBJECT
 
 public:
-    explicit MetadataWidget(QWidget *parent = 0);
+    MetadataWidget(CatalogService* catalogService, const TagIndex* tagIndex,
+                   QWidget *parent = 0);
     ~MetadataWidget();
 
 public slots:
     void setMetadata(const QModelIndex& index);
     void updateTags();
 
+signals:
+    void tagRemoved(qint64 imageId, const QString& tag);
+
 private slots:
     void removeTag(const QModelIndex &index);
+    void catalogTagRemoved(qint64 imageId, const QString& tag,
+                           bool isSuccessful);
 
 private:
+    CatalogService* m_catalogService;
+    const TagIndex* m_tagIndex;
+    qint64 m_imageId;
     QLabel *m_filePathLabel;
     QLabel *m_timestampLabel;
     QLabel *m_modificationTimeLabel;
     QLabel *m_fileSizeLabel;
     QLabel *m_imageSizeLabel;
-    QSqlQueryModel *m_tagModel;
+    QStringListModel *m_tagModel;
     QListView *m_tagView;
 
 };
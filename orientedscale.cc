@@ -0,0 +1,175 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "orientedscale.hh"
+
+// Display pixel (u, v) of an oriented image is source pixel (x, y) where
+// (s, t) is (v, u) if transposed and (u, v) otherwise, x is s mirrored if
+// isMirroredX and y is t mirrored if isMirroredY.
+struct OrientationMapping
+{
+    bool isTransposed;
+    bool isMirroredX;
+    bool isMirroredY;
+};
+
+static const OrientationMapping orientationMappings[8] = {
+    {false, false, false}, // 1: normal
+    {false, true, false},  // 2: mirrored horizontally
+    {false, true, true},   // 3: rotated 180
+    {false, false, true},  // 4: mirrored vertically
+    {true, false, false},  // 5: transposed
+    {true, false, true},   // 6: rotated 90 clockwise
+    {true, true, true},    // 7: transversed
+    {true, true, false}    // 8: rotated 90 counterclockwise
+};
+
+static const OrientationMapping& orientationMapping(const int orientation)
+{
+    if (orientation < 1 || orientation > 8)
+        return orientationMappings[0];
+
+    return orientationMappings[orientation - 1];
+}
+
+QSize orientedSize(const QSize& size, const int orientation)
+{
+    if (orientationMapping(orientation).isTransposed)
+        return QSize(size.height(), size.width());
+
+    return size;
+}
+
+// First oriented pixel of each box of the scaled image along one axis,
+// followed by the end of the last box. Every box covers at least one
+// pixel, so that images can be scaled up too.
+static QVector<int> boxBounds(const int size, const int scaledSize)
+{
+    QVector<int> bounds(scaledSize + 1);
+
+    for (int i = 0; i <= scaledSize; ++i)
+        bounds[i] = int(qint64(i) * size / scaledSize);
+
+    return bounds;
+}
+
+void drawOrientedScaled(const QImage& source, const QRect& sourceRect,
+                        const int orientation, QImage* const destination,
+                        const QRect& targetRect)
+{
+    Q_ASSERT(destination->format() == QImage::Format_RGB32
+             || destination->format()
+                == QImage::Format_ARGB32_Premultiplied);
+
+    const QRect from(sourceRect & source.rect());
+    const QRect to(targetRect & destination->rect());
+    if (from.isEmpty() || to.isEmpty())
+        return;
+
+    // Averages are only right for premultiplied colors; decoders produce
+    // RGB32 for most photographs, which is used as it is.
+    const QImage image(source.format() == QImage::Format_RGB32
+                       || source.format()
+                          == QImage::Format_ARGB32_Premultiplied
+                       ? source
+                       : source.convertToFormat(
+                           QImage::Format_ARGB32_Premultiplied));
+
+    const OrientationMapping& mapping = orientationMapping(orientation);
+    const int w = from.width();
+    const int h = from.height();
+    const int stride = image.bytesPerLine() / sizeof(QRgb);
+    const QRgb* const pixels = reinterpret_cast<const QRgb*>(
+        image.constBits()) + from.y() * stride + from.x();
+
+    // Offsets of the source pixels of each oriented column and row, the
+    // pixel at (u, v) is at uOffsets[u] + vOffsets[v].
+    const int orientedWidth = mapping.isTransposed ? h : w;
+    const int orientedHeight = mapping.isTransposed ? w : h;
+    QVector<int> uOffsets(orientedWidth);
+    QVector<int> vOffsets(orientedHeight);
+    for (int u = 0; u < orientedWidth; ++u) {
+        if (mapping.isTransposed)
+            uOffsets[u] = (mapping.isMirroredY ? h - 1 - u : u) * stride;
+        else
+            uOffsets[u] = mapping.isMirroredX ? w - 1 - u : u;
+    }
+    for (int v = 0; v < orientedHeight; ++v) {
+        if (mapping.isTransposed)
+            vOffsets[v] = mapping.isMirroredX ? w - 1 - v : v;
+        else
+            vOffsets[v] = (mapping.isMirroredY ? h - 1 - v : v) * stride;
+    }
+
+    const QVector<int> uBounds(boxBounds(orientedWidth, to.width()));
+    const QVector<int> vBounds(boxBounds(orientedHeight, to.height()));
+    QVector<quint64> sums(to.width() * 4);
+
+    for (int y = 0; y < to.height(); ++y) {
+        const int vBegin = vBounds[y];
+        const int vEnd = qMax(vBegin + 1, vBounds[y + 1]);
+
+        sums.fill(0);
+        for (int v = vBegin; v < vEnd; ++v) {
+            const QRgb* const row = pixels + vOffsets[v];
+            quint64* sum = sums.data();
+            for (int x = 0; x < to.width(); ++x, sum += 4) {
+                const int uBegin = uBounds[x];
+                const int uEnd = qMax(uBegin + 1, uBounds[x + 1]);
+                for (int u = uBegin; u < uEnd; ++u) {
+                    const QRgb pixel = row[uOffsets[u]];
+                    sum[0] += qAlpha(pixel);
+                    sum[1] += qRed(pixel);
+                    sum[2] += qGreen(pixel);
+                    sum[3] += qBlue(pixel);
+                }
+            }
+        }
+
+        QRgb* const line = reinterpret_cast<QRgb*>(
+            destination->scanLine(to.y() + y)) + to.x();
+        const quint64* sum = sums.constData();
+        for (int x = 0; x < to.width(); ++x, sum += 4) {
+            const int uBegin = uBounds[x];
+            const quint64 count = quint64(vEnd - vBegin)
+                * quint64(qMax(uBegin + 1, uBounds[x + 1]) - uBegin);
+            const quint64 half = count / 2;
+            line[x] = qRgba(int((sum[1] + half) / count),
+                            int((sum[2] + half) / count),
+                            int((sum[3] + half) / count),
+                            int((sum[0] + half) / count));
+        }
+    }
+}
+
+QImage orientedScaled(const QImage& image, const int orientation,
+                      const QSize& size)
+{
+    if (&orientationMapping(orientation) == orientationMappings
+        && size == image.size())
+        return image;
+
+    QImage result(size, image.hasAlphaChannel()
+                  ? QImage::Format_ARGB32_Premultiplied
+                  : QImage::Format_RGB32);
+    if (result.isNull())
+        return result;
+
+    drawOrientedScaled(image, image.rect(), orientation, &result,
+                       result.rect());
+
+    return result;
+}
@@ -0,0 +1,41 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ORIENTEDSCALE_HH
+#define ORIENTEDSCALE_HH
+
+#include <QtGui>
+
+// Size of an image of the given size once the EXIF orientation has been
+// applied. Orientations outside 1-8 are taken as 1.
+QSize orientedSize(const QSize& size, int orientation);
+
+// Draws the source rectangle of the image into the target rectangle of
+// the destination, applying the EXIF orientation and scaling with a box
+// filter in a single pass. Every orientation, mirrored ones included, is
+// a remapping of source pixel offsets, so no intermediate image is made.
+// The target rectangle is in display orientation. The destination must
+// be of Format_RGB32 or Format_ARGB32_Premultiplied.
+void drawOrientedScaled(const QImage& source, const QRect& sourceRect,
+                        int orientation, QImage* destination,
+                        const QRect& targetRect);
+
+// The image oriented and scaled to exactly the given size, which is in
+// display orientation.
+QImage orientedScaled(const QImage& image, int orientation,
+                      const QSize& size);
+
+#endif // ORIENTEDSCALE_HH
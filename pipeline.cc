@@ -0,0 +1,39 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "pipeline.hh"
+
+PipelineSettings::PipelineSettings()
+{
+    QSettings settings;
+    const int cores = QThread::idealThreadCount();
+    const qint64 megapixel = 1000 * 1000;
+    const qint64 mebibyte = 1024 * 1024;
+
+    readThreads = qMax(1, settings.value("import/readThreads", 4).toInt());
+    decodeThreads = qMax(
+        1, settings.value("import/decodeThreads", cores).toInt());
+    writeThreads = qMax(
+        1, settings.value("import/writeThreads", qMax(1, cores / 2)).toInt());
+    queueDepth = settings.value("import/queueDepth",
+                                2 * decodeThreads).toInt();
+    pixelBudget = megapixel * qMax(
+        1, settings.value("import/pixelBudget", 256).toInt());
+    largeImageLimit = megapixel * qMax(
+        1, settings.value("import/largeImageMegapixels", 64).toInt());
+    readBudget = mebibyte * qMax(
+        1, settings.value("import/readBudget", 512).toInt());
+}
@@ -0,0 +1,251 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PIPELINE_HH
+#define PIPELINE_HH
+
+#include <QtCore>
+
+#include "boundedqueue.hh"
+#include "pixelbudget.hh"
+
+// Thread counts, queue depth and decoded pixel budget of the pipelines,
+// read from the import/* settings.
+struct PipelineSettings
+{
+    PipelineSettings();
+
+    int readThreads;
+    int decodeThreads;
+    int writeThreads;
+    int queueDepth;
+    qint64 pixelBudget;
+    qint64 largeImageLimit;
+    qint64 readBudget;
+};
+
+// Stages of the import and export pipelines. Jobs flow through four
+// stages connected by bounded queues, each stage with its own threads:
+//
+//   feed:   one thread finding the files to process
+//   read:   blocking file I/O
+//   decode: image decoding, one thread per core
+//   write:  encoding and saving
+//
+// A full queue blocks the stage feeding it, so a slow stage throttles the
+// others instead of letting buffered jobs pile up in memory. The file data
+// read but not yet decoded is bounded by a budget of bytes besides: the
+// read stage acquires the bytes of a job before reading it, and records
+// them in the readCharge of the job, and they are released once the job
+// has been decoded, its data dropped. The last
+// worker of a stage to finish closes the queue of the next stage, and once
+// the write stage has finished the pass is over.
+//
+// The pipeline calls the stage functions of its subclass from its worker
+// threads. The subclass cancels and waits for the pipeline before it is
+// destroyed.
+template <typename Job>
+class Pipeline
+{
+protected:
+    enum Stage { FeedStage, ReadStage, DecodeStage, WriteStage, StageCount };
+
+    Pipeline()
+        :m_readQueue(1)
+        ,m_decodeQueue(1)
+        ,m_writeQueue(1)
+        ,m_pixelBudget(1, 1)
+        ,m_readBudget(1, 1)
+    {
+        for (int i = 0; i < StageCount; ++i)
+            m_threadCounts[i] = 1;
+    }
+
+    virtual ~Pipeline()
+    {
+    }
+
+    // Sizes the queues, the budget and the stages for the next passes.
+    void configure(const PipelineSettings& settings)
+    {
+        m_readQueue.setCapacity(settings.queueDepth);
+        m_decodeQueue.setCapacity(settings.queueDepth);
+        m_writeQueue.setCapacity(settings.queueDepth);
+        m_pixelBudget.reset();
+        m_pixelBudget.setCapacity(settings.pixelBudget,
+                                  settings.largeImageLimit);
+        m_readBudget.reset();
+        m_readBudget.setCapacity(settings.readBudget, settings.readBudget);
+
+        m_threadCounts[FeedStage] = 1;
+        m_threadCounts[ReadStage] = settings.readThreads;
+        m_threadCounts[DecodeStage] = settings.decodeThreads;
+        m_threadCounts[WriteStage] = settings.writeThreads;
+    }
+
+    void setThreadCount(const Stage stage, const int count)
+    {
+        m_threadCounts[stage] = qMax(1, count);
+    }
+
+    // Starts the workers of every stage, consumers before producers.
+    void startPass()
+    {
+        m_readQueue.reset();
+        m_decodeQueue.reset();
+        m_writeQueue.reset();
+
+        for (int i = StageCount - 1; i >= 0; --i) {
+            const Stage stage = Stage(i);
+            m_pools[stage].setMaxThreadCount(m_threadCounts[stage]);
+            m_activeWorkers[stage] = m_threadCounts[stage];
+            for (int j = 0; j < m_threadCounts[stage]; ++j)
+                m_pools[stage].start(new Worker(this, stage));
+        }
+    }
+
+    void abortPass()
+    {
+        m_readQueue.abort();
+        m_decodeQueue.abort();
+        m_writeQueue.abort();
+        m_pixelBudget.abort();
+        m_readBudget.abort();
+    }
+
+    void waitForPass()
+    {
+        for (int i = 0; i < StageCount; ++i)
+            m_pools[i].waitForDone();
+    }
+
+    virtual void feed() = 0;
+    virtual void read(Job& job) = 0;
+    virtual void decode(Job& job) = 0;
+    virtual void write(Job& job) = 0;
+    // Hands on a written job. Returning false stops the worker.
+    virtual bool complete(Job& job) = 0;
+    // Called by the last write worker to finish.
+    virtual void passFinished() = 0;
+
+    // Pops jobs from the read queue and pushes them, read, to the decode
+    // queue.
+    virtual void readJobs()
+    {
+        Job job;
+
+        while (m_readQueue.pop(job)) {
+            read(job);
+            if (!m_decodeQueue.push(job))
+                break;
+        }
+    }
+
+    BoundedQueue<Job> m_readQueue;
+    BoundedQueue<Job> m_decodeQueue;
+    BoundedQueue<Job> m_writeQueue;
+
+    PixelBudget m_pixelBudget;
+    // Bytes of file data read but not yet decoded. Only files at least as
+    // large as the whole budget are read one at a time.
+    PixelBudget m_readBudget;
+
+private:
+    class Worker : public QRunnable
+    {
+    public:
+        Worker(Pipeline* pipeline, Stage stage)
+            :m_pipeline(pipeline)
+            ,m_stage(stage)
+        {
+        }
+
+        virtual void run()
+        {
+            m_pipeline->run(m_stage);
+        }
+
+    private:
+        Pipeline* m_pipeline;
+        Stage m_stage;
+    };
+
+    void run(const Stage stage)
+    {
+        Job job;
+
+        switch (stage) {
+        case FeedStage:
+            feed();
+            break;
+        case ReadStage:
+            readJobs();
+            break;
+        case DecodeStage:
+            while (m_decodeQueue.pop(job)) {
+                decode(job);
+                job.data.clear();
+                if (job.readCharge > 0) {
+                    m_readBudget.release(job.readCharge);
+                    job.readCharge = 0;
+                }
+                if (!m_writeQueue.push(job))
+                    break;
+            }
+            break;
+        case WriteStage:
+            while (m_writeQueue.pop(job)) {
+                write(job);
+                if (!complete(job))
+                    break;
+            }
+            break;
+        default:
+            break;
+        }
+
+        stageFinished(stage);
+    }
+
+    void stageFinished(const Stage stage)
+    {
+        if (m_activeWorkers[stage].deref())
+            return;
+
+        switch (stage) {
+        case FeedStage:
+            m_readQueue.close();
+            break;
+        case ReadStage:
+            m_decodeQueue.close();
+            break;
+        case DecodeStage:
+            m_writeQueue.close();
+            break;
+        case WriteStage:
+            passFinished();
+            break;
+        default:
+            break;
+        }
+    }
+
+    int m_threadCounts[StageCount];
+    QThreadPool m_pools[StageCount];
+    QAtomicInt m_activeWorkers[StageCount];
+};
+
+#endif // PIPELINE_HH
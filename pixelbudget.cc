@@ -0,0 +1,143 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "pixelbudget.hh"
+
+PixelBudget::PixelBudget(const qint64 capacity, const qint64 largeImageLimit)
+    :m_capacity(qMax(qint64(1), capacity))
+    ,m_largeImageLimit(qMax(qint64(1), largeImageLimit))
+    ,m_used(0)
+    ,m_isLargeImageDecoding(false)
+    ,m_isAborted(false)
+{
+}
+
+bool PixelBudget::acquire(const qint64 pixels)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const qint64 charged = charge(pixels);
+    const bool large = isLarge(pixels);
+
+    // A reservation always fits in an idle budget, otherwise an image
+    // larger than the budget would never be admitted.
+    while (!m_isAborted
+           && ((m_used > 0 && m_used + charged > m_capacity)
+               || (large && m_isLargeImageDecoding)))
+        m_released.wait(&m_mutex);
+    if (m_isAborted)
+        return false;
+
+    m_used += charged;
+    if (large)
+        m_isLargeImageDecoding = true;
+    return true;
+}
+
+bool PixelBudget::tryAcquire(const qint64 pixels)
+{
+    QMutexLocker locker(&m_mutex);
+
+    const qint64 charged = charge(pixels);
+    const bool large = isLarge(pixels);
+
+    if (m_isAborted
+        || (m_used > 0 && m_used + charged > m_capacity)
+        || (large && m_isLargeImageDecoding))
+        return false;
+
+    m_used += charged;
+    if (large)
+        m_isLargeImageDecoding = true;
+    return true;
+}
+
+void PixelBudget::release(const qint64 pixels)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_used = qMax(qint64(0), m_used - charge(pixels));
+    if (isLarge(pixels))
+        m_isLargeImageDecoding = false;
+    m_released.wakeAll();
+}
+
+void PixelBudget::abort()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_isAborted = true;
+    m_released.wakeAll();
+}
+
+void PixelBudget::reset()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_used = 0;
+    m_isLargeImageDecoding = false;
+    m_isAborted = false;
+}
+
+void PixelBudget::setCapacity(const qint64 capacity,
+                              const qint64 largeImageLimit)
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_capacity = qMax(qint64(1), capacity);
+    m_largeImageLimit = qMax(qint64(1), largeImageLimit);
+    m_released.wakeAll();
+}
+
+qint64 PixelBudget::used() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_used;
+}
+
+qint64 PixelBudget::capacity() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_capacity;
+}
+
+qint64 PixelBudget::charge(const qint64 pixels) const
+{
+    return qBound(qint64(0), pixels, m_capacity);
+}
+
+bool PixelBudget::isLarge(const qint64 pixels) const
+{
+    return pixels >= m_largeImageLimit;
+}
+
+PixelReservation::PixelReservation(PixelBudget* budget, const qint64 pixels)
+    :m_budget(budget)
+    ,m_pixels(pixels)
+    ,m_isAcquired(budget->acquire(pixels))
+{
+}
+
+PixelReservation::~PixelReservation()
+{
+    if (m_isAcquired)
+        m_budget->release(m_pixels);
+}
+
+bool PixelReservation::isAcquired() const
+{
+    return m_isAcquired;
+}
@@ -0,0 +1,81 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PIXELBUDGET_HH
+#define PIXELBUDGET_HH
+
+#include <QtCore>
+
+// Admission control for concurrent image decodes. Each decode reserves
+// the number of pixels it is about to allocate and blocks while the
+// reservation does not fit in the budget, which bounds the memory held by
+// decoded images no matter how many decoders run. Images at least as
+// large as the large image limit are decoded one at a time, and an image
+// larger than the whole budget waits until it can have the budget to
+// itself.
+class PixelBudget
+{
+public:
+    PixelBudget(qint64 capacity, qint64 largeImageLimit);
+
+    // Returns false if the budget was aborted while waiting.
+    bool acquire(qint64 pixels);
+    // Acquires without waiting, returns false if the reservation does not
+    // fit now.
+    bool tryAcquire(qint64 pixels);
+    void release(qint64 pixels);
+
+    // Wakes up and fails all waiting and future acquires.
+    void abort();
+    void reset();
+
+    void setCapacity(qint64 capacity, qint64 largeImageLimit);
+
+    qint64 used() const;
+    qint64 capacity() const;
+
+private:
+    qint64 charge(qint64 pixels) const;
+    bool isLarge(qint64 pixels) const;
+
+    mutable QMutex m_mutex;
+    QWaitCondition m_released;
+    qint64 m_capacity;
+    qint64 m_largeImageLimit;
+    qint64 m_used;
+    bool m_isLargeImageDecoding;
+    bool m_isAborted;
+};
+
+// Holds a reservation for the lifetime of a scope.
+class PixelReservation
+{
+public:
+    PixelReservation(PixelBudget* budget, qint64 pixels);
+    ~PixelReservation();
+
+    bool isAcquired() const;
+
+private:
+    PixelReservation(const PixelReservation&);
+    PixelReservation& operator=(const PixelReservation&);
+
+    PixelBudget* m_budget;
+    qint64 m_pixels;
+    bool m_isAcquired;
+};
+
+#endif // PIXELBUDGET_HH
@@ -0,0 +1,207 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include <QtSql>
+
+#include "similarityindex.hh"
+
+// Difference hash: the image is reduced to 9x8 grey levels and each bit
+// tells whether a pixel is brighter than its right neighbour.
+quint64 perceptualHash(const QImage& image)
+{
+    const QImage small(image.scaled(9, 8, Qt::IgnoreAspectRatio,
+                                    Qt::SmoothTransformation)
+                       .convertToFormat(QImage::Format_ARGB32));
+    quint64 hash = 0;
+
+    for (int y = 0; y < 8; ++y) {
+        const QRgb* line = reinterpret_cast<const QRgb*>(small.constScanLine(y));
+        for (int x = 0; x < 8; ++x) {
+            hash <<= 1;
+            if (qGray(line[x]) > qGray(line[x + 1]))
+                hash |= 1;
+        }
+    }
+
+    return hash;
+}
+
+int hammingDistance(const quint64 a, const quint64 b)
+{
+    return __builtin_popcountll(a ^ b);
+}
+
+SimilarityIndex::SimilarityIndex()
+{
+    clear();
+}
+
+bool SimilarityIndex::load(QSqlDatabase db)
+{
+    clear();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT id, phash, thumbnail_file_path FROM Image")) {
+        qWarning() << "failed to load perceptual hashes:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+
+    // Images imported before hashes were stored get theirs from the
+    // cached thumbnail, which is exactly what the import hashes too.
+    QVariantList missingIds;
+    QVariantList missingHashes;
+    while (query.next()) {
+        const qint64 id = query.value(0).toLongLong();
+        if (!query.value(1).isNull()) {
+            insert(id, quint64(query.value(1).toLongLong()));
+            continue;
+        }
+        QImage thumbnail(query.value(2).toString());
+        if (thumbnail.isNull())
+            continue;
+        const quint64 hash = perceptualHash(thumbnail);
+        insert(id, hash);
+        missingIds << id;
+        missingHashes << qint64(hash);
+    }
+
+    if (missingIds.isEmpty())
+        return true;
+
+    db.transaction();
+    QSqlQuery update(db);
+    update.prepare("UPDATE Image SET phash = ? WHERE id = ?");
+    update.addBindValue(missingHashes);
+    update.addBindValue(missingIds);
+    if (!update.execBatch()) {
+        qWarning() << "failed to store perceptual hashes:"
+                   << update.lastError().databaseText();
+        db.rollback();
+        return true;
+    }
+    db.commit();
+
+    return true;
+}
+
+void SimilarityIndex::clear()
+{
+    m_ids.clear();
+    m_hashes.clear();
+    m_entries.clear();
+    for (int i = 0; i < ChunkCount; ++i) {
+        m_buckets[i].clear();
+        m_buckets[i].resize(1 << ChunkBits);
+    }
+}
+
+quint16 SimilarityIndex::chunk(const quint64 hash, const int i)
+{
+    return quint16(hash >> (i * ChunkBits));
+}
+
+void SimilarityIndex::insert(const qint64 id, const quint64 hash)
+{
+    int entry = m_entries.value(id, -1);
+
+    if (entry >= 0) {
+        if (m_hashes[entry] == hash)
+            return;
+        for (int i = 0; i < ChunkCount; ++i) {
+            QVector<int>& bucket = m_buckets[i][chunk(m_hashes[entry], i)];
+            bucket.remove(bucket.indexOf(entry));
+        }
+        m_hashes[entry] = hash;
+    } else {
+        entry = m_ids.size();
+        m_ids.append(id);
+        m_hashes.append(hash);
+        m_entries.insert(id, entry);
+    }
+
+    for (int i = 0; i < ChunkCount; ++i)
+        m_buckets[i][chunk(hash, i)].append(entry);
+}
+
+bool SimilarityIndex::contains(const qint64 id) const
+{
+    return m_entries.contains(id);
+}
+
+quint64 SimilarityIndex::hash(const qint64 id) const
+{
+    const int entry = m_entries.value(id, -1);
+    if (entry < 0)
+        return 0;
+    return m_hashes[entry];
+}
+
+int SimilarityIndex::size() const
+{
+    return m_ids.size();
+}
+
+void SimilarityIndex::probe(const int chunkIndex, const quint16 value,
+                            const int bit, const int errors,
+                            QVector<int>& candidates) const
+{
+    candidates += m_buckets[chunkIndex][value];
+    if (errors == 0)
+        return;
+
+    // Visit every value that differs from the original chunk in at most
+    // 'errors' bits, each combination exactly once.
+    for (int i = bit; i < ChunkBits; ++i)
+        probe(chunkIndex, value ^ quint16(1 << i), i + 1, errors - 1,
+              candidates);
+}
+
+static bool distanceLessThan(const QPair<int, qint64>& a,
+                             const QPair<int, qint64>& b)
+{
+    return a < b;
+}
+
+QList<qint64> SimilarityIndex::find(const quint64 hash, int radius) const
+{
+    radius = qBound(0, radius, int(MaxRadius));
+
+    QVector<int> candidates;
+    for (int i = 0; i < ChunkCount; ++i)
+        probe(i, chunk(hash, i), 0, radius / ChunkCount, candidates);
+
+    std::sort(candidates.begin(), candidates.end());
+    QVector<int>::iterator end = std::unique(candidates.begin(),
+                                             candidates.end());
+
+    QList<QPair<int, qint64> > matches;
+    for (QVector<int>::iterator i = candidates.begin(); i != end; ++i) {
+        const int distance = hammingDistance(hash, m_hashes[*i]);
+        if (distance <= radius)
+            matches.append(qMakePair(distance, m_ids[*i]));
+    }
+    std::sort(matches.begin(), matches.end(), distanceLessThan);
+
+    QList<qint64> ids;
+    for (int i = 0; i < matches.size(); ++i)
+        ids.append(matches[i].second);
+
+    return ids;
+}
@@ -0,0 +1,63 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SIMILARITYINDEX_HH
+#define SIMILARITYINDEX_HH
+
+#include <QtGui>
+#include <QtSql>
+
+quint64 perceptualHash(const QImage& image);
+int hammingDistance(quint64 a, quint64 b);
+
+// Multi-index hashing over 64-bit perceptual hashes. Each hash is split
+// into four 16-bit chunks and every chunk has its own direct-addressed
+// bucket table. By the pigeonhole principle, two hashes within Hamming
+// distance r have at least one chunk within distance r / 4, so a query
+// only needs to probe the few buckets near each of its chunks instead of
+// scanning every hash in the catalog.
+class SimilarityIndex
+{
+public:
+    SimilarityIndex();
+
+    bool load(QSqlDatabase db = QSqlDatabase::database());
+    void clear();
+    void insert(qint64 id, quint64 hash);
+    bool contains(qint64 id) const;
+    quint64 hash(qint64 id) const;
+    int size() const;
+
+    // Returns ids of images within the given Hamming radius, nearest first.
+    QList<qint64> find(quint64 hash, int radius) const;
+
+    static const int MaxRadius = 15;
+
+private:
+    static const int ChunkCount = 4;
+    static const int ChunkBits = 16;
+
+    static quint16 chunk(quint64 hash, int i);
+    void probe(int chunkIndex, quint16 value, int bit, int errors,
+               QVector<int>& candidates) const;
+
+    QVector<qint64> m_ids;
+    QVector<quint64> m_hashes;
+    QHash<qint64, int> m_entries;
+    QVector<QVector<int> > m_buckets[ChunkCount];
+};
+
+#endif // SIMILARITYINDEX_HH
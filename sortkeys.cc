@@ -0,0 +1,274 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <string.h>
+
+#include "catalogsnapshot.hh"
+#include "sortkeys.hh"
+
+// Chunks smaller than this are not worth a thread of their own.
+static const int minChunkSize = 64 * 1024;
+
+// Maps signed values to unsigned keys of the same order.
+static quint64 signedKey(const qint64 value)
+{
+    return quint64(value) ^ (Q_UINT64_C(1) << 63);
+}
+
+static quint64 timeKey(const QDateTime& dateTime)
+{
+    if (!dateTime.isValid())
+        return signedKey(0);
+
+    return signedKey(dateTime.toMSecsSinceEpoch() / 1000);
+}
+
+// One thread's share of a radix sort pass. Counts hold the histogram of
+// the chunk's digits, and then the positions where the chunk's keys of
+// each digit go.
+struct RadixChunk
+{
+    const quint64* keys;
+    const int* index;
+    quint64* sortedKeys;
+    int* sortedIndex;
+    int begin;
+    int end;
+    int shift;
+    int* counts;
+};
+
+static void countDigits(RadixChunk& chunk)
+{
+    memset(chunk.counts, 0, 256 * sizeof(int));
+    for (int i = chunk.begin; i < chunk.end; ++i)
+        ++chunk.counts[(chunk.keys[i] >> chunk.shift) & 0xff];
+}
+
+static void scatterDigits(RadixChunk& chunk)
+{
+    for (int i = chunk.begin; i < chunk.end; ++i) {
+        const int position = chunk.counts[(chunk.keys[i] >> chunk.shift)
+                                          & 0xff]++;
+        chunk.sortedKeys[position] = chunk.keys[i];
+        chunk.sortedIndex[position] = chunk.index[i];
+    }
+}
+
+static void forEachChunk(QVector<RadixChunk>& chunks,
+                         void (*function)(RadixChunk&))
+{
+    if (chunks.size() == 1)
+        function(chunks[0]);
+    else
+        QtConcurrent::blockingMap(chunks, function);
+}
+
+// Stable sort of the keys, permuting the index along. Every pass sorts by
+// one byte, chunks of the keys are counted and scattered in parallel and
+// chunk order keeps equal keys in their order. Passes over a byte which
+// is the same in every key are skipped.
+static void radixSort(QVector<quint64>& keys, QVector<int>& index)
+{
+    const int n = keys.size();
+    if (n < 2)
+        return;
+
+    const int chunkCount = qBound(1, n / minChunkSize,
+                                  QThread::idealThreadCount());
+    QVector<quint64> keyBuffer(n);
+    QVector<int> indexBuffer(n);
+    QVector<int> counts(chunkCount * 256);
+    QVector<RadixChunk> chunks(chunkCount);
+
+    QVector<quint64>* from = &keys;
+    QVector<quint64>* to = &keyBuffer;
+    QVector<int>* fromIndex = &index;
+    QVector<int>* toIndex = &indexBuffer;
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        for (int t = 0; t < chunkCount; ++t) {
+            RadixChunk& chunk = chunks[t];
+            chunk.keys = from->constData();
+            chunk.index = fromIndex->constData();
+            chunk.sortedKeys = to->data();
+            chunk.sortedIndex = toIndex->data();
+            chunk.begin = qint64(n) * t / chunkCount;
+            chunk.end = qint64(n) * (t + 1) / chunkCount;
+            chunk.shift = shift;
+            chunk.counts = counts.data() + t * 256;
+        }
+        forEachChunk(chunks, countDigits);
+
+        bool isUniform = false;
+        int position = 0;
+        for (int digit = 0; digit < 256; ++digit) {
+            int total = 0;
+            for (int t = 0; t < chunkCount; ++t) {
+                const int count = counts[t * 256 + digit];
+                counts[t * 256 + digit] = position;
+                position += count;
+                total += count;
+            }
+            if (total == n)
+                isUniform = true;
+        }
+        if (isUniform)
+            continue;
+
+        forEachChunk(chunks, scatterDigits);
+        qSwap(from, to);
+        qSwap(fromIndex, toIndex);
+    }
+
+    if (from != &keys) {
+        keys = *from;
+        index = *fromIndex;
+    }
+}
+
+SortKeys::SortKeys()
+    :m_isLoaded(false)
+    ,m_ids()
+{
+}
+
+bool SortKeys::load(QSqlDatabase db)
+{
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+
+    // Rows come in path order, the row number is the path rank.
+    if (!query.exec("SELECT id,"
+                    "  COALESCE(CAST(strftime('%s', exif_datetime)"
+                    "                AS INTEGER), 0),"
+                    "  COALESCE(CAST(strftime('%s', mtime) AS INTEGER), 0),"
+                    "  file_size, pixel_width * pixel_height"
+                    " FROM Image ORDER BY file_path")) {
+        qWarning() << "failed to load sort keys:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+
+    m_ids.clear();
+    for (int i = 0; i < KeyCount; ++i)
+        m_keys[i].clear();
+
+    while (query.next()) {
+        m_keys[PathKey].append(quint64(m_ids.size()));
+        m_ids.append(query.value(0).toLongLong());
+        m_keys[CaptureTimeKey].append(signedKey(query.value(1).toLongLong()));
+        m_keys[ModificationTimeKey].append(
+            signedKey(query.value(2).toLongLong()));
+        m_keys[FileSizeKey].append(quint64(query.value(3).toLongLong()));
+        m_keys[PixelCountKey].append(quint64(query.value(4).toLongLong()));
+    }
+    m_isLoaded = true;
+
+    return true;
+}
+
+void SortKeys::load(const CatalogSnapshot& snapshot)
+{
+    const int n = snapshot.size();
+
+    m_ids.resize(n);
+    for (int i = 0; i < KeyCount; ++i)
+        m_keys[i].resize(n);
+
+    for (int i = 0; i < n; ++i) {
+        const CatalogSnapshot::Record& record = snapshot.at(i);
+        m_ids[i] = record.id;
+        m_keys[PathKey][i] = quint64(i);
+        m_keys[CaptureTimeKey][i] = signedKey(record.captureTime);
+        m_keys[ModificationTimeKey][i] = signedKey(record.modificationTime);
+        m_keys[FileSizeKey][i] = quint64(record.fileSize);
+        m_keys[PixelCountKey][i] = quint64(record.pixelWidth)
+            * quint64(record.pixelHeight);
+    }
+    m_isLoaded = true;
+}
+
+bool SortKeys::isLoaded() const
+{
+    return m_isLoaded;
+}
+
+int SortKeys::size() const
+{
+    return m_ids.size();
+}
+
+void SortKeys::append(const qint64 id, const QDateTime& captureTime,
+                      const QDateTime& modificationTime,
+                      const qint64 fileSize, const QSize& pixelSize)
+{
+    m_keys[PathKey].append(quint64(m_ids.size()));
+    m_ids.append(id);
+    m_keys[CaptureTimeKey].append(timeKey(captureTime));
+    m_keys[ModificationTimeKey].append(timeKey(modificationTime));
+    m_keys[FileSizeKey].append(quint64(fileSize));
+    m_keys[PixelCountKey].append(
+        quint64(pixelSize.width()) * quint64(pixelSize.height()));
+}
+
+QVector<qint64> SortKeys::sorted(const QList<Criterion>& criteria) const
+{
+    const int n = m_ids.size();
+    QVector<int> index(n);
+    QVector<quint64> keys(n);
+
+    const bool isDescending = !criteria.isEmpty()
+        && criteria.first().order == Qt::DescendingOrder;
+    for (int i = 0; i < n; ++i) {
+        index[i] = i;
+        keys[i] = isDescending ? ~quint64(m_ids[i]) : quint64(m_ids[i]);
+    }
+    radixSort(keys, index);
+
+    for (int c = criteria.size() - 1; c >= 0; --c) {
+        const QVector<quint64>& values = m_keys[criteria[c].key];
+        const bool isDescending = criteria[c].order == Qt::DescendingOrder;
+        for (int i = 0; i < n; ++i) {
+            keys[i] = isDescending ? ~values[index[i]] : values[index[i]];
+        }
+        radixSort(keys, index);
+    }
+
+    QVector<qint64> ids(n);
+    for (int i = 0; i < n; ++i)
+        ids[i] = m_ids[index[i]];
+
+    return ids;
+}
+
+int SortKeys::column(const Key key)
+{
+    switch (key) {
+    case CaptureTimeKey:
+        return 6;
+    case ModificationTimeKey:
+        return 3;
+    case FileSizeKey:
+        return 2;
+    case PathKey:
+        return 1;
+    case PixelCountKey:
+        return 4;
+    default:
+        return 0;
+    }
+}
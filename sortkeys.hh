@@ -0,0 +1,87 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SORTKEYS_HH
+#define SORTKEYS_HH
+
+#include <QtSql>
+
+class CatalogSnapshot;
+
+// Packed integer sort keys of every catalogued image, for sorting the
+// grid in memory instead of asking the database for a new order. Keys are
+// unsigned 64-bit integers whose order is the order of the values they
+// stand for; file paths are represented by their rank in path order.
+//
+// Sorting is a parallel LSD radix sort, one stable sort per key from the
+// least significant key to the most significant, permuting an index of
+// the images rather than the keys of all of them.
+class SortKeys
+{
+public:
+    enum Key {
+        CaptureTimeKey,
+        ModificationTimeKey,
+        FileSizeKey,
+        PathKey,
+        PixelCountKey,
+        KeyCount
+    };
+
+    struct Criterion
+    {
+        Criterion(Key k = CaptureTimeKey,
+                  Qt::SortOrder o = Qt::AscendingOrder)
+            :key(k)
+            ,order(o)
+        {
+        }
+
+        Key key;
+        Qt::SortOrder order;
+    };
+
+    SortKeys();
+
+    bool load(QSqlDatabase db = QSqlDatabase::database());
+    // Loads the keys from a catalog snapshot, whose records are in path
+    // order like the rows loaded from the database.
+    void load(const CatalogSnapshot& snapshot);
+    bool isLoaded() const;
+    int size() const;
+
+    // Adds the keys of a newly catalogued image. Its path rank is not
+    // known before the keys are loaded again, until then the image sorts
+    // after the others by path.
+    void append(qint64 id, const QDateTime& captureTime,
+                const QDateTime& modificationTime, qint64 fileSize,
+                const QSize& pixelSize);
+
+    // Image ids ordered by the criteria, the first criterion being the
+    // most significant. Images equal by every criterion are ordered by
+    // id, in the order of the first criterion.
+    QVector<qint64> sorted(const QList<Criterion>& criteria) const;
+
+    // Column of the Image table the key is derived from.
+    static int column(Key key);
+
+private:
+    bool m_isLoaded;
+    QVector<qint64> m_ids;
+    QVector<quint64> m_keys[KeyCount];
+};
+
+#endif // SORTKEYS_HH
@@ -17,7 +17,36 @@ SOURCES +=\
     imageview.cc \
     metadata.cc \
     common.cc \
-    imageitemdelegate.cc
+    imageitemdelegate.cc \
+    similarityindex.cc \
+    orientedscale.cc \
+    bitmap.cc \
+    tagindex.cc \
+    facetindex.cc \
+    tagcompleter.cc \
+    tagdialog.cc \
+    imagemodel.cc \
+    textsearch.cc \
+    locationsearch.cc \
+    timeline.cc \
+    timelinewidget.cc \
+    facetwidget.cc \
+    importer.cc \
+    pipeline.cc \
+    exporter.cc \
+    exportdialog.cc \
+    filestatus.cc \
+    iolocality.cc \
+    filereader.cc \
+    pixelbudget.cc \
+    bulktagger.cc \
+    batchrotator.cc \
+    catalogservice.cc \
+    catalogsnapshot.cc \
+    library.cc \
+    sortkeys.cc \
+    startup.cc \
+    benchmark.cc
 
 HEADERS  += \
     imagelistview.hh \
@@ -26,7 +55,37 @@ HEADERS  += \
     imageview.hh \
     metadata.hh \
     common.hh \
-    imageitemdelegate.hh
+    imageitemdelegate.hh \
+    similarityindex.hh \
+    orientedscale.hh \
+    bitmap.hh \
+    tagindex.hh \
+    facetindex.hh \
+    tagcompleter.hh \
+    tagdialog.hh \
+    imagemodel.hh \
+    textsearch.hh \
+    locationsearch.hh \
+    timeline.hh \
+    timelinewidget.hh \
+    facetwidget.hh \
+    boundedqueue.hh \
+    pipeline.hh \
+    importer.hh \
+    exporter.hh \
+    exportdialog.hh \
+    filestatus.hh \
+    iolocality.hh \
+    filereader.hh \
+    pixelbudget.hh \
+    bulktagger.hh \
+    batchrotator.hh \
+    catalogservice.hh \
+    catalogsnapshot.hh \
+    library.hh \
+    sortkeys.hh \
+    startup.hh \
+    benchmark.hh
 
 FORMS    +=
 
@@ -46,4 +105,10 @@ INSTALLS += sqim
 
 LIBS += -lexiv2
 
+# Asynchronous import reads, enabled with qmake CONFIG+=io_uring.
+io_uring {
+    DEFINES += SQIM_HAVE_IO_URING
+    LIBS += -luring
+}
+
 RESOURCES += icons.qrc application.qrc
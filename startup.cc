@@ -0,0 +1,43 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "startup.hh"
+
+static QElapsedTimer startupClock;
+static QList<QPair<QString, qint64> > startupMilestones;
+
+void startStartupClock()
+{
+    startupClock.start();
+    startupMilestones.clear();
+}
+
+void markStartupMilestone(const QString& name)
+{
+    if (!startupClock.isValid())
+        return;
+
+    startupMilestones.append(qMakePair(name, startupClock.elapsed()));
+}
+
+void printStartupMilestones(QTextStream& out)
+{
+    typedef QPair<QString, qint64> Milestone;
+
+    foreach (Milestone milestone, startupMilestones) {
+        out << milestone.second << " ms\t" << milestone.first << endl;
+    }
+}
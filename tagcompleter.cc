@@ -0,0 +1,71 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "tagcompleter.hh"
+
+// More candidates than fit in the popup are not useful.
+static const int maxCompletions = 50;
+
+TagCompleter::TagCompleter(const TagIndex* tagIndex, QLineEdit* lineEdit)
+    :QCompleter(lineEdit)
+    ,m_tagIndex(tagIndex)
+    ,m_lineEdit(lineEdit)
+    ,m_model(new QStringListModel(this))
+{
+    setModel(m_model);
+    setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    lineEdit->setCompleter(this);
+
+    connect(lineEdit, SIGNAL(textEdited(const QString&)),
+            SLOT(updateCompletions(const QString&)));
+}
+
+// The chosen tag replaces the last word, keeping what precedes it.
+QString TagCompleter::pathFromIndex(const QModelIndex& index) const
+{
+    const QString text(m_lineEdit->text());
+
+    return text.left(lastWordStart(text)) + index.data().toString();
+}
+
+QStringList TagCompleter::splitPath(const QString& path) const
+{
+    return QStringList(path.mid(lastWordStart(path)));
+}
+
+void TagCompleter::updateCompletions(const QString& text)
+{
+    const QString prefix(text.mid(lastWordStart(text)));
+
+    if (prefix.isEmpty()) {
+        m_model->setStringList(QStringList());
+        return;
+    }
+    m_model->setStringList(m_tagIndex->completions(prefix, maxCompletions));
+}
+
+// Words are separated by white space, parentheses and quotes, like the
+// terms of a tag query.
+int TagCompleter::lastWordStart(const QString& text)
+{
+    int i = text.size();
+
+    while (i > 0 && !text[i - 1].isSpace() && text[i - 1] != '('
+           && text[i - 1] != ')' && text[i - 1] != '"')
+        --i;
+
+    return i;
+}
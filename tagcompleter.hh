@@ -0,0 +1,48 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TAGCOMPLETER_HH
+#define TAGCOMPLETER_HH
+
+#include <QtGui>
+
+#include "tagindex.hh"
+
+// Completes the word under construction at the end of a line edit with
+// the tags it is a prefix of. Candidates come from the prefix index of a
+// TagIndex instead of filtering a model of every tag.
+class TagCompleter : public QCompleter
+{
+    Q_OBJECT
+
+public:
+    TagCompleter(const TagIndex* tagIndex, QLineEdit* lineEdit);
+
+    virtual QString pathFromIndex(const QModelIndex& index) const;
+    virtual QStringList splitPath(const QString& path) const;
+
+private slots:
+    void updateCompletions(const QString& text);
+
+private:
+    static int lastWordStart(const QString& text);
+
+    const TagIndex* m_tagIndex;
+    QLineEdit* m_lineEdit;
+    QStringListModel* m_model;
+};
+
+#endif // TAGCOMPLETER_HH
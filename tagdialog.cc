@@ -0,0 +1,42 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include "tagcompleter.hh"
+#include "tagdialog.hh"
+
+TagDialog::TagDialog(const TagIndex* const tagIndex, QWidget* const parent)
+    :QDialog(parent)
+    ,m_tagEdit(new QLineEdit(this))
+{
+    setWindowTitle("Add tag to selected images");
+
+    new TagCompleter(tagIndex, m_tagEdit);
+
+    QDialogButtonBox* buttonBox = new QDialogButtonBox(
+        QDialogButtonBox::Ok | QDialogButtonBox::Cancel, Qt::Horizontal,
+        this);
+    connect(buttonBox, SIGNAL(accepted()), SLOT(accept()));
+    connect(buttonBox, SIGNAL(rejected()), SLOT(reject()));
+
+    QFormLayout* layout = new QFormLayout(this);
+    layout->addRow("&Tag", m_tagEdit);
+    layout->addRow(buttonBox);
+}
+
+QString TagDialog::tag() const
+{
+    return m_tagEdit->text().trimmed();
+}
@@ -0,0 +1,402 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <algorithm>
+
+#include <QtSql>
+
+#include "tagindex.hh"
+
+struct Token
+{
+    enum Type { Tag, And, Or, Not, Open, Close, End };
+
+    Token(Type t = End, const QString& s = QString()) : type(t), text(s) {}
+
+    Type type;
+    QString text;
+};
+
+static bool tokenize(const QString& query, QList<Token>& tokens,
+                     QString* errorString)
+{
+    int i = 0;
+
+    while (i < query.size()) {
+        const QChar c = query[i];
+        if (c.isSpace()) {
+            ++i;
+        } else if (c == '(') {
+            tokens.append(Token(Token::Open));
+            ++i;
+        } else if (c == ')') {
+            tokens.append(Token(Token::Close));
+            ++i;
+        } else if (c == '"') {
+            const int end = query.indexOf('"', i + 1);
+            if (end < 0) {
+                *errorString = "unterminated quote";
+                return false;
+            }
+            tokens.append(Token(Token::Tag, query.mid(i + 1, end - i - 1)));
+            i = end + 1;
+        } else {
+            int end = i;
+            while (end < query.size() && !query[end].isSpace()
+                   && query[end] != '(' && query[end] != ')'
+                   && query[end] != '"')
+                ++end;
+            const QString word = query.mid(i, end - i);
+            const QString keyword = word.toUpper();
+            if (keyword == "AND")
+                tokens.append(Token(Token::And));
+            else if (keyword == "OR")
+                tokens.append(Token(Token::Or));
+            else if (keyword == "NOT")
+                tokens.append(Token(Token::Not));
+            else
+                tokens.append(Token(Token::Tag, word));
+            i = end;
+        }
+    }
+
+    tokens.append(Token(Token::End));
+    return true;
+}
+
+// Recursive descent parser which evaluates the query while parsing it:
+//
+//   expr  := term (OR term)*
+//   term  := factor ([AND] factor)*
+//   factor := NOT factor | '(' expr ')' | TAG
+class TagIndex::Parser
+{
+public:
+    Parser(const TagIndex& index, const QList<Token>& tokens)
+        :m_index(index)
+        ,m_tokens(tokens)
+        ,m_position(0)
+    {
+    }
+
+    bool parse(Bitmap& result, QString* errorString)
+    {
+        if (!expr(result, errorString))
+            return false;
+        if (peek().type != Token::End) {
+            *errorString = "unexpected ')'";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    const Token& peek() const
+    {
+        return m_tokens[m_position];
+    }
+
+    bool expr(Bitmap& result, QString* errorString)
+    {
+        if (!term(result, errorString))
+            return false;
+
+        while (peek().type == Token::Or) {
+            ++m_position;
+            Bitmap right;
+            if (!term(right, errorString))
+                return false;
+            result |= right;
+        }
+        return true;
+    }
+
+    bool term(Bitmap& result, QString* errorString)
+    {
+        if (!factor(result, errorString))
+            return false;
+
+        for (;;) {
+            const Token::Type type = peek().type;
+            if (type == Token::And) {
+                ++m_position;
+            } else if (type != Token::Tag && type != Token::Not
+                       && type != Token::Open) {
+                return true;
+            }
+            Bitmap right;
+            if (!factor(right, errorString))
+                return false;
+            result &= right;
+        }
+    }
+
+    bool factor(Bitmap& result, QString* errorString)
+    {
+        const Token token = peek();
+
+        switch (token.type) {
+        case Token::Not:
+            ++m_position;
+            if (!factor(result, errorString))
+                return false;
+            result = m_index.allImages() - result;
+            return true;
+        case Token::Open:
+            ++m_position;
+            if (!expr(result, errorString))
+                return false;
+            if (peek().type != Token::Close) {
+                *errorString = "missing ')'";
+                return false;
+            }
+            ++m_position;
+            return true;
+        case Token::Tag:
+            ++m_position;
+            result = m_index.images(token.text);
+            return true;
+        default:
+            *errorString = "expected a tag";
+            return false;
+        }
+    }
+
+    const TagIndex& m_index;
+    const QList<Token>& m_tokens;
+    int m_position;
+};
+
+// Orders tag ids by tag name, and tag ids against a plain name for
+// binary searches.
+class TagIndex::TagNameLess
+{
+public:
+    explicit TagNameLess(const QVector<QString>& names)
+        :m_names(names)
+    {
+    }
+
+    bool operator()(const int a, const int b) const
+    {
+        return m_names[a] < m_names[b];
+    }
+
+    bool operator()(const int a, const QString& b) const
+    {
+        return m_names[a] < b;
+    }
+
+private:
+    const QVector<QString>& m_names;
+};
+
+TagIndex::TagIndex()
+    :m_allImages()
+    ,m_tagIds()
+    ,m_tagNames()
+    ,m_tagImages()
+    ,m_imageTags()
+    ,m_sortedTagIds()
+    ,m_isSorted(true)
+{
+}
+
+bool TagIndex::load(QSqlDatabase db)
+{
+    clear();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT id FROM Image")) {
+        qWarning() << "failed to load image ids:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+    while (query.next())
+        m_allImages.add(query.value(0).toUInt());
+
+    if (!query.exec("SELECT Image.id, Tagging.tag FROM Tagging "
+                    "JOIN Image ON Image.file_path = Tagging.file_path")) {
+        qWarning() << "failed to load tags:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+    while (query.next()) {
+        const quint32 id = query.value(0).toUInt();
+        const int tagId = internTag(query.value(1).toString());
+        m_tagImages[tagId].add(id);
+        m_imageTags[id].append(tagId);
+    }
+
+    return true;
+}
+
+void TagIndex::clear()
+{
+    m_allImages.clear();
+    m_tagIds.clear();
+    m_tagNames.clear();
+    m_tagImages.clear();
+    m_imageTags.clear();
+    m_sortedTagIds.clear();
+    m_isSorted = true;
+}
+
+void TagIndex::addImage(const qint64 id)
+{
+    m_allImages.add(quint32(id));
+}
+
+void TagIndex::addTag(const qint64 id, const QString& tag)
+{
+    const int tagId = internTag(tag);
+
+    if (m_tagImages[tagId].contains(quint32(id)))
+        return;
+    m_tagImages[tagId].add(quint32(id));
+    m_imageTags[quint32(id)].append(tagId);
+}
+
+void TagIndex::addTag(const Bitmap& ids, const QString& tag)
+{
+    const int tagId = internTag(tag);
+    const Bitmap added(ids - m_tagImages[tagId]);
+
+    m_tagImages[tagId] |= added;
+    foreach (quint32 id, added.values()) {
+        m_imageTags[id].append(tagId);
+    }
+}
+
+void TagIndex::removeTag(const qint64 id, const QString& tag)
+{
+    const int tagId = m_tagIds.value(tag, -1);
+    if (tagId < 0)
+        return;
+
+    m_tagImages[tagId].remove(quint32(id));
+
+    QHash<quint32, QVector<int> >::iterator i
+        = m_imageTags.find(quint32(id));
+    if (i == m_imageTags.end())
+        return;
+    const int position = i.value().indexOf(tagId);
+    if (position >= 0)
+        i.value().remove(position);
+    if (i.value().isEmpty())
+        m_imageTags.erase(i);
+}
+
+const Bitmap& TagIndex::allImages() const
+{
+    return m_allImages;
+}
+
+const Bitmap& TagIndex::images(const QString& tag) const
+{
+    static const Bitmap noImages;
+
+    const int tagId = m_tagIds.value(tag, -1);
+    if (tagId < 0)
+        return noImages;
+
+    return m_tagImages[tagId];
+}
+
+QStringList TagIndex::tags() const
+{
+    QStringList result;
+
+    sortTags();
+    foreach (int tagId, m_sortedTagIds) {
+        if (!m_tagImages[tagId].isEmpty())
+            result << m_tagNames[tagId];
+    }
+
+    return result;
+}
+
+QStringList TagIndex::tags(const qint64 id) const
+{
+    QStringList result;
+
+    foreach (int tagId, m_imageTags.value(quint32(id))) {
+        result << m_tagNames[tagId];
+    }
+    result.sort();
+
+    return result;
+}
+
+QStringList TagIndex::completions(const QString& prefix,
+                                  const int maxCount) const
+{
+    QStringList result;
+
+    sortTags();
+    QVector<int>::const_iterator i = std::lower_bound(
+        m_sortedTagIds.constBegin(), m_sortedTagIds.constEnd(), prefix,
+        TagNameLess(m_tagNames));
+    for (; i != m_sortedTagIds.constEnd() && result.size() < maxCount; ++i) {
+        if (!m_tagNames[*i].startsWith(prefix))
+            break;
+        if (!m_tagImages[*i].isEmpty())
+            result << m_tagNames[*i];
+    }
+
+    return result;
+}
+
+// Tags which lose their last image keep their id, so that ids held by
+// images never dangle; they are skipped when listing tags.
+int TagIndex::internTag(const QString& tag)
+{
+    QHash<QString, int>::const_iterator i = m_tagIds.constFind(tag);
+    if (i != m_tagIds.constEnd())
+        return i.value();
+
+    const int tagId = m_tagNames.size();
+    m_tagIds.insert(tag, tagId);
+    m_tagNames.append(tag);
+    m_tagImages.append(Bitmap());
+    m_sortedTagIds.append(tagId);
+    m_isSorted = false;
+
+    return tagId;
+}
+
+void TagIndex::sortTags() const
+{
+    if (m_isSorted)
+        return;
+
+    std::sort(m_sortedTagIds.begin(), m_sortedTagIds.end(),
+              TagNameLess(m_tagNames));
+    m_isSorted = true;
+}
+
+bool TagIndex::evaluate(const QString& query, Bitmap* result,
+                        QString* errorString) const
+{
+    QList<Token> tokens;
+
+    if (!tokenize(query, tokens, errorString))
+        return false;
+
+    Parser parser(*this, tokens);
+    return parser.parse(*result, errorString);
+}
@@ -0,0 +1,79 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TAGINDEX_HH
+#define TAGINDEX_HH
+
+#include <QtCore>
+#include <QtSql>
+
+#include "bitmap.hh"
+
+// In-memory index from tags to the ids of the images carrying them, one
+// bitmap per tag. Tags are interned to small integer ids; each image keeps
+// the ids of its tags and the distinct tags are kept sorted for prefix
+// lookups, so showing or completing tags never needs the database.
+class TagIndex
+{
+public:
+    TagIndex();
+
+    bool load(QSqlDatabase db = QSqlDatabase::database());
+    void clear();
+    void addImage(qint64 id);
+    void addTag(qint64 id, const QString& tag);
+    void addTag(const Bitmap& ids, const QString& tag);
+    void removeTag(qint64 id, const QString& tag);
+
+    const Bitmap& allImages() const;
+    // Images carrying the tag, empty if no image carries it.
+    const Bitmap& images(const QString& tag) const;
+
+    // Distinct tags carried by at least one image, in sorted order.
+    QStringList tags() const;
+    // Tags of the given image in sorted order.
+    QStringList tags(qint64 id) const;
+    // At most maxCount tags starting with the given prefix, in sorted
+    // order.
+    QStringList completions(const QString& prefix, int maxCount) const;
+
+    // Evaluates a boolean tag query such as 'family AND 2019 AND NOT
+    // blurry'. Operators are AND, OR and NOT (case insensitive), terms
+    // next to each other are ANDed, parentheses group and double quotes
+    // protect tags containing spaces or operator names. Returns false and
+    // sets errorString if the query is malformed.
+    bool evaluate(const QString& query, Bitmap* result,
+                  QString* errorString) const;
+
+private:
+    class Parser;
+    class TagNameLess;
+
+    int internTag(const QString& tag);
+    void sortTags() const;
+
+    Bitmap m_allImages;
+    QHash<QString, int> m_tagIds;
+    QVector<QString> m_tagNames;
+    QVector<Bitmap> m_tagImages;
+    QHash<quint32, QVector<int> > m_imageTags;
+
+    // Tag ids ordered by name, rebuilt when a new tag has been interned.
+    mutable QVector<int> m_sortedTagIds;
+    mutable bool m_isSorted;
+};
+
+#endif // TAGINDEX_HH
@@ -0,0 +1,51 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QtTest>
+
+#include "../bitmap.hh"
+
+class BitmapTest : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void intersectArrayWithSmallerBitset();
+};
+
+// Removing members keeps a chunk a bitset down to ArrayMin members, so an
+// array chunk can have more members than the bitset it is intersected
+// with.
+void BitmapTest::intersectArrayWithSmallerBitset()
+{
+    Bitmap array;
+    array.addRange(0, 2999);
+
+    Bitmap bitset;
+    bitset.addRange(0, 4999);
+    for (quint32 i = 0; i < 2500; ++i)
+        bitset.remove(i);
+    QCOMPARE(bitset.count(), 2500);
+
+    QCOMPARE(array.intersectionCount(bitset), 500);
+    QCOMPARE(bitset.intersectionCount(array), 500);
+    QCOMPARE((array & bitset).count(), 500);
+    QCOMPARE((bitset & array).count(), 500);
+}
+
+QTEST_APPLESS_MAIN(BitmapTest)
+
+#include "bitmaptest.moc"
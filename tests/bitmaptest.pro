@@ -0,0 +1,13 @@
+QT       += core testlib
+QT       -= gui
+
+TARGET = bitmaptest
+TEMPLATE = app
+CONFIG += console testcase
+
+SOURCES += \
+    bitmaptest.cc \
+    ../bitmap.cc
+
+HEADERS += \
+    ../bitmap.hh
@@ -0,0 +1,99 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QtSql>
+
+#include "library.hh"
+#include "textsearch.hh"
+
+bool updateSearchText(const qint64 imageId)
+{
+    return updateSearchText(imageId, imageId);
+}
+
+bool updateSearchText(const qint64 firstId, const qint64 lastId,
+                      QSqlDatabase db)
+{
+    QSqlQuery query(db);
+
+    query.prepare("DELETE FROM ImageText WHERE rowid BETWEEN ? AND ?");
+    query.addBindValue(firstId);
+    query.addBindValue(lastId);
+    if (!query.exec()) {
+        qWarning() << "failed to remove search text:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+
+    query.prepare("INSERT INTO ImageText(rowid, path, tags, exif)"
+                  "  SELECT id, file_path,"
+                  "    COALESCE((SELECT group_concat(tag, ' ')"
+                  "              FROM Tagging"
+                  "              WHERE Tagging.file_path = Image.file_path),"
+                  "             ''),"
+                  "    exif_datetime"
+                  "    || ' ' || COALESCE(camera_make, '')"
+                  "    || ' ' || COALESCE(camera_model, '')"
+                  "    || ' ' || COALESCE(lens_model, '')"
+                  "  FROM Image WHERE id BETWEEN ? AND ?");
+    query.addBindValue(firstId);
+    query.addBindValue(lastId);
+    if (!query.exec()) {
+        qWarning() << "failed to insert search text:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+
+    return true;
+}
+
+bool searchImages(const QString& text, Bitmap* result, QSqlDatabase db)
+{
+    // Every word becomes a quoted prefix query, so that characters which
+    // are special in the match syntax are searched for literally.
+    const QStringList words(text.split(QRegExp("\\W+"),
+                                       QString::SkipEmptyParts));
+    QStringList terms;
+    foreach (QString word, words) {
+        terms << QString("\"%1\"*").arg(word);
+    }
+
+    result->clear();
+    if (terms.isEmpty())
+        return true;
+
+    // Full-text tables cannot be matched through a view, so the libraries
+    // of a federated catalog are searched one by one.
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    for (int i = 0; i < libraries().size(); ++i) {
+        query.prepare(QString("SELECT rowid FROM %1.ImageText"
+                              "  WHERE ImageText MATCH ?")
+                      .arg(librarySchema(i)));
+        query.addBindValue(terms.join(" "));
+        if (!query.exec()) {
+            qWarning() << "failed to search images:"
+                       << query.lastError().databaseText();
+            return false;
+        }
+        while (query.next()) {
+            result->add(quint32(globalImageId(
+                                    i, query.value(0).toLongLong())));
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,38 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TEXTSEARCH_HH
+#define TEXTSEARCH_HH
+
+#include <QtSql>
+
+#include "bitmap.hh"
+
+// Full-text index over image file paths, tags and textual EXIF fields,
+// kept in the ImageText table. It must be updated in the same transaction
+// as the rows it describes.
+bool updateSearchText(qint64 imageId);
+// Updates the images with ids between the given ids in one statement,
+// through the given connection.
+bool updateSearchText(qint64 firstId, qint64 lastId,
+                      QSqlDatabase db = QSqlDatabase::database());
+
+// Finds images whose indexed text contains words starting with every word
+// of the given text.
+bool searchImages(const QString& text, Bitmap* result,
+                  QSqlDatabase db = QSqlDatabase::database());
+
+#endif // TEXTSEARCH_HH
@@ -0,0 +1,122 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <QtSql>
+
+#include "timeline.hh"
+
+// Days are counted from 1900-01-01, dates outside the covered 2^17 days
+// are clamped to its ends.
+static const int timelineDays = 1 << 17;
+
+static int firstJulianDay()
+{
+    return QDate(1900, 1, 1).toJulianDay();
+}
+
+Timeline::Timeline()
+    :m_tree()
+    ,m_total(0)
+    ,m_firstDay(-1)
+    ,m_lastDay(-1)
+{
+    clear();
+}
+
+bool Timeline::load(QSqlDatabase db)
+{
+    clear();
+
+    QSqlQuery query(db);
+    query.setForwardOnly(true);
+    if (!query.exec("SELECT day, count FROM Timeline WHERE count > 0")) {
+        qWarning() << "failed to load the timeline:"
+                   << query.lastError().databaseText();
+        return false;
+    }
+    while (query.next())
+        add(QDate::fromJulianDay(query.value(0).toInt()),
+            query.value(1).toInt());
+
+    return true;
+}
+
+void Timeline::clear()
+{
+    m_tree.fill(0, timelineDays + 1);
+    m_total = 0;
+    m_firstDay = -1;
+    m_lastDay = -1;
+}
+
+int Timeline::dayIndex(const QDate& date) const
+{
+    return qBound(0, int(date.toJulianDay() - firstJulianDay()),
+                  timelineDays - 1);
+}
+
+void Timeline::add(const QDate& date, const int count)
+{
+    const int day = dayIndex(date);
+
+    for (int i = day + 1; i <= timelineDays; i += i & -i)
+        m_tree[i] += count;
+    m_total += count;
+
+    if (m_firstDay < 0 || day < m_firstDay)
+        m_firstDay = day;
+    if (day > m_lastDay)
+        m_lastDay = day;
+}
+
+// Sum of the counts of the first 'index' days.
+int Timeline::prefixSum(int index) const
+{
+    int sum = 0;
+
+    for (; index > 0; index -= index & -index)
+        sum += m_tree[index];
+    return sum;
+}
+
+int Timeline::total() const
+{
+    return m_total;
+}
+
+int Timeline::countBefore(const QDate& date) const
+{
+    return prefixSum(dayIndex(date));
+}
+
+int Timeline::count(const QDate& first, const QDate& last) const
+{
+    return prefixSum(dayIndex(last) + 1) - prefixSum(dayIndex(first));
+}
+
+QDate Timeline::firstDate() const
+{
+    if (m_firstDay < 0)
+        return QDate();
+    return QDate::fromJulianDay(firstJulianDay() + m_firstDay);
+}
+
+QDate Timeline::lastDate() const
+{
+    if (m_lastDay < 0)
+        return QDate();
+    return QDate::fromJulianDay(firstJulianDay() + m_lastDay);
+}
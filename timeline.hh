@@ -0,0 +1,52 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TIMELINE_HH
+#define TIMELINE_HH
+
+#include <QtCore>
+#include <QtSql>
+
+// Image counts per capture day. The counts are kept in a Fenwick tree, so
+// both updating a day and counting the images before any day take
+// logarithmic time. With the images sorted by capture time, the number of
+// images before a day is the row where that day starts.
+class Timeline
+{
+public:
+    Timeline();
+
+    bool load(QSqlDatabase db = QSqlDatabase::database());
+    void clear();
+    void add(const QDate& date, int count = 1);
+
+    int total() const;
+    int countBefore(const QDate& date) const;
+    int count(const QDate& first, const QDate& last) const;
+    QDate firstDate() const;
+    QDate lastDate() const;
+
+private:
+    int dayIndex(const QDate& date) const;
+    int prefixSum(int index) const;
+
+    QVector<int> m_tree;
+    int m_total;
+    int m_firstDay;
+    int m_lastDay;
+};
+
+#endif // TIMELINE_HH
@@ -0,0 +1,166 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#include <cmath>
+
+#include "timelinewidget.hh"
+
+TimelineWidget::TimelineWidget(const Timeline* timeline, QWidget* parent)
+    :QWidget(parent)
+    ,m_timeline(timeline)
+    ,m_binStarts()
+    ,m_binCounts()
+    ,m_yearly(false)
+{
+    setMouseTracking(true);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+}
+
+QSize TimelineWidget::sizeHint() const
+{
+    return QSize(400, 32);
+}
+
+void TimelineWidget::updateBins()
+{
+    m_binStarts.clear();
+    m_binCounts.clear();
+
+    const QDate first(m_timeline->firstDate());
+    const QDate last(m_timeline->lastDate());
+    if (!first.isValid())
+        return;
+
+    m_yearly = last.year() - first.year() > 40;
+
+    QDate start(first.year(), m_yearly ? 1 : first.month(), 1);
+    while (start <= last) {
+        const QDate next(m_yearly ? start.addYears(1) : start.addMonths(1));
+        m_binStarts.append(start);
+        m_binCounts.append(m_timeline->count(start, next.addDays(-1)));
+        start = next;
+    }
+    m_binStarts.append(start);
+}
+
+int TimelineWidget::binAt(const int x) const
+{
+    const int bins = m_binCounts.size();
+    if (bins == 0)
+        return -1;
+
+    return qBound(0, x * bins / qMax(1, width()), bins - 1);
+}
+
+// The position within a bin selects a day within the bin's date range.
+QDate TimelineWidget::dateAt(const int x) const
+{
+    const int bin = binAt(x);
+    if (bin < 0)
+        return QDate();
+
+    const qreal binWidth = qreal(width()) / m_binCounts.size();
+    const qreal fraction = qBound(0.0, (x - bin * binWidth) / binWidth, 1.0);
+    const int days = m_binStarts[bin].daysTo(m_binStarts[bin + 1]);
+
+    return m_binStarts[bin].addDays(qMin(days - 1, int(fraction * days)));
+}
+
+void TimelineWidget::paintEvent(QPaintEvent*)
+{
+    updateBins();
+
+    QPainter painter(this);
+    painter.fillRect(rect(), palette().base());
+
+    const int bins = m_binCounts.size();
+    if (bins == 0)
+        return;
+
+    int maxCount = 1;
+    for (int i = 0; i < bins; ++i)
+        maxCount = qMax(maxCount, m_binCounts[i]);
+
+    // Bar heights are logarithmic, otherwise a single busy holiday would
+    // flatten the rest of the catalog into nothing.
+    const qreal binWidth = qreal(width()) / bins;
+    const qreal scale = height() / log(1.0 + maxCount);
+    for (int i = 0; i < bins; ++i) {
+        if (m_binCounts[i] == 0)
+            continue;
+        const qreal h = qMax(1.0, scale * log(1.0 + m_binCounts[i]));
+        painter.fillRect(QRectF(i * binWidth, height() - h,
+                                qMax(1.0, binWidth - 1), h),
+                         palette().highlight());
+    }
+
+    // Mark the turn of each year when bins are months.
+    if (m_yearly)
+        return;
+    painter.setPen(palette().text().color());
+    for (int i = 0; i < bins; ++i) {
+        if (m_binStarts[i].month() != 1 && i != 0)
+            continue;
+        const int x = int(i * binWidth);
+        painter.drawLine(x, 0, x, height() / 4);
+        painter.drawText(x + 2, painter.fontMetrics().ascent(),
+                         QString::number(m_binStarts[i].year()));
+    }
+}
+
+void TimelineWidget::mousePressEvent(QMouseEvent* event)
+{
+    if (event->button() != Qt::LeftButton) {
+        QWidget::mousePressEvent(event);
+        return;
+    }
+
+    const QDate date(dateAt(event->pos().x()));
+    if (date.isValid())
+        emit dateActivated(date);
+}
+
+void TimelineWidget::mouseMoveEvent(QMouseEvent* event)
+{
+    if (!(event->buttons() & Qt::LeftButton)) {
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+
+    const QDate date(dateAt(event->pos().x()));
+    if (date.isValid())
+        emit dateActivated(date);
+}
+
+bool TimelineWidget::event(QEvent* event)
+{
+    if (event->type() != QEvent::ToolTip)
+        return QWidget::event(event);
+
+    QHelpEvent* helpEvent = static_cast<QHelpEvent*>(event);
+    const int bin = binAt(helpEvent->pos().x());
+    if (bin < 0) {
+        QToolTip::hideText();
+        return true;
+    }
+
+    const QString period(m_binStarts[bin].toString(m_yearly ? "yyyy"
+                                                   : "MMMM yyyy"));
+    QToolTip::showText(helpEvent->globalPos(),
+                       QString("%1: %2 images")
+                       .arg(period).arg(m_binCounts[bin]));
+    return true;
+}
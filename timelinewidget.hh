@@ -0,0 +1,56 @@
+// SQIM - Simple Qt Image Manager
+// Copyright (C) 2014 Tuomas Räsänen <tuomasjjrasanen@tjjr.fi>
+
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or (at
+// your option) any later version.
+
+// This program is distributed in the hope that it will be useful, but
+// WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// General Public License for more details.
+
+// You should have received a copy of the GNU General Public License
+// along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TIMELINEWIDGET_HH
+#define TIMELINEWIDGET_HH
+
+#include <QtGui>
+
+#include "timeline.hh"
+
+// Histogram of capture dates which can be clicked or dragged to scrub
+// through the catalog. Bins are months, or years for catalogs spanning
+// several decades.
+class TimelineWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TimelineWidget(const Timeline* timeline, QWidget* parent = 0);
+
+    virtual QSize sizeHint() const;
+
+signals:
+    void dateActivated(const QDate& date);
+
+protected:
+    virtual bool event(QEvent* event);
+    virtual void mouseMoveEvent(QMouseEvent* event);
+    virtual void mousePressEvent(QMouseEvent* event);
+    virtual void paintEvent(QPaintEvent* event);
+
+private:
+    void updateBins();
+    int binAt(int x) const;
+    QDate dateAt(int x) const;
+
+    const Timeline* m_timeline;
+    QVector<QDate> m_binStarts;
+    QVector<int> m_binCounts;
+    bool m_yearly;
+};
+
+#endif // TIMELINEWIDGET_HH